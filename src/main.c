@@ -14,10 +14,14 @@
    You should have received a copy of the GNU General Public License
    along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
 
+#include "resources.h"
 #include "sd-application.h"
+#include "sd-profile.h"
 
 int
 main (int argc, char **argv)
 {
+  sd_profile_init ();
+  simpledevelop_register_resource ();
   return g_application_run (G_APPLICATION (sd_application_new ()), argc, argv);
 }
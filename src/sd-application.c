@@ -14,6 +14,8 @@
    You should have received a copy of the GNU General Public License
    along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
 
+#include "sd-cli.h"
+#include "sd-profile.h"
 #include "sd-window.h"
 
 G_DEFINE_TYPE (SDApplication, sd_application, GTK_TYPE_APPLICATION)
@@ -54,6 +56,20 @@ sd_application_open (GApplication *app, GFile **files, gint nfiles,
     }
 }
 
+static gint
+sd_application_handle_local_options (GApplication *app, GVariantDict *options)
+{
+  gint ret;
+
+  /* Command line tools exit here, before the display is opened */
+  ret = sd_cli_run (options);
+  if (ret != -1)
+    return ret;
+  if (g_variant_dict_contains (options, "profile-startup"))
+    sd_profile_set_enabled (TRUE);
+  return -1;
+}
+
 static void
 sd_application_startup (GApplication *app)
 {
@@ -67,6 +83,11 @@ sd_application_startup (GApplication *app)
 static void
 sd_application_init (SDApplication *self)
 {
+  g_application_add_main_option (G_APPLICATION (self), "profile-startup", 0,
+				 G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+				 "Print the time taken by each startup stage",
+				 NULL);
+  sd_cli_add_options (G_APPLICATION (self));
 }
 
 static void
@@ -75,6 +96,8 @@ sd_application_class_init (SDApplicationClass *klass)
   G_APPLICATION_CLASS (klass)->activate = sd_application_activate;
   G_APPLICATION_CLASS (klass)->open = sd_application_open;
   G_APPLICATION_CLASS (klass)->startup = sd_application_startup;
+  G_APPLICATION_CLASS (klass)->handle_local_options =
+    sd_application_handle_local_options;
 }
 
 static void
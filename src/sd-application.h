@@ -24,6 +24,10 @@
 
 #define SD_RESOURCE_WINDOW_UI "/org/xnsc/simpledevelop/window.glade"
 #define SD_RESOURCE_PREFERENCES_UI "/org/xnsc/simpledevelop/preferences.ui"
+#define SD_RESOURCE_PROJECT_SEARCH_UI \
+  "/org/xnsc/simpledevelop/project-search.ui"
+#define SD_RESOURCE_MEMORY_DIALOG_UI \
+  "/org/xnsc/simpledevelop/memory-dialog.ui"
 
 G_BEGIN_DECLS
 
@@ -0,0 +1,715 @@
+/* sd-build.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sd-build.h"
+
+/* Size of each read from the build process pipe */
+#define SD_BUILD_READ_SIZE 65536
+
+/* Interval in milliseconds between appending output to the view */
+#define SD_BUILD_FLUSH_INTERVAL 100
+
+/* Longest line that is kept waiting for its newline before the output is
+   flushed or parsed anyway */
+#define SD_BUILD_MAX_LINE 4096
+
+/* Maximum number of entries shown in the error list */
+#define SD_BUILD_MAX_DIAGNOSTICS 10000
+
+struct _SDBuildPrivate
+{
+  GSettings *settings;
+  SDWindow *window;
+  gchar *root;
+  GtkWidget *command_entry;
+  GtkWidget *run_button;
+  GtkWidget *status_label;
+  GtkWidget *output_view;
+  GtkTextBuffer *output;
+  GtkTextMark *end_mark;
+  GtkListStore *errors;
+  GSubprocess *proc;
+  GCancellable *cancellable;
+  GString *pending;
+  GString *partial;
+  guint flush_id;
+  guint limit;
+  guint run;
+
+  /* Only accessed by the parser thread */
+  GThreadPool *parser;
+  GSList *dirs;
+  guint parse_run;
+};
+
+typedef struct _SDBuildPrivate SDBuildPrivate;
+
+/* Complete lines of output handed to the parser thread */
+
+struct _SDBuildChunk
+{
+  SDBuild *build;
+  gchar *lines;
+  guint run;
+};
+
+typedef struct _SDBuildChunk SDBuildChunk;
+
+struct _SDBuildDiagnostic
+{
+  gchar *kind;
+  GFile *file;
+  gint line;
+  gint column;
+  gchar *message;
+};
+
+typedef struct _SDBuildDiagnostic SDBuildDiagnostic;
+
+struct _SDBuildResult
+{
+  SDBuild *build;
+  GPtrArray *items;
+  guint run;
+};
+
+typedef struct _SDBuildResult SDBuildResult;
+
+/* An output read or wait of one build. Callbacks of a build that has been
+   replaced are ignored, since the children of a stopped build can keep
+   its pipe open after it exits. */
+
+struct _SDBuildOp
+{
+  SDBuild *build;
+  GCancellable *cancellable;
+};
+
+typedef struct _SDBuildOp SDBuildOp;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDBuild, sd_build, GTK_TYPE_BOX)
+
+static GRegex *sd_build_diagnostic_regex;
+static GRegex *sd_build_directory_regex;
+
+static void sd_build_parse_thread (gpointer data, gpointer user_data);
+static void sd_build_run_clicked (GtkButton *button, gpointer user_data);
+static void sd_build_error_activated (GtkTreeView *view, GtkTreePath *path,
+				      GtkTreeViewColumn *col,
+				      gpointer user_data);
+
+static void
+sd_build_diagnostic_free (gpointer data)
+{
+  SDBuildDiagnostic *diag = data;
+  g_free (diag->kind);
+  g_object_unref (diag->file);
+  g_free (diag->message);
+  g_free (diag);
+}
+
+static void
+sd_build_dispose (GObject *obj)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (SD_BUILD (obj));
+  if (priv->proc != NULL)
+    {
+      g_subprocess_force_exit (priv->proc);
+      g_clear_object (&priv->proc);
+    }
+  if (priv->cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
+    }
+  if (priv->flush_id != 0)
+    {
+      g_source_remove (priv->flush_id);
+      priv->flush_id = 0;
+    }
+  g_clear_object (&priv->settings);
+  G_OBJECT_CLASS (sd_build_parent_class)->dispose (obj);
+}
+
+static void
+sd_build_finalize (GObject *obj)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (SD_BUILD (obj));
+  g_thread_pool_free (priv->parser, TRUE, TRUE);
+  g_slist_free_full (priv->dirs, g_free);
+  g_string_free (priv->pending, TRUE);
+  g_string_free (priv->partial, TRUE);
+  g_free (priv->root);
+  G_OBJECT_CLASS (sd_build_parent_class)->finalize (obj);
+}
+
+static void
+sd_build_init (SDBuild *self)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  GtkWidget *toolbar;
+  GtkWidget *pane;
+  GtkWidget *window;
+  GtkWidget *error_view;
+  GtkCellRenderer *renderer;
+  GtkTextIter end;
+
+  priv->settings = g_settings_new (SD_SETTINGS_NAME);
+  priv->pending = g_string_new (NULL);
+  priv->partial = g_string_new (NULL);
+  /* A single thread keeps the output lines in order */
+  priv->parser = g_thread_pool_new (sd_build_parse_thread, NULL, 1, FALSE,
+				    NULL);
+
+  gtk_orientable_set_orientation (GTK_ORIENTABLE (self),
+				  GTK_ORIENTATION_VERTICAL);
+  toolbar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+  priv->command_entry = gtk_entry_new ();
+  g_settings_bind (priv->settings, "build-command", priv->command_entry,
+		   "text", G_SETTINGS_BIND_DEFAULT);
+  priv->run_button = gtk_button_new_with_label ("Build");
+  priv->status_label = gtk_label_new (NULL);
+  g_signal_connect (priv->command_entry, "activate",
+		    G_CALLBACK (sd_build_run_clicked), self);
+  g_signal_connect (priv->run_button, "clicked",
+		    G_CALLBACK (sd_build_run_clicked), self);
+  gtk_box_pack_start (GTK_BOX (toolbar), priv->command_entry, TRUE, TRUE, 0);
+  gtk_box_pack_start (GTK_BOX (toolbar), priv->run_button, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (toolbar), priv->status_label, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (self), toolbar, FALSE, FALSE, 0);
+
+  pane = gtk_paned_new (GTK_ORIENTATION_HORIZONTAL);
+  priv->output_view = gtk_text_view_new ();
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (priv->output_view), FALSE);
+  gtk_text_view_set_monospace (GTK_TEXT_VIEW (priv->output_view), TRUE);
+  priv->output = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->output_view));
+  gtk_text_buffer_get_end_iter (priv->output, &end);
+  priv->end_mark = gtk_text_buffer_create_mark (priv->output, NULL, &end,
+						FALSE);
+  window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), priv->output_view);
+  gtk_paned_pack1 (GTK_PANED (pane), window, TRUE, TRUE);
+
+  priv->errors = gtk_list_store_new (BUILD_N_COLUMNS, G_TYPE_STRING,
+				     G_TYPE_STRING, G_TYPE_STRING, G_TYPE_FILE,
+				     G_TYPE_INT, G_TYPE_INT);
+  error_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->errors));
+  g_object_unref (priv->errors);
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (error_view), -1,
+					       "Kind", renderer, "text",
+					       BUILD_KIND_COLUMN, NULL);
+  gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (error_view), -1,
+					       "Location", renderer, "text",
+					       BUILD_LOCATION_COLUMN, NULL);
+  gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (error_view), -1,
+					       "Message", renderer, "text",
+					       BUILD_MESSAGE_COLUMN, NULL);
+  g_signal_connect (error_view, "row-activated",
+		    G_CALLBACK (sd_build_error_activated), self);
+  window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), error_view);
+  gtk_paned_pack2 (GTK_PANED (pane), window, TRUE, TRUE);
+  gtk_box_pack_start (GTK_BOX (self), pane, TRUE, TRUE, 0);
+}
+
+static void
+sd_build_class_init (SDBuildClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_build_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_build_finalize;
+
+  sd_build_diagnostic_regex =
+    g_regex_new ("^([^:\\s][^:]*):(\\d+):(?:(\\d+):)?\\s*"
+		 "((?:fatal )?error|warning|note):\\s*(.*?)\\r?$",
+		 G_REGEX_OPTIMIZE, 0, NULL);
+  sd_build_directory_regex =
+    g_regex_new ("^\\S*make(?:\\[\\d+\\])?: (Entering|Leaving) directory "
+		 "[`'\\x{2018}](.*)['\\x{2019}]\\r?$",
+		 G_REGEX_OPTIMIZE, 0, NULL);
+}
+
+static void
+sd_build_set_status (SDBuild *self, const gchar *status)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  gtk_label_set_text (GTK_LABEL (priv->status_label), status);
+}
+
+static SDBuildDiagnostic *
+sd_build_parse_line (SDBuild *self, const gchar *line)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  SDBuildDiagnostic *diag = NULL;
+  GMatchInfo *info;
+
+  if (g_regex_match (sd_build_directory_regex, line, 0, &info))
+    {
+      gchar *action = g_match_info_fetch (info, 1);
+      if (*action == 'E')
+	priv->dirs = g_slist_prepend (priv->dirs, g_match_info_fetch (info, 2));
+      else if (priv->dirs->next != NULL)
+	{
+	  g_free (priv->dirs->data);
+	  priv->dirs = g_slist_delete_link (priv->dirs, priv->dirs);
+	}
+      g_free (action);
+      g_match_info_free (info);
+      return NULL;
+    }
+
+  /* A match info is returned even when nothing matched */
+  g_match_info_free (info);
+  if (g_regex_match (sd_build_diagnostic_regex, line, 0, &info))
+    {
+      gchar *path = g_match_info_fetch (info, 1);
+      gchar *line_str = g_match_info_fetch (info, 2);
+      gchar *col_str = g_match_info_fetch (info, 3);
+
+      diag = g_malloc (sizeof (SDBuildDiagnostic));
+      if (g_path_is_absolute (path))
+	diag->file = g_file_new_for_path (path);
+      else
+	{
+	  gchar *full = g_build_filename (priv->dirs->data, path, NULL);
+	  diag->file = g_file_new_for_path (full);
+	  g_free (full);
+	}
+      diag->line = atoi (line_str);
+      diag->column = *col_str == '\0' ? 0 : atoi (col_str);
+      diag->kind = g_match_info_fetch (info, 4);
+      diag->message = g_match_info_fetch (info, 5);
+      g_free (path);
+      g_free (line_str);
+      g_free (col_str);
+    }
+  g_match_info_free (info);
+  return diag;
+}
+
+static gboolean
+sd_build_add_diagnostics (gpointer user_data)
+{
+  SDBuildResult *result = user_data;
+  SDBuildPrivate *priv = sd_build_get_instance_private (result->build);
+  gint count;
+  gint i;
+
+  if (result->run != priv->run || priv->settings == NULL)
+    goto finish; /* Stale results from a previous build */
+
+  count = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->errors),
+					  NULL);
+  for (i = 0; i < result->items->len && count < SD_BUILD_MAX_DIAGNOSTICS;
+       i++, count++)
+    {
+      SDBuildDiagnostic *diag = g_ptr_array_index (result->items, i);
+      gchar *basename = g_file_get_basename (diag->file);
+      gchar *location = g_strdup_printf ("%s:%d", basename, diag->line);
+      gtk_list_store_insert_with_values (priv->errors, NULL, -1,
+					 BUILD_KIND_COLUMN, diag->kind,
+					 BUILD_LOCATION_COLUMN, location,
+					 BUILD_MESSAGE_COLUMN, diag->message,
+					 BUILD_FILE_COLUMN, diag->file,
+					 BUILD_LINE_COLUMN, diag->line,
+					 BUILD_COLUMN_COLUMN, diag->column,
+					 -1);
+      g_free (location);
+      g_free (basename);
+    }
+
+ finish:
+  g_ptr_array_free (result->items, TRUE);
+  g_object_unref (result->build);
+  g_free (result);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_build_parse_thread (gpointer data, gpointer user_data)
+{
+  SDBuildChunk *chunk = data;
+  SDBuildPrivate *priv = sd_build_get_instance_private (chunk->build);
+  SDBuildResult *result;
+  gchar **lines;
+  gint i;
+
+  if (chunk->run != priv->parse_run)
+    {
+      /* A new build was started, so reset directory tracking */
+      g_slist_free_full (priv->dirs, g_free);
+      priv->dirs = g_slist_prepend (NULL, g_strdup (priv->root));
+      priv->parse_run = chunk->run;
+    }
+
+  result = g_malloc (sizeof (SDBuildResult));
+  result->build = chunk->build;
+  result->items = g_ptr_array_new_with_free_func (sd_build_diagnostic_free);
+  result->run = chunk->run;
+
+  lines = g_strsplit (chunk->lines, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      SDBuildDiagnostic *diag;
+      if (*lines[i] == '\0' || !g_utf8_validate (lines[i], -1, NULL))
+	continue;
+      diag = sd_build_parse_line (chunk->build, lines[i]);
+      if (diag != NULL)
+	g_ptr_array_add (result->items, diag);
+    }
+  g_strfreev (lines);
+  g_free (chunk->lines);
+  g_free (chunk);
+
+  /* The result is handed back even when empty, since its reference may be
+     the last one on the widget, which must be finalized on the main
+     thread and not in the pool that finalize waits for */
+  g_idle_add (sd_build_add_diagnostics, result);
+}
+
+static void
+sd_build_queue_lines (SDBuild *self, gsize len)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  SDBuildChunk *chunk;
+
+  chunk = g_malloc (sizeof (SDBuildChunk));
+  chunk->build = g_object_ref (self);
+  chunk->lines = g_strndup (priv->partial->str, len);
+  chunk->run = priv->run;
+  g_string_erase (priv->partial, 0, len);
+  g_thread_pool_push (priv->parser, chunk, NULL);
+}
+
+static gboolean
+sd_build_flush (gpointer user_data)
+{
+  SDBuild *self = SD_BUILD (user_data);
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  gsize len = priv->pending->len;
+  gint count;
+
+  /* Avoid splitting lines, unless a line is unreasonably long */
+  while (len > 0 && priv->pending->str[len - 1] != '\n')
+    len--;
+  if (len == 0)
+    {
+      if (priv->pending->len < SD_BUILD_MAX_LINE && priv->proc != NULL)
+	return G_SOURCE_CONTINUE;
+      len = priv->pending->len;
+    }
+
+  text = g_utf8_make_valid (priv->pending->str, len);
+  g_string_erase (priv->pending, 0, len);
+  gtk_text_buffer_get_end_iter (priv->output, &end);
+  gtk_text_buffer_insert (priv->output, &end, text, -1);
+  g_free (text);
+
+  /* Drop the oldest output once the limit is exceeded. Trimming down to
+     three quarters of the limit avoids deleting on every flush. */
+  count = gtk_text_buffer_get_char_count (priv->output);
+  if (count > priv->limit)
+    {
+      gtk_text_buffer_get_start_iter (priv->output, &start);
+      gtk_text_buffer_get_iter_at_offset (priv->output, &end,
+					  count - priv->limit / 4 * 3);
+      gtk_text_iter_forward_line (&end);
+      gtk_text_buffer_delete (priv->output, &start, &end);
+    }
+  gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (priv->output_view),
+				      priv->end_mark);
+
+  if (priv->pending->len > 0)
+    return G_SOURCE_CONTINUE;
+  priv->flush_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_build_append_output (SDBuild *self, const gchar *data, gsize len)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  const gchar *nl;
+
+  /* Output waiting to be shown is capped the same way as the view, so a
+     flood of output between flushes only keeps the newest part */
+  g_string_append_len (priv->pending, data, len);
+  if (priv->pending->len > priv->limit)
+    g_string_erase (priv->pending, 0, priv->pending->len - priv->limit);
+  if (priv->flush_id == 0)
+    priv->flush_id = g_timeout_add (SD_BUILD_FLUSH_INTERVAL, sd_build_flush,
+				    self);
+
+  /* Hand every complete line to the parser */
+  g_string_append_len (priv->partial, data, len);
+  nl = memrchr (priv->partial->str, '\n', priv->partial->len);
+  if (nl != NULL)
+    sd_build_queue_lines (self, nl - priv->partial->str + 1);
+  else if (priv->partial->len > SD_BUILD_MAX_LINE)
+    g_string_truncate (priv->partial, 0);
+}
+
+static SDBuildOp *
+sd_build_op_new (SDBuild *self)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  SDBuildOp *op = g_malloc (sizeof (SDBuildOp));
+  op->build = g_object_ref (self);
+  op->cancellable = g_object_ref (priv->cancellable);
+  return op;
+}
+
+static void
+sd_build_op_free (SDBuildOp *op)
+{
+  g_object_unref (op->build);
+  g_object_unref (op->cancellable);
+  g_free (op);
+}
+
+static void
+sd_build_read_done (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDBuildOp *op = user_data;
+  SDBuild *self = op->build;
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  GError *err = NULL;
+  GBytes *bytes =
+    g_input_stream_read_bytes_finish (G_INPUT_STREAM (obj), result, &err);
+
+  if (err != NULL)
+    {
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	g_critical ("Failed to read build output: %s", err->message);
+      g_error_free (err);
+      sd_build_op_free (op);
+      return;
+    }
+
+  if (op->cancellable != priv->cancellable || g_bytes_get_size (bytes) == 0)
+    {
+      /* End of output, unless this build was replaced by another */
+      if (op->cancellable == priv->cancellable && priv->partial->len > 0)
+	sd_build_queue_lines (self, priv->partial->len);
+      g_bytes_unref (bytes);
+      sd_build_op_free (op);
+      return;
+    }
+
+  sd_build_append_output (self, g_bytes_get_data (bytes, NULL),
+			  g_bytes_get_size (bytes));
+  g_bytes_unref (bytes);
+  g_input_stream_read_bytes_async (G_INPUT_STREAM (obj), SD_BUILD_READ_SIZE,
+				   G_PRIORITY_DEFAULT, op->cancellable,
+				   sd_build_read_done, op);
+}
+
+static void
+sd_build_wait_done (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDBuildOp *op = user_data;
+  SDBuild *self = op->build;
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  GSubprocess *proc = G_SUBPROCESS (obj);
+  GError *err = NULL;
+
+  if (!g_subprocess_wait_finish (proc, result, &err))
+    {
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	g_critical ("Failed to wait for build process: %s", err->message);
+      g_error_free (err);
+      sd_build_op_free (op);
+      return;
+    }
+  if (op->cancellable != priv->cancellable)
+    {
+      sd_build_op_free (op);
+      return;
+    }
+
+  if (g_subprocess_get_if_exited (proc))
+    {
+      gint status = g_subprocess_get_exit_status (proc);
+      if (status == 0)
+	sd_build_set_status (self, "Build succeeded");
+      else
+	{
+	  gchar *text = g_strdup_printf ("Build failed (exit status %d)",
+					 status);
+	  sd_build_set_status (self, text);
+	  g_free (text);
+	}
+    }
+  else
+    sd_build_set_status (self, "Build stopped");
+
+  if (priv->proc == proc)
+    {
+      g_clear_object (&priv->proc);
+      gtk_button_set_label (GTK_BUTTON (priv->run_button), "Build");
+    }
+  sd_build_op_free (op);
+}
+
+static void
+sd_build_run_clicked (GtkButton *button, gpointer user_data)
+{
+  SDBuild *self = SD_BUILD (user_data);
+  if (sd_build_is_running (self))
+    sd_build_stop (self);
+  else
+    sd_build_run (self);
+}
+
+static void
+sd_build_error_activated (GtkTreeView *view, GtkTreePath *path,
+			  GtkTreeViewColumn *col, gpointer user_data)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (SD_BUILD (user_data));
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
+  GtkTreeIter iter;
+  GFile *file;
+  gchar *name;
+  gint line;
+  gint column;
+
+  g_return_if_fail (gtk_tree_model_get_iter (model, &iter, path));
+  gtk_tree_model_get (model, &iter, BUILD_FILE_COLUMN, &file,
+		      BUILD_LINE_COLUMN, &line, BUILD_COLUMN_COLUMN, &column,
+		      -1);
+  name = g_file_get_basename (file);
+  sd_window_editor_open_at (priv->window, name, file, line, column);
+  g_free (name);
+  g_object_unref (file);
+}
+
+SDBuild *
+sd_build_new (SDWindow *window, GFile *root)
+{
+  SDBuild *build = g_object_new (SD_TYPE_BUILD, "spacing", 6, NULL);
+  SDBuildPrivate *priv = sd_build_get_instance_private (build);
+  priv->window = window;
+  priv->root = g_file_get_path (root);
+  return build;
+}
+
+void
+sd_build_run (SDBuild *self)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  GSubprocessLauncher *launcher;
+  GError *err = NULL;
+  const gchar *command;
+  gchar **argv;
+  gchar *status;
+
+  if (sd_build_is_running (self))
+    return;
+
+  command = gtk_entry_get_text (GTK_ENTRY (priv->command_entry));
+  if (!g_shell_parse_argv (command, NULL, &argv, &err))
+    {
+      g_warning ("Invalid build command `%s': %s", command, err->message);
+      sd_build_set_status (self, err->message);
+      g_error_free (err);
+      return;
+    }
+
+  /* Reset state from any previous build */
+  priv->run++;
+  priv->limit = g_settings_get_uint (priv->settings, "build-output-limit");
+  g_string_truncate (priv->pending, 0);
+  g_string_truncate (priv->partial, 0);
+  gtk_text_buffer_set_text (priv->output, "", 0);
+  gtk_list_store_clear (priv->errors);
+  if (priv->cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
+    }
+  priv->cancellable = g_cancellable_new ();
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE
+					| G_SUBPROCESS_FLAGS_STDERR_MERGE);
+  g_subprocess_launcher_set_cwd (launcher, priv->root);
+  priv->proc = g_subprocess_launcher_spawnv (launcher,
+					     (const gchar * const *) argv,
+					     &err);
+  g_object_unref (launcher);
+  g_strfreev (argv);
+  if (priv->proc == NULL)
+    {
+      g_warning ("Failed to run build command `%s': %s", command,
+		 err->message);
+      sd_build_set_status (self, err->message);
+      g_error_free (err);
+      return;
+    }
+
+  g_debug ("Running build command `%s' in %s", command, priv->root);
+  status = g_strdup_printf ("Running `%s'", command);
+  sd_build_set_status (self, status);
+  g_free (status);
+  gtk_button_set_label (GTK_BUTTON (priv->run_button), "Stop");
+
+  g_input_stream_read_bytes_async (g_subprocess_get_stdout_pipe (priv->proc),
+				   SD_BUILD_READ_SIZE, G_PRIORITY_DEFAULT,
+				   priv->cancellable, sd_build_read_done,
+				   sd_build_op_new (self));
+  g_subprocess_wait_async (priv->proc, priv->cancellable, sd_build_wait_done,
+			   sd_build_op_new (self));
+}
+
+void
+sd_build_stop (SDBuild *self)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  if (priv->proc != NULL)
+    g_subprocess_force_exit (priv->proc);
+}
+
+gboolean
+sd_build_is_running (SDBuild *self)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  return priv->proc != NULL;
+}
+
+/* Adds the estimated memory use of the build output and the parsed
+   diagnostics to REPORT */
+
+void
+sd_build_get_memory (SDBuild *self, SDMemoryReport *report)
+{
+  SDBuildPrivate *priv = sd_build_get_instance_private (self);
+  gint errors =
+    gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->errors), NULL);
+
+  sd_memory_report_begin (report, "Build pane");
+  sd_memory_report_add_buffer (report, priv->output);
+  sd_memory_report_add (report, "Pending output",
+			priv->pending->allocated_len
+			+ priv->partial->allocated_len);
+  sd_memory_report_add (report, "Diagnostics",
+			(gsize) errors * (sizeof (SDBuildDiagnostic)
+					  + BUILD_N_COLUMNS * 2
+					  * sizeof (gpointer)));
+}
@@ -0,0 +1,52 @@
+/* sd-build.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_BUILD_H
+#define _SD_BUILD_H
+
+#include "sd-memory.h"
+#include "sd-window.h"
+
+enum
+{
+  BUILD_KIND_COLUMN = 0,
+  BUILD_LOCATION_COLUMN,
+  BUILD_MESSAGE_COLUMN,
+  BUILD_FILE_COLUMN,
+  BUILD_LINE_COLUMN,
+  BUILD_COLUMN_COLUMN,
+  BUILD_N_COLUMNS
+};
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_BUILD sd_build_get_type ()
+G_DECLARE_FINAL_TYPE (SDBuild, sd_build, SD, BUILD, GtkBox)
+
+struct _SDBuild
+{
+  GtkBox parent;
+};
+
+SDBuild *sd_build_new (SDWindow *window, GFile *root);
+void sd_build_run (SDBuild *self);
+void sd_build_stop (SDBuild *self);
+gboolean sd_build_is_running (SDBuild *self);
+void sd_build_get_memory (SDBuild *self, SDMemoryReport *report);
+
+G_END_DECLS
+
+#endif
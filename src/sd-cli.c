@@ -0,0 +1,304 @@
+/* sd-cli.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include <string.h>
+#include "sd-cli.h"
+#include "sd-index.h"
+#include "sd-scan.h"
+
+/* Commands that run without opening a window or connecting to a display,
+   for use from scripts. Results are printed to standard output one per
+   line, with paths relative to the project directory, and the exit status
+   follows grep: 0 if anything matched, 1 if nothing did and 2 on errors. */
+
+#define SD_CLI_OUTPUT_BUFFER (1 << 16)
+
+/* Files are searched in parallel, but their results are printed in the
+   order of the file list. Each worker fills in its own slot and the main
+   thread waits for the slots in order. */
+
+struct _SDCliGrep
+{
+  const gchar *root;
+  GRegex *regex;
+  GPtrArray *files;
+  GString **output;
+  gboolean *done;
+  GMutex lock;
+  GCond cond;
+};
+
+typedef struct _SDCliGrep SDCliGrep;
+
+static gchar *
+sd_cli_get_root (GVariantDict *options)
+{
+  gchar *dir = NULL;
+  gchar *root;
+  GFile *file;
+
+  g_variant_dict_lookup (options, "project", "^ay", &dir);
+  file = g_file_new_for_commandline_arg (dir == NULL ? "." : dir);
+  root = g_file_get_path (file);
+  g_object_unref (file);
+  g_free (dir);
+  return root;
+}
+
+static gint
+sd_cli_index (const gchar *dir)
+{
+  GFile *file = g_file_new_for_commandline_arg (dir);
+  gchar *root = g_file_get_path (file);
+  gint64 start = g_get_monotonic_time ();
+  GError *err = NULL;
+  GPtrArray *files;
+  gint ret = 0;
+
+  g_object_unref (file);
+  if (!g_file_test (root, G_FILE_TEST_IS_DIR))
+    {
+      g_printerr ("%s: not a directory\n", dir);
+      g_free (root);
+      return 2;
+    }
+
+  files = sd_scan_files (root, NULL);
+  if (sd_index_save (root, files, &err))
+    printf ("%s\t%u\t%.1f\n", root, files->len,
+	    (g_get_monotonic_time () - start) / 1000.0);
+  else
+    {
+      g_printerr ("%s\n", err->message);
+      g_error_free (err);
+      ret = 2;
+    }
+  g_ptr_array_free (files, TRUE);
+  g_free (root);
+  return ret;
+}
+
+/* Patterns with wildcards are matched against the whole relative path if
+   they contain a `/', or otherwise against the file name. Patterns
+   without wildcards match any path containing them. */
+
+static gint
+sd_cli_find_file (const gchar *root, const gchar *pattern)
+{
+  GPatternSpec *spec = g_pattern_spec_new (pattern);
+  gboolean glob = strpbrk (pattern, "*?") != NULL;
+  gboolean full = strchr (pattern, '/') != NULL;
+  GPtrArray *files = sd_index_get_files (root);
+  gint ret = 1;
+  guint i;
+
+  for (i = 0; i < files->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (files, i);
+      const gchar *name = strrchr (path, '/');
+      gboolean match;
+
+      if (!glob)
+	match = strstr (path, pattern) != NULL;
+      else
+	match = g_pattern_match_string (spec, full || name == NULL ?
+					path : name + 1);
+      if (match)
+	{
+	  puts (path);
+	  ret = 0;
+	}
+    }
+  g_ptr_array_free (files, TRUE);
+  g_pattern_spec_free (spec);
+  return ret;
+}
+
+static void
+sd_cli_grep_file (gpointer data, gpointer user_data)
+{
+  SDCliGrep *grep = user_data;
+  guint index = GPOINTER_TO_UINT (data) - 1;
+  const gchar *rel = g_ptr_array_index (grep->files, index);
+  gchar *path = g_build_filename (grep->root, rel, NULL);
+  GString *output = NULL;
+  GMatchInfo *info;
+  gchar *contents;
+  gsize len;
+  gsize pos = 0;
+  gint line = 1;
+
+  if (g_file_get_contents (path, &contents, &len, NULL))
+    {
+      if (sd_scan_is_text (contents, len))
+	{
+	  g_regex_match_full (grep->regex, contents, len, 0, 0, &info, NULL);
+	  while (g_match_info_matches (info))
+	    {
+	      const gchar *line_start;
+	      const gchar *line_end;
+	      gint start;
+	      gint end;
+
+	      g_match_info_fetch_pos (info, 0, &start, &end);
+	      for (; pos < start; pos++)
+		{
+		  if (contents[pos] == '\n')
+		    line++;
+		}
+	      line_start = contents + start;
+	      while (line_start > contents && line_start[-1] != '\n')
+		line_start--;
+	      line_end = memchr (contents + start, '\n', len - start);
+	      if (line_end == NULL)
+		line_end = contents + len;
+
+	      if (output == NULL)
+		output = g_string_new (NULL);
+	      g_string_append_printf (output, "%s:%d:%ld:%.*s\n", rel, line,
+				      g_utf8_pointer_to_offset (line_start,
+								contents
+								+ start) + 1,
+				      (gint) (line_end - line_start),
+				      line_start);
+	      g_match_info_next (info, NULL);
+	    }
+	  g_match_info_free (info);
+	}
+      g_free (contents);
+    }
+  g_free (path);
+
+  g_mutex_lock (&grep->lock);
+  grep->output[index] = output;
+  grep->done[index] = TRUE;
+  g_cond_signal (&grep->cond);
+  g_mutex_unlock (&grep->lock);
+}
+
+static gint
+sd_cli_grep (const gchar *root, const gchar *pattern)
+{
+  SDCliGrep grep;
+  GThreadPool *pool;
+  GError *err = NULL;
+  gint ret = 1;
+  guint i;
+
+  grep.regex = g_regex_new (pattern, G_REGEX_MULTILINE | G_REGEX_OPTIMIZE,
+			    0, &err);
+  if (grep.regex == NULL)
+    {
+      g_printerr ("%s\n", err->message);
+      g_error_free (err);
+      return 2;
+    }
+  grep.root = root;
+  grep.files = sd_index_get_files (root);
+  grep.output = g_new0 (GString *, grep.files->len);
+  grep.done = g_new0 (gboolean, grep.files->len);
+  g_mutex_init (&grep.lock);
+  g_cond_init (&grep.cond);
+
+  pool = g_thread_pool_new (sd_cli_grep_file, &grep, g_get_num_processors (),
+			    FALSE, NULL);
+  for (i = 0; i < grep.files->len; i++)
+    g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+  for (i = 0; i < grep.files->len; i++)
+    {
+      GString *output;
+      g_mutex_lock (&grep.lock);
+      while (!grep.done[i])
+	g_cond_wait (&grep.cond, &grep.lock);
+      output = grep.output[i];
+      g_mutex_unlock (&grep.lock);
+      if (output != NULL)
+	{
+	  fwrite (output->str, 1, output->len, stdout);
+	  g_string_free (output, TRUE);
+	  ret = 0;
+	}
+    }
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_mutex_clear (&grep.lock);
+  g_cond_clear (&grep.cond);
+  g_free (grep.output);
+  g_free (grep.done);
+  g_ptr_array_free (grep.files, TRUE);
+  g_regex_unref (grep.regex);
+  return ret;
+}
+
+void
+sd_cli_add_options (GApplication *app)
+{
+  g_application_add_main_option (app, "index", 0, G_OPTION_FLAG_NONE,
+				 G_OPTION_ARG_FILENAME,
+				 "Save the list of files in a project for "
+				 "--find-file and --grep, then exit", "DIR");
+  g_application_add_main_option (app, "find-file", 0, G_OPTION_FLAG_NONE,
+				 G_OPTION_ARG_STRING,
+				 "Print the files in the project matching a "
+				 "name or wildcard pattern, then exit",
+				 "PATTERN");
+  g_application_add_main_option (app, "grep", 0, G_OPTION_FLAG_NONE,
+				 G_OPTION_ARG_STRING,
+				 "Print the lines in the project matching a "
+				 "regular expression, then exit", "PATTERN");
+  g_application_add_main_option (app, "project", 0, G_OPTION_FLAG_NONE,
+				 G_OPTION_ARG_FILENAME,
+				 "Project directory for --find-file and "
+				 "--grep (default: current directory)", "DIR");
+}
+
+/* Runs the command given in OPTIONS, if any, and returns its exit status.
+   Returns -1 if no command was given and the application should start
+   normally. */
+
+gint
+sd_cli_run (GVariantDict *options)
+{
+  gchar *pattern = NULL;
+  gchar *root;
+  gint ret = -1;
+
+  if (g_variant_dict_lookup (options, "index", "^ay", &pattern))
+    {
+      setvbuf (stdout, NULL, _IOFBF, SD_CLI_OUTPUT_BUFFER);
+      ret = sd_cli_index (pattern);
+    }
+  else if (g_variant_dict_lookup (options, "find-file", "s", &pattern))
+    {
+      setvbuf (stdout, NULL, _IOFBF, SD_CLI_OUTPUT_BUFFER);
+      root = sd_cli_get_root (options);
+      ret = sd_cli_find_file (root, pattern);
+      g_free (root);
+    }
+  else if (g_variant_dict_lookup (options, "grep", "s", &pattern))
+    {
+      setvbuf (stdout, NULL, _IOFBF, SD_CLI_OUTPUT_BUFFER);
+      root = sd_cli_get_root (options);
+      ret = sd_cli_grep (root, pattern);
+      g_free (root);
+    }
+  g_free (pattern);
+  if (ret != -1)
+    fflush (stdout);
+  return ret;
+}
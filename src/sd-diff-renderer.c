@@ -0,0 +1,111 @@
+/* sd-diff-renderer.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-diff-renderer.h"
+
+/* Width of the gutter column in pixels */
+#define SD_DIFF_RENDERER_SIZE 4
+
+struct _SDDiffRendererPrivate
+{
+  SDDiff *diff;
+};
+
+typedef struct _SDDiffRendererPrivate SDDiffRendererPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDDiffRenderer, sd_diff_renderer,
+			    GTK_SOURCE_TYPE_GUTTER_RENDERER)
+
+/* Draws a bar beside added and modified lines, and a triangle at the top
+   or bottom edge of lines next to deleted ones */
+
+static void
+sd_diff_renderer_draw (GtkSourceGutterRenderer *renderer, cairo_t *cr,
+		       GdkRectangle *background_area, GdkRectangle *cell_area,
+		       GtkTextIter *start, GtkTextIter *end,
+		       GtkSourceGutterRendererState state)
+{
+  SDDiffRendererPrivate *priv =
+    sd_diff_renderer_get_instance_private (SD_DIFF_RENDERER (renderer));
+  guint marks = sd_diff_get_marks (priv->diff, gtk_text_iter_get_line (start));
+  gint x = cell_area->x;
+  gint y = cell_area->y;
+  gint width = cell_area->width;
+  gint height = cell_area->height;
+
+  GTK_SOURCE_GUTTER_RENDERER_CLASS (sd_diff_renderer_parent_class)->draw
+    (renderer, cr, background_area, cell_area, start, end, state);
+  if (marks & (SD_DIFF_ADDED | SD_DIFF_MODIFIED))
+    {
+      if (marks & SD_DIFF_ADDED)
+	cairo_set_source_rgb (cr, 0.31, 0.64, 0.24);
+      else
+	cairo_set_source_rgb (cr, 0.98, 0.62, 0.18);
+      cairo_rectangle (cr, x, y, width, height);
+      cairo_fill (cr);
+    }
+  cairo_set_source_rgb (cr, 0.8, 0.2, 0.2);
+  if (marks & SD_DIFF_DELETED)
+    {
+      cairo_move_to (cr, x, y - width);
+      cairo_line_to (cr, x + width, y);
+      cairo_line_to (cr, x, y + width);
+      cairo_close_path (cr);
+      cairo_fill (cr);
+    }
+  if (marks & SD_DIFF_DELETED_BELOW)
+    {
+      cairo_move_to (cr, x, y + height - width);
+      cairo_line_to (cr, x + width, y + height);
+      cairo_line_to (cr, x, y + height + width);
+      cairo_close_path (cr);
+      cairo_fill (cr);
+    }
+}
+
+static void
+sd_diff_renderer_dispose (GObject *obj)
+{
+  SDDiffRendererPrivate *priv =
+    sd_diff_renderer_get_instance_private (SD_DIFF_RENDERER (obj));
+  g_clear_object (&priv->diff);
+  G_OBJECT_CLASS (sd_diff_renderer_parent_class)->dispose (obj);
+}
+
+static void
+sd_diff_renderer_init (SDDiffRenderer *self)
+{
+}
+
+static void
+sd_diff_renderer_class_init (SDDiffRendererClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_diff_renderer_dispose;
+  GTK_SOURCE_GUTTER_RENDERER_CLASS (klass)->draw = sd_diff_renderer_draw;
+}
+
+GtkSourceGutterRenderer *
+sd_diff_renderer_new (SDDiff *diff)
+{
+  SDDiffRenderer *self = g_object_new (SD_TYPE_DIFF_RENDERER, "size",
+				       SD_DIFF_RENDERER_SIZE, NULL);
+  SDDiffRendererPrivate *priv = sd_diff_renderer_get_instance_private (self);
+  priv->diff = g_object_ref (diff);
+  g_signal_connect_object (diff, "changed",
+			   G_CALLBACK (gtk_source_gutter_renderer_queue_draw),
+			   self, G_CONNECT_SWAPPED);
+  return GTK_SOURCE_GUTTER_RENDERER (self);
+}
@@ -0,0 +1,38 @@
+/* sd-diff-renderer.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_DIFF_RENDERER_H
+#define _SD_DIFF_RENDERER_H
+
+#include <gtksourceview/gtksource.h>
+#include "sd-diff.h"
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_DIFF_RENDERER sd_diff_renderer_get_type ()
+G_DECLARE_FINAL_TYPE (SDDiffRenderer, sd_diff_renderer, SD, DIFF_RENDERER,
+		      GtkSourceGutterRenderer)
+
+struct _SDDiffRenderer
+{
+  GtkSourceGutterRenderer parent;
+};
+
+GtkSourceGutterRenderer *sd_diff_renderer_new (SDDiff *diff);
+
+G_END_DECLS
+
+#endif
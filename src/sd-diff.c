@@ -0,0 +1,686 @@
+/* sd-diff.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <string.h>
+#include "sd-diff.h"
+
+/* Delay in milliseconds between an edit and updating the diff, so the
+   diff is only recomputed once for a burst of typing */
+#define SD_DIFF_UPDATE_DELAY 250
+
+/* Regions differing by more than this many lines are marked as modified
+   without finding the exact changes, which bounds the time and memory
+   used by a single update */
+#define SD_DIFF_MAX_EDITS 2000
+
+/* The diff state of each line of the buffer. BASE is the baseline line it
+   is unchanged from, or -1 if it was added or modified. */
+
+struct _SDDiffLine
+{
+  gint base;
+  guint marks;
+};
+
+typedef struct _SDDiffLine SDDiffLine;
+
+/* An update of the lines in [START, END) of the buffer, which correspond
+   to the baseline lines in BASE. Everything outside the region is known
+   to be unchanged from the last update. */
+
+struct _SDDiffJob
+{
+  guint generation;
+  gint start;
+  gint end;
+  gint base_start;
+  GArray *base;
+  gchar *text;
+  GArray *lines;
+  gboolean deleted_after;
+};
+
+typedef struct _SDDiffJob SDDiffJob;
+
+struct _SDDiffPrivate
+{
+  GtkTextBuffer *buffer;
+  GArray *base;
+  GArray *lines;
+  gboolean deleted_at_end;
+  gboolean head;
+  guint head_serial;
+  gint dirty_start;
+  gint dirty_end;
+  guint generation;
+  guint update_id;
+  gboolean running;
+};
+
+typedef struct _SDDiffPrivate SDDiffPrivate;
+
+enum
+{
+  SIGNAL_CHANGED,
+  N_SIGNALS
+};
+
+static guint sd_diff_signals[N_SIGNALS];
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDDiff, sd_diff, G_TYPE_OBJECT)
+
+static void
+sd_diff_job_free (gpointer data)
+{
+  SDDiffJob *job = data;
+  g_array_unref (job->base);
+  g_free (job->text);
+  if (job->lines != NULL)
+    g_array_unref (job->lines);
+  g_free (job);
+}
+
+/* Appends a hash of each of the first MAX lines of TEXT to HASHES. Lines
+   end with \n, \r\n or \r, as in GtkTextBuffer. */
+
+static void
+sd_diff_hash_lines (const gchar *text, GArray *hashes, gint max)
+{
+  const gchar *ptr = text;
+  while (hashes->len < max)
+    {
+      guint32 hash = 2166136261u;
+      for (; *ptr != '\0' && *ptr != '\n' && *ptr != '\r'; ptr++)
+	hash = (hash ^ (guchar) *ptr) * 16777619u;
+      g_array_append_val (hashes, hash);
+      if (*ptr == '\0')
+	break;
+      if (*ptr == '\r' && ptr[1] == '\n')
+	ptr++;
+      ptr++;
+    }
+}
+
+/* Finds the lines of A that are unchanged in B using Myers' algorithm,
+   setting MATCH[i] to the line of B matching A[i]. Returns FALSE if more
+   than SD_DIFF_MAX_EDITS edits are needed. */
+
+static gboolean
+sd_diff_myers (const guint32 *a, gint n, const guint32 *b, gint m,
+	       gint *match)
+{
+  gint max = MIN (n + m, SD_DIFF_MAX_EDITS);
+  GPtrArray *trace = g_ptr_array_new_with_free_func (g_free);
+  gint *v = g_new0 (gint, 2 * max + 3);
+  gint *row;
+  gint c = max + 1;
+  gint d;
+  gint k;
+  gint x;
+  gint y;
+
+  for (d = 0; d <= max; d++)
+    {
+      for (k = -d; k <= d; k += 2)
+	{
+	  if (k == -d || (k != d && v[c + k - 1] < v[c + k + 1]))
+	    x = v[c + k + 1];
+	  else
+	    x = v[c + k - 1] + 1;
+	  y = x - k;
+	  while (x < n && y < m && a[x] == b[y])
+	    x++, y++;
+	  v[c + k] = x;
+	  if (x >= n && y >= m)
+	    goto found;
+	}
+      row = g_new (gint, 2 * d + 1);
+      memcpy (row, v + c - d, (2 * d + 1) * sizeof (gint));
+      g_ptr_array_add (trace, row);
+    }
+  g_ptr_array_free (trace, TRUE);
+  g_free (v);
+  return FALSE;
+
+ found:
+  /* Walk back through the furthest points reached at each distance */
+  x = n;
+  y = m;
+  for (; d > 0; d--)
+    {
+      gint *prev = g_ptr_array_index (trace, d - 1);
+      gint prev_k;
+      gint prev_x;
+      gint prev_y;
+
+      k = x - y;
+      if (k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]))
+	prev_k = k + 1;
+      else
+	prev_k = k - 1;
+      prev_x = prev[prev_k + d - 1];
+      prev_y = prev_x - prev_k;
+      while (x > prev_x && y > prev_y)
+	{
+	  x--, y--;
+	  match[x] = y;
+	}
+      x = prev_x;
+      y = prev_y;
+    }
+  while (x > 0 && y > 0)
+    {
+      x--, y--;
+      match[x] = y;
+    }
+  g_ptr_array_free (trace, TRUE);
+  g_free (v);
+  return TRUE;
+}
+
+/* Marks the lines of A between two unchanged lines. Lines replacing lines
+   of the baseline are modified and any extra lines are added. Baseline
+   lines removed with nothing in their place are marked on the line after
+   them. */
+
+static void
+sd_diff_mark_gap (SDDiffJob *job, gint a_start, gint a_end, gint b_start,
+		  gint b_end)
+{
+  gint i;
+  for (i = a_start; i < a_end; i++)
+    g_array_index (job->lines, SDDiffLine, i).marks =
+      i - a_start < b_end - b_start ? SD_DIFF_MODIFIED : SD_DIFF_ADDED;
+  if (a_start == a_end && b_start < b_end)
+    {
+      if (a_end < job->lines->len)
+	g_array_index (job->lines, SDDiffLine, a_end).marks |= SD_DIFF_DELETED;
+      else
+	job->deleted_after = TRUE;
+    }
+}
+
+static void
+sd_diff_thread (GTask *task, gpointer source_object, gpointer task_data,
+		GCancellable *cancellable)
+{
+  SDDiffJob *job = task_data;
+  GArray *hashes = g_array_new (FALSE, FALSE, sizeof (guint32));
+  const guint32 *a;
+  const guint32 *b;
+  gint n = job->end - job->start;
+  gint m = job->base->len;
+  gint prefix = 0;
+  gint suffix = 0;
+  gint *match;
+  gint i;
+  gint j;
+
+  sd_diff_hash_lines (job->text, hashes, n);
+  while (hashes->len < n)
+    {
+      guint32 empty = 2166136261u;
+      g_array_append_val (hashes, empty);
+    }
+  a = (const guint32 *) hashes->data;
+  b = (const guint32 *) job->base->data;
+
+  /* Lines at the edges of an edited region are usually unchanged */
+  match = g_new (gint, MAX (n, 1));
+  for (i = 0; i < n; i++)
+    match[i] = -1;
+  while (prefix < n && prefix < m && a[prefix] == b[prefix])
+    {
+      match[prefix] = prefix;
+      prefix++;
+    }
+  while (suffix < n - prefix && suffix < m - prefix
+	 && a[n - suffix - 1] == b[m - suffix - 1])
+    {
+      match[n - suffix - 1] = m - suffix - 1;
+      suffix++;
+    }
+  if (sd_diff_myers (a + prefix, n - prefix - suffix, b + prefix,
+		     m - prefix - suffix, match + prefix))
+    {
+      for (i = prefix; i < n - suffix; i++)
+	{
+	  if (match[i] != -1)
+	    match[i] += prefix;
+	}
+    }
+  else
+    {
+      for (i = prefix; i < n - suffix; i++)
+	match[i] = -1;
+    }
+
+  job->lines = g_array_sized_new (FALSE, TRUE, sizeof (SDDiffLine), n);
+  g_array_set_size (job->lines, n);
+  for (i = 0, j = 0; i <= n; i++)
+    {
+      gint gap_start = i;
+      while (i < n && match[i] == -1)
+	i++;
+      sd_diff_mark_gap (job, gap_start, i, j, i < n ? match[i] : m);
+      for (; gap_start < i; gap_start++)
+	g_array_index (job->lines, SDDiffLine, gap_start).base = -1;
+      if (i < n)
+	{
+	  g_array_index (job->lines, SDDiffLine, i).base =
+	    job->base_start + match[i];
+	  j = match[i] + 1;
+	}
+    }
+  g_free (match);
+  g_array_unref (hashes);
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean sd_diff_update (gpointer user_data);
+
+static void
+sd_diff_schedule (SDDiff *self)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  if (priv->update_id != 0)
+    g_source_remove (priv->update_id);
+  priv->update_id = g_timeout_add (SD_DIFF_UPDATE_DELAY, sd_diff_update, self);
+}
+
+static void
+sd_diff_update_done (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDDiff *self = SD_DIFF (obj);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  SDDiffJob *job = g_task_get_task_data (G_TASK (result));
+
+  priv->running = FALSE;
+  if (priv->buffer == NULL)
+    return;
+
+  /* The buffer was edited while the diff was running, so line numbers in
+     the result may be out of date */
+  if (job->generation != priv->generation)
+    {
+      sd_diff_schedule (self);
+      return;
+    }
+
+  g_array_remove_range (priv->lines, job->start, job->end - job->start);
+  g_array_insert_vals (priv->lines, job->start, job->lines->data,
+		       job->lines->len);
+  if (job->end < priv->lines->len)
+    {
+      SDDiffLine *line = &g_array_index (priv->lines, SDDiffLine, job->end);
+      if (job->deleted_after)
+	line->marks |= SD_DIFF_DELETED;
+      else
+	line->marks &= ~SD_DIFF_DELETED;
+    }
+  else
+    priv->deleted_at_end = job->deleted_after;
+  priv->dirty_start = -1;
+  g_signal_emit (self, sd_diff_signals[SIGNAL_CHANGED], 0);
+}
+
+/* Diffs the edited region, extended to the nearest unchanged lines on
+   either side. Only the text of that region is copied from the buffer. */
+
+static gboolean
+sd_diff_update (gpointer user_data)
+{
+  SDDiff *self = SD_DIFF (user_data);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  SDDiffJob *job;
+  GtkTextIter start;
+  GtkTextIter end;
+  GTask *task;
+  gint base_end;
+
+  priv->update_id = 0;
+  if (priv->buffer == NULL || priv->dirty_start == -1)
+    return G_SOURCE_REMOVE;
+  if (priv->running)
+    {
+      sd_diff_schedule (self);
+      return G_SOURCE_REMOVE;
+    }
+
+  job = g_malloc0 (sizeof (SDDiffJob));
+  job->generation = priv->generation;
+  job->start = priv->dirty_start;
+  while (job->start > 0
+	 && g_array_index (priv->lines, SDDiffLine, job->start - 1).base < 0)
+    job->start--;
+  job->base_start = job->start == 0 ? 0 :
+    g_array_index (priv->lines, SDDiffLine, job->start - 1).base + 1;
+  job->end = MIN (priv->dirty_end + 1, priv->lines->len);
+  while (job->end < priv->lines->len
+	 && g_array_index (priv->lines, SDDiffLine, job->end).base < 0)
+    job->end++;
+  base_end = job->end < priv->lines->len ?
+    g_array_index (priv->lines, SDDiffLine, job->end).base : priv->base->len;
+
+  job->base = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+				 base_end - job->base_start);
+  g_array_append_vals (job->base,
+		       &g_array_index (priv->base, guint32, job->base_start),
+		       base_end - job->base_start);
+  gtk_text_buffer_get_iter_at_line (priv->buffer, &start, job->start);
+  if (job->end < priv->lines->len)
+    gtk_text_buffer_get_iter_at_line (priv->buffer, &end, job->end);
+  else
+    gtk_text_buffer_get_end_iter (priv->buffer, &end);
+  job->text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+
+  priv->running = TRUE;
+  task = g_task_new (self, NULL, sd_diff_update_done, NULL);
+  g_task_set_task_data (task, job, sd_diff_job_free);
+  g_task_run_in_thread (task, sd_diff_thread);
+  g_object_unref (task);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_diff_set_dirty (SDDiffPrivate *priv, gint start, gint end)
+{
+  if (priv->dirty_start == -1)
+    {
+      priv->dirty_start = start;
+      priv->dirty_end = end;
+    }
+  else
+    {
+      priv->dirty_start = MIN (priv->dirty_start, start);
+      priv->dirty_end = MAX (priv->dirty_end, end);
+    }
+}
+
+/* Edits update the line array immediately, so markers stay attached to
+   the right lines while the diff is pending. New lines are shown as added
+   and edited lines as modified until the diff corrects them. */
+
+static void
+sd_diff_insert_text (GtkTextBuffer *buffer, GtkTextIter *location,
+		     gchar *text, gint len, gpointer user_data)
+{
+  SDDiff *self = SD_DIFF (user_data);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  gint added = gtk_text_buffer_get_line_count (buffer) - priv->lines->len;
+  gint line = gtk_text_iter_get_line (location) - added;
+  SDDiffLine *first = &g_array_index (priv->lines, SDDiffLine, line);
+  gint i;
+
+  if (first->marks == 0 || first->marks == SD_DIFF_DELETED)
+    first->marks |= SD_DIFF_MODIFIED;
+  for (i = 1; i <= added; i++)
+    {
+      SDDiffLine new_line = {-1, SD_DIFF_ADDED};
+      g_array_insert_val (priv->lines, line + i, new_line);
+    }
+  if (priv->dirty_start != -1)
+    {
+      if (priv->dirty_start > line)
+	priv->dirty_start += added;
+      if (priv->dirty_end > line)
+	priv->dirty_end += added;
+    }
+  sd_diff_set_dirty (priv, line, line + added);
+  priv->generation++;
+  g_signal_emit (self, sd_diff_signals[SIGNAL_CHANGED], 0);
+  sd_diff_schedule (self);
+}
+
+static void
+sd_diff_delete_range (GtkTextBuffer *buffer, GtkTextIter *start,
+		      GtkTextIter *end, gpointer user_data)
+{
+  SDDiff *self = SD_DIFF (user_data);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  gint removed = priv->lines->len - gtk_text_buffer_get_line_count (buffer);
+  gint line = gtk_text_iter_get_line (start);
+  SDDiffLine *first;
+
+  if (removed > 0)
+    g_array_remove_range (priv->lines, line + 1, removed);
+  first = &g_array_index (priv->lines, SDDiffLine, line);
+  if (first->marks == 0 || first->marks == SD_DIFF_DELETED)
+    first->marks |= SD_DIFF_MODIFIED;
+  if (priv->dirty_start != -1)
+    {
+      if (priv->dirty_start > line + removed)
+	priv->dirty_start -= removed;
+      else if (priv->dirty_start > line)
+	priv->dirty_start = line;
+      if (priv->dirty_end > line + removed)
+	priv->dirty_end -= removed;
+      else if (priv->dirty_end > line)
+	priv->dirty_end = line;
+    }
+  sd_diff_set_dirty (priv, line, line);
+  priv->generation++;
+  g_signal_emit (self, sd_diff_signals[SIGNAL_CHANGED], 0);
+  sd_diff_schedule (self);
+}
+
+/* Replaces the baseline with TEXT, leaving every line unchanged if SAME is
+   TRUE or otherwise diffing the whole buffer against it */
+
+static void
+sd_diff_set_baseline (SDDiff *self, const gchar *text, gboolean same)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  gint nlines = gtk_text_buffer_get_line_count (priv->buffer);
+  gint i;
+
+  g_array_set_size (priv->base, 0);
+  sd_diff_hash_lines (text, priv->base, G_MAXINT);
+  g_array_set_size (priv->lines, nlines);
+  for (i = 0; i < nlines; i++)
+    {
+      SDDiffLine *line = &g_array_index (priv->lines, SDDiffLine, i);
+      line->base = same ? i : -1;
+      line->marks = 0;
+    }
+  priv->deleted_at_end = FALSE;
+  priv->dirty_start = -1;
+  priv->generation++;
+  if (!same)
+    {
+      sd_diff_set_dirty (priv, 0, nlines - 1);
+      sd_diff_schedule (self);
+    }
+  g_signal_emit (self, sd_diff_signals[SIGNAL_CHANGED], 0);
+}
+
+static void
+sd_diff_dispose (GObject *obj)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (SD_DIFF (obj));
+  if (priv->update_id != 0)
+    {
+      g_source_remove (priv->update_id);
+      priv->update_id = 0;
+    }
+  if (priv->buffer != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->buffer, obj);
+      g_object_remove_weak_pointer (G_OBJECT (priv->buffer),
+				    (gpointer *) &priv->buffer);
+      priv->buffer = NULL;
+    }
+  G_OBJECT_CLASS (sd_diff_parent_class)->dispose (obj);
+}
+
+static void
+sd_diff_finalize (GObject *obj)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (SD_DIFF (obj));
+  g_array_unref (priv->base);
+  g_array_unref (priv->lines);
+  G_OBJECT_CLASS (sd_diff_parent_class)->finalize (obj);
+}
+
+static void
+sd_diff_init (SDDiff *self)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  priv->base = g_array_new (FALSE, FALSE, sizeof (guint32));
+  priv->lines = g_array_new (FALSE, FALSE, sizeof (SDDiffLine));
+  priv->dirty_start = -1;
+}
+
+static void
+sd_diff_class_init (SDDiffClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_diff_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_diff_finalize;
+  sd_diff_signals[SIGNAL_CHANGED] =
+    g_signal_new ("changed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 0,
+		  NULL, NULL, NULL, G_TYPE_NONE, 0);
+}
+
+/* Tracks the changes in BUFFER from its current text. The diff doesn't
+   keep BUFFER alive, so it can be owned by the buffer. */
+
+SDDiff *
+sd_diff_new (GtkTextBuffer *buffer)
+{
+  SDDiff *self = g_object_new (SD_TYPE_DIFF, NULL);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+
+  priv->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer *) &priv->buffer);
+  g_signal_connect_after (buffer, "insert-text",
+			  G_CALLBACK (sd_diff_insert_text), self);
+  g_signal_connect_after (buffer, "delete-range",
+			  G_CALLBACK (sd_diff_delete_range), self);
+  sd_diff_reset (self);
+  return self;
+}
+
+/* Makes the current text of the buffer the baseline, after it is saved.
+   Does nothing if the buffer is compared against the last commit. */
+
+void
+sd_diff_reset (SDDiff *self)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+
+  if (priv->head || priv->buffer == NULL)
+    return;
+  gtk_text_buffer_get_bounds (priv->buffer, &start, &end);
+  text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+  sd_diff_set_baseline (self, text, TRUE);
+  g_free (text);
+}
+
+/* Compares the buffer against its current text after it was replaced with
+   a different file. A pending load of the previous file's last commit is
+   ignored. */
+
+void
+sd_diff_reload (SDDiff *self)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  priv->head = FALSE;
+  priv->head_serial++;
+  sd_diff_reset (self);
+}
+
+static void
+sd_diff_head_loaded (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDDiff *self = SD_DIFF (user_data);
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  gchar *text = NULL;
+
+  if (g_subprocess_communicate_utf8_finish (G_SUBPROCESS (obj), result,
+					    &text, NULL, NULL)
+      && g_subprocess_get_successful (G_SUBPROCESS (obj))
+      && priv->buffer != NULL
+      && GPOINTER_TO_UINT (g_object_get_data (obj, "sd-diff-serial")) ==
+      priv->head_serial)
+    {
+      priv->head = TRUE;
+      sd_diff_set_baseline (self, text, FALSE);
+    }
+  g_free (text);
+  g_object_unref (self);
+}
+
+/* Compares the buffer against FILE as of the last commit instead of the
+   saved file, if FILE is in a git repository */
+
+void
+sd_diff_load_head (SDDiff *self, GFile *file)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  GSubprocessLauncher *launcher;
+  GSubprocess *proc;
+  GFile *parent = g_file_get_parent (file);
+  gchar *dir = g_file_get_path (parent);
+  gchar *name = g_file_get_basename (file);
+  gchar *object = g_strconcat ("HEAD:./", name, NULL);
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE
+					| G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+  g_subprocess_launcher_set_cwd (launcher, dir);
+  proc = g_subprocess_launcher_spawn (launcher, NULL, "git", "show", object,
+				      NULL);
+  if (proc != NULL)
+    {
+      g_object_set_data (G_OBJECT (proc), "sd-diff-serial",
+			 GUINT_TO_POINTER (priv->head_serial));
+      g_subprocess_communicate_utf8_async (proc, NULL, NULL,
+					   sd_diff_head_loaded,
+					   g_object_ref (self));
+      g_object_unref (proc);
+    }
+  g_object_unref (launcher);
+  g_object_unref (parent);
+  g_free (object);
+  g_free (name);
+  g_free (dir);
+}
+
+guint
+sd_diff_get_marks (SDDiff *self, gint line)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  guint marks;
+
+  if (line < 0 || line >= priv->lines->len)
+    return 0;
+  marks = g_array_index (priv->lines, SDDiffLine, line).marks;
+  if (line == priv->lines->len - 1 && priv->deleted_at_end)
+    marks |= SD_DIFF_DELETED_BELOW;
+  return marks;
+}
+
+/* Returns the number of bytes used by the baseline and line states */
+
+gsize
+sd_diff_get_size (SDDiff *self)
+{
+  SDDiffPrivate *priv = sd_diff_get_instance_private (self);
+  return sizeof (SDDiffPrivate) + priv->base->len * sizeof (guint32)
+    + priv->lines->len * sizeof (SDDiffLine);
+}
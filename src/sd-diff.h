@@ -0,0 +1,51 @@
+/* sd-diff.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_DIFF_H
+#define _SD_DIFF_H
+
+#include <gtk/gtk.h>
+
+/* How a line of a buffer differs from the baseline it is compared to */
+
+typedef enum
+{
+  SD_DIFF_ADDED = 1 << 0,
+  SD_DIFF_MODIFIED = 1 << 1,
+  SD_DIFF_DELETED = 1 << 2,
+  SD_DIFF_DELETED_BELOW = 1 << 3
+} SDDiffMark;
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_DIFF sd_diff_get_type ()
+G_DECLARE_FINAL_TYPE (SDDiff, sd_diff, SD, DIFF, GObject)
+
+struct _SDDiff
+{
+  GObject parent;
+};
+
+SDDiff *sd_diff_new (GtkTextBuffer *buffer);
+void sd_diff_reset (SDDiff *self);
+void sd_diff_reload (SDDiff *self);
+void sd_diff_load_head (SDDiff *self, GFile *file);
+guint sd_diff_get_marks (SDDiff *self, gint line);
+gsize sd_diff_get_size (SDDiff *self);
+
+G_END_DECLS
+
+#endif
@@ -15,13 +15,34 @@
    along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
 
 #include <gtksourceview/gtksource.h>
+#include "sd-diff-renderer.h"
 #include "sd-editor.h"
+#include "sd-fold-renderer.h"
+#include "sd-io.h"
+#include "sd-search-bar.h"
+#include "sd-undo.h"
+
+#define SD_EDITOR_MODIFIED_PREFIX "*"
 
 struct _SDEditorTabData
 {
   GtkNotebook *nb;
   GtkWidget *widget;
+  GtkWidget *label;
+  GtkSourceView *view;
+  GtkSourceBuffer *buffer;
+  GPtrArray *views;
+  SDSearchBar *search_bar;
+  SDDiff *diff;
+  SDFold *fold;
+  SDUndo *undo;
   GFile *file;
+  gchar *name;
+  guint generation;
+  gboolean preview;
+  gboolean loading;
+  gboolean saving;
+  gboolean save_pending;
   gint page;
 };
 
@@ -31,18 +52,66 @@ struct _SDEditorPrivate
 {
   GSettings *settings;
   GPtrArray *files;
+  SDEditorTabData *preview;
+  SDEditorTabData *active;
+  GThreadPool *save_pool;
 };
 
 typedef struct _SDEditorPrivate SDEditorPrivate;
 
+/* A set of files being written at once. The batch is finished on the main
+   thread when the last job completes, so failures can be reported
+   together. */
+
+struct _SDEditorSaveBatch
+{
+  SDEditor *editor;
+  GPtrArray *jobs;
+  gint pending;
+};
+
+typedef struct _SDEditorSaveBatch SDEditorSaveBatch;
+
+struct _SDEditorSaveJob
+{
+  SDEditorSaveBatch *batch;
+  SDEditorTabData *data;
+  GtkSourceBuffer *buffer;
+  GFile *file;
+  gchar *text;
+  gsize len;
+  guint generation;
+  GError *err;
+};
+
+typedef struct _SDEditorSaveJob SDEditorSaveJob;
+
 G_DEFINE_TYPE_WITH_PRIVATE (SDEditor, sd_editor, GTK_TYPE_NOTEBOOK)
 
+static void sd_editor_save_thread (gpointer data, gpointer user_data);
+static gboolean sd_editor_save_finish (gpointer user_data);
+static void sd_editor_save_tabs (SDEditor *self, GPtrArray *tabs);
+
+static void
+sd_editor_finalize (GObject *obj)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (SD_EDITOR (obj));
+  g_thread_pool_free (priv->save_pool, FALSE, TRUE);
+  g_ptr_array_free (priv->files, TRUE);
+  g_clear_object (&priv->settings);
+  G_OBJECT_CLASS (sd_editor_parent_class)->finalize (obj);
+}
+
 static void
 sd_editor_init (SDEditor *self)
 {
   SDEditorPrivate *priv = sd_editor_get_instance_private (self);
   priv->settings = g_settings_new (SD_SETTINGS_NAME);
   priv->files = g_ptr_array_new ();
+  /* Writes are I/O bound, so allow more threads than processors */
+  priv->save_pool = g_thread_pool_new (sd_editor_save_thread, NULL,
+				       g_get_num_processors () * 2, FALSE,
+				       NULL);
   gtk_notebook_set_scrollable (GTK_NOTEBOOK (self), TRUE);
   gtk_notebook_popup_enable (GTK_NOTEBOOK (self));
 }
@@ -50,6 +119,57 @@ sd_editor_init (SDEditor *self)
 static void
 sd_editor_class_init (SDEditorClass *klass)
 {
+  G_OBJECT_CLASS (klass)->finalize = sd_editor_finalize;
+}
+
+static void
+sd_editor_tab_data_free (gpointer data)
+{
+  SDEditorTabData *tab = data;
+  g_ptr_array_free (tab->views, TRUE);
+  g_object_unref (tab->diff);
+  g_object_unref (tab->fold);
+  g_object_unref (tab->file);
+  g_free (tab->name);
+  g_free (tab);
+}
+
+static SDEditorTabData *
+sd_editor_get_tab_data (SDEditor *self, GtkWidget *widget)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  gint i;
+  for (i = 0; i < priv->files->len; i++)
+    {
+      SDEditorTabData *data = g_ptr_array_index (priv->files, i);
+      if (data->widget == widget)
+	return data;
+    }
+  return NULL;
+}
+
+static SDEditorTabData *
+sd_editor_get_current_tab_data (SDEditor *self)
+{
+  gint page = gtk_notebook_get_current_page (GTK_NOTEBOOK (self));
+  if (page == -1)
+    return NULL;
+  return sd_editor_get_tab_data (self,
+				 gtk_notebook_get_nth_page (GTK_NOTEBOOK (self),
+							    page));
+}
+
+static gboolean
+sd_editor_has_tab_data (SDEditor *self, SDEditorTabData *data)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  gint i;
+  for (i = 0; i < priv->files->len; i++)
+    {
+      if (g_ptr_array_index (priv->files, i) == data)
+	return TRUE;
+    }
+  return FALSE;
 }
 
 static GtkSourceLanguage *
@@ -130,14 +250,17 @@ sd_editor_guess_lang (const gchar *filename, const gchar *contents, gsize len)
 }
 
 static gboolean
-sd_editor_close_tab (GtkWidget *widget, GdkEvent *event, gpointer user_data)
+sd_editor_close_tab (SDEditorTabData *data)
 {
-  SDEditorTabData *data = user_data;
   SDEditorPrivate *priv = sd_editor_get_instance_private (SD_EDITOR (data->nb));
   gint i;
 
   g_debug ("Closing editor tab %d", data->page);
-  g_ptr_array_remove_fast (priv->files, user_data);
+  g_ptr_array_remove_fast (priv->files, data);
+  if (priv->preview == data)
+    priv->preview = NULL;
+  if (priv->active == data)
+    priv->active = NULL;
   for (i = 0; i < gtk_notebook_get_n_pages (data->nb); i++)
     {
       if (gtk_notebook_get_nth_page (data->nb, i) == data->widget)
@@ -149,44 +272,156 @@ sd_editor_close_tab (GtkWidget *widget, GdkEvent *event, gpointer user_data)
   g_return_val_if_reached (FALSE);
 }
 
+static gboolean
+sd_editor_close_clicked (GtkWidget *widget, GdkEvent *event,
+			 gpointer user_data)
+{
+  return sd_editor_close_tab (user_data);
+}
+
 static void
 sd_editor_switch_page (GtkNotebook *nb, GtkWidget *page, guint pnum,
 		       gpointer user_data)
 {
+  SDEditorPrivate *priv = sd_editor_get_instance_private (SD_EDITOR (nb));
   SDWindow *window = SD_WINDOW (user_data);
   GtkWidget *child = gtk_notebook_get_nth_page (nb, pnum);
-  GtkWidget *tab = gtk_notebook_get_tab_label (nb, child);
-  GList *list = gtk_container_get_children (GTK_CONTAINER (tab));
-  const gchar *name = NULL;
-  GList *ptr;
+  SDEditorTabData *data = sd_editor_get_tab_data (SD_EDITOR (nb), child);
+
+  g_return_if_fail (data != NULL);
+  sd_window_update_title (window, data->name);
+
+  /* The undo history of the tab switched away from can be moved to disk */
+  if (priv->active != NULL && priv->active != data
+      && g_settings_get_boolean (priv->settings, "undo-swap"))
+    sd_undo_set_swapped (priv->active->undo, TRUE);
+  sd_undo_set_swapped (data->undo, FALSE);
+  priv->active = data;
+}
+
+/* Inserted text doesn't take on the tags around it, so the font tag is
+   applied to each insertion as it happens. The default handler has moved
+   LOCATION to the end of the inserted text, and applying a tag leaves it
+   valid for any handlers that run after this one. */
+
+static void
+sd_editor_insert_font (GtkTextBuffer *buffer, GtkTextIter *location,
+		       gchar *text, gint len, gpointer user_data)
+{
+  GtkTextTag *tag = GTK_TEXT_TAG (user_data);
+  GtkTextIter start = *location;
+  gtk_text_iter_backward_chars (&start, g_utf8_strlen (text, len));
+  gtk_text_buffer_apply_tag (buffer, tag, &start, location);
+}
+
+/* Preview tabs have their name in italics */
 
-  for (ptr = list; ptr != NULL; ptr = g_list_next (ptr))
+static void
+sd_editor_update_label (SDEditorTabData *data)
+{
+  gboolean modified =
+    gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (data->buffer));
+  gchar *text = g_strconcat (modified ? SD_EDITOR_MODIFIED_PREFIX : "",
+			     data->name, NULL);
+  if (data->preview)
     {
-      if (GTK_IS_LABEL (ptr->data))
-	{
-	  name = gtk_label_get_text (GTK_LABEL (ptr->data));
-	  break;
-	}
+      gchar *markup = g_markup_printf_escaped ("<i>%s</i>", text);
+      gtk_label_set_markup (GTK_LABEL (data->label), markup);
+      g_free (markup);
     }
-  g_list_free (list);
+  else
+    gtk_label_set_text (GTK_LABEL (data->label), text);
+  g_free (text);
+}
 
-  g_return_if_fail (name != NULL);
-  sd_window_update_title (window, name);
+/* Makes the preview tab a regular tab, so the next file previewed opens
+   in a new one */
+
+static void
+sd_editor_promote (SDEditor *self)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  if (priv->preview == NULL)
+    return;
+  priv->preview->preview = FALSE;
+  sd_editor_update_label (priv->preview);
+  priv->preview = NULL;
 }
 
 static void
-sd_editor_view_changed (GtkTextBuffer *buffer, gpointer user_data)
+sd_editor_buffer_changed (GtkTextBuffer *buffer, gpointer user_data)
 {
-  GSettings *settings = G_SETTINGS (user_data);
-  GtkTextIter start;
-  GtkTextIter end;
-  GtkTextTag *tag =
-    gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (buffer), NULL, NULL);
-  g_settings_bind (settings, "font", tag, "font",
-		   G_SETTINGS_BIND_DEFAULT);
-  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &start);
-  gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (buffer), &end);
-  gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (buffer), tag, &start, &end);
+  SDEditorTabData *data = user_data;
+  data->generation++;
+  if (data->preview && !data->loading)
+    sd_editor_promote (SD_EDITOR (data->nb));
+}
+
+static void
+sd_editor_modified_changed (GtkTextBuffer *buffer, gpointer user_data)
+{
+  SDEditorTabData *data = user_data;
+  sd_editor_update_label (data);
+  if (!gtk_text_buffer_get_modified (buffer))
+    sd_diff_reset (data->diff);
+}
+
+/* The focused view of a tab is the one its find bar and jumps to a line
+   act on */
+
+static gboolean
+sd_editor_view_focused (GtkWidget *widget, GdkEvent *event,
+			gpointer user_data)
+{
+  SDEditorTabData *data = user_data;
+  data->view = GTK_SOURCE_VIEW (widget);
+  sd_search_bar_set_view (data->search_bar, data->view);
+  return FALSE;
+}
+
+static void
+sd_editor_view_destroyed (GtkWidget *widget, gpointer user_data)
+{
+  SDEditorTabData *data = user_data;
+  g_ptr_array_remove (data->views, widget);
+
+  /* The find bar may already be gone if the whole tab is being closed */
+  if (data->view == GTK_SOURCE_VIEW (widget) && data->views->len > 0
+      && !gtk_widget_in_destruction (data->widget))
+    {
+      data->view = g_ptr_array_index (data->views, 0);
+      sd_search_bar_set_view (data->search_bar, data->view);
+    }
+}
+
+/* Adds VIEW to the views of a tab and returns the scrolled window
+   containing it. Every view of a tab shows the same buffer, so the text
+   and its highlighting are stored once however many views there are. */
+
+static GtkWidget *
+sd_editor_add_view (SDEditor *self, SDEditorTabData *data,
+		    GtkSourceView *view)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  GtkWidget *window = gtk_scrolled_window_new (NULL, NULL);
+  GtkSourceGutter *gutter =
+    gtk_source_view_get_gutter (view, GTK_TEXT_WINDOW_LEFT);
+
+  /* Change markers and fold toggles go between the line numbers and the
+     text */
+  gtk_source_gutter_insert (gutter, sd_diff_renderer_new (data->diff), 0);
+  gtk_source_gutter_insert (gutter, sd_fold_renderer_new (data->fold), 1);
+  g_settings_bind (priv->settings, "line-numbers", view,
+		   "show-line-numbers", G_SETTINGS_BIND_DEFAULT);
+  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (view));
+  gtk_widget_set_hexpand (window, TRUE);
+  gtk_widget_set_vexpand (window, TRUE);
+  g_ptr_array_add (data->views, view);
+  g_signal_connect (view, "focus-in-event",
+		    G_CALLBACK (sd_editor_view_focused), data);
+  g_signal_connect (view, "destroy", G_CALLBACK (sd_editor_view_destroyed),
+		    data);
+  return window;
 }
 
 SDEditor *
@@ -198,146 +433,626 @@ sd_editor_new (SDWindow *window)
   return editor;
 }
 
-void
-sd_editor_open_tab (SDEditor *self, const gchar *filename, GFile *file)
+/* Switches to the tab FILE is open in. Returns FALSE if it isn't open. */
+
+static gboolean
+sd_editor_switch_to_file (SDEditor *self, GFile *file)
 {
   SDEditorPrivate *priv = sd_editor_get_instance_private (self);
-  GError *err = NULL;
-  GtkSourceLanguage *lang;
-  GtkSourceBuffer *buffer;
-  GtkSourceView *view;
-  GtkWidget *window;
-  GtkWidget *tab;
-  GtkWidget *event_box;
-  GtkWidget *close_button;
-  SDEditorTabData *user_data;
-  gchar *contents;
-  gsize len;
-  gint page;
   gint i;
+  gint j;
 
-  /* If the file is already open, switch to that tab */
   for (i = 0; i < priv->files->len; i++)
     {
       SDEditorTabData *data = g_ptr_array_index (priv->files, i);
-      if (data->file == file)
+      if (g_file_equal (data->file, file))
 	{
-	  for (i = 0; i < gtk_notebook_get_n_pages (GTK_NOTEBOOK (self)); i++)
+	  for (j = 0; j < gtk_notebook_get_n_pages (GTK_NOTEBOOK (self)); j++)
 	    {
-	      if (gtk_notebook_get_nth_page (GTK_NOTEBOOK (self), i) ==
+	      if (gtk_notebook_get_nth_page (GTK_NOTEBOOK (self), j) ==
 		  data->widget)
 		{
-		  gtk_notebook_set_current_page (GTK_NOTEBOOK (self), i);
-		  return;
+		  gtk_notebook_set_current_page (GTK_NOTEBOOK (self), j);
+		  return TRUE;
 		}
 	    }
-	  g_return_if_reached ();
+	  g_return_val_if_reached (FALSE);
 	}
     }
+  return FALSE;
+}
 
-  g_file_load_contents (file, NULL, &contents, &len, NULL, &err);
+static gboolean
+sd_editor_load_contents (const gchar *filename, GFile *file, gchar **contents,
+			 gsize *len)
+{
+  GError *err = NULL;
+  g_file_load_contents (file, NULL, contents, len, NULL, &err);
   if (err != NULL)
     {
       g_critical ("Failed to open tab `%s': %s", filename, err->message);
       g_error_free (err);
-      return;
+      return FALSE;
     }
+  return TRUE;
+}
 
-  /* Create new editor view */
-  view = GTK_SOURCE_VIEW (gtk_source_view_new ());
-  g_settings_bind (priv->settings, "line-numbers", view,
-		   "show-line-numbers", G_SETTINGS_BIND_DEFAULT);
+/* Replaces the text of BUFFER with the contents of a file, without an undo
+   step, and highlights it for the file's language */
 
-  buffer = GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+static void
+sd_editor_set_contents (GtkSourceBuffer *buffer, const gchar *filename,
+			const gchar *contents, gsize len)
+{
+  GtkSourceLanguage *lang;
+
+  gtk_source_buffer_begin_not_undoable_action (buffer);
   gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), contents, len);
-  g_free (contents);
-  sd_editor_view_changed (GTK_TEXT_BUFFER (buffer), priv->settings);
-  g_signal_connect (buffer, "changed", G_CALLBACK (sd_editor_view_changed),
-		    priv->settings);
+  gtk_source_buffer_end_not_undoable_action (buffer);
+  gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (buffer), FALSE);
 
   /* Apply syntax highlighting to buffer */
   lang = sd_editor_guess_lang (filename, contents, len);
   if (lang == NULL)
     g_debug ("Failed to guess language, applying default highlighting");
   else
+    g_debug ("Guessed language as %s", gtk_source_language_get_name (lang));
+  gtk_source_buffer_set_language (buffer, lang);
+}
+
+gboolean
+sd_editor_open_tab (SDEditor *self, const gchar *filename, GFile *file)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  GtkSourceBuffer *buffer;
+  GtkSourceView *view;
+  SDUndo *undo;
+  GtkTextTag *font_tag;
+  GtkTextIter start;
+  GtkTextIter end;
+  GtkWidget *window;
+  GtkWidget *box;
+  GtkWidget *tab;
+  GtkWidget *event_box;
+  GtkWidget *close_button;
+  SDEditorTabData *user_data;
+  gchar *contents;
+  gsize len;
+  gint page;
+
+  /* If the file is already open, switch to that tab. Opening the file in
+     the preview tab keeps it open. */
+  if (sd_editor_switch_to_file (self, file))
     {
-      g_debug ("Guessed language as %s", gtk_source_language_get_name (lang));
-      gtk_source_buffer_set_language (buffer, lang);
+      if (priv->preview != NULL && g_file_equal (priv->preview->file, file))
+	sd_editor_promote (self);
+      return TRUE;
     }
 
+  if (!sd_editor_load_contents (filename, file, &contents, &len))
+    return FALSE;
+
+  /* Create new editor view */
+  view = GTK_SOURCE_VIEW (gtk_source_view_new ());
+  buffer = GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+  undo = sd_undo_new (GTK_TEXT_BUFFER (buffer), priv->settings);
+  gtk_source_buffer_set_undo_manager (buffer, GTK_SOURCE_UNDO_MANAGER (undo));
+  g_object_unref (undo);
+  sd_editor_set_contents (buffer, filename, contents, len);
+  g_free (contents);
+
+  /* A single font tag covers the whole buffer for the life of the tab */
+  font_tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (buffer), NULL, NULL);
+  g_settings_bind (priv->settings, "font", font_tag, "font",
+		   G_SETTINGS_BIND_DEFAULT);
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
+  gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (buffer), font_tag, &start, &end);
+
   /* Add view to notebook */
+  user_data = g_malloc (sizeof (SDEditorTabData));
   tab = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
   event_box = gtk_event_box_new ();
   close_button = gtk_image_new_from_icon_name ("application-exit",
 					       GTK_ICON_SIZE_BUTTON);
-  window = gtk_scrolled_window_new (NULL, NULL);
+  user_data->label = gtk_label_new (filename);
   gtk_container_add (GTK_CONTAINER (event_box), close_button);
   gtk_container_add (GTK_CONTAINER (tab), event_box);
-  gtk_container_add (GTK_CONTAINER (tab), gtk_label_new (filename));
-  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (view));
-  page = gtk_notebook_append_page (GTK_NOTEBOOK (self), window, tab);
+  gtk_container_add (GTK_CONTAINER (tab), user_data->label);
 
-  user_data = g_malloc (sizeof (SDEditorTabData));
+  /* The tab data is owned by the buffer so that pending saves can still
+     refer to it after the tab is closed */
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
   user_data->nb = GTK_NOTEBOOK (self);
-  user_data->widget = window;
-  user_data->file = file;
-  user_data->page = page;
+  user_data->widget = box;
+  user_data->view = view;
+  user_data->buffer = buffer;
+  user_data->file = g_object_ref (file);
+  user_data->name = g_strdup (filename);
+  user_data->generation = 0;
+  user_data->undo = undo;
+  user_data->preview = FALSE;
+  user_data->loading = FALSE;
+  user_data->saving = FALSE;
+  user_data->save_pending = FALSE;
+  user_data->views = g_ptr_array_new ();
+  user_data->diff = sd_diff_new (GTK_TEXT_BUFFER (buffer));
+  if (g_settings_get_boolean (priv->settings, "diff-against-head"))
+    sd_diff_load_head (user_data->diff, file);
+  user_data->fold = sd_fold_new (GTK_TEXT_BUFFER (buffer), file);
+
+  /* Each tab has its own find bar above its views */
+  user_data->search_bar = sd_search_bar_new (view);
+  window = sd_editor_add_view (self, user_data, view);
+  gtk_container_add (GTK_CONTAINER (box), GTK_WIDGET (user_data->search_bar));
+  gtk_container_add (GTK_CONTAINER (box), window);
+  g_object_set_data_full (G_OBJECT (buffer), "sd-editor-tab", user_data,
+			  sd_editor_tab_data_free);
   g_signal_connect (event_box, "button-release-event",
-		    G_CALLBACK (sd_editor_close_tab), user_data);
+		    G_CALLBACK (sd_editor_close_clicked), user_data);
+  g_signal_connect (buffer, "changed", G_CALLBACK (sd_editor_buffer_changed),
+		    user_data);
+  g_signal_connect (buffer, "modified-changed",
+		    G_CALLBACK (sd_editor_modified_changed), user_data);
+  g_signal_connect_after (buffer, "insert-text",
+			  G_CALLBACK (sd_editor_insert_font), font_tag);
+  g_ptr_array_add (priv->files, user_data);
 
   gtk_widget_show_all (tab);
+  gtk_widget_show_all (box);
+  page = gtk_notebook_append_page (GTK_NOTEBOOK (self), box, tab);
+  user_data->page = page;
   gtk_widget_show_all (GTK_WIDGET (self));
+  gtk_notebook_set_current_page (GTK_NOTEBOOK (self), page);
+  return TRUE;
+}
 
-  g_ptr_array_add (priv->files, user_data);
+/* Shows FILE in the preview tab, which is reused for each file previewed
+   until it is edited or the file is opened normally. Only the buffer's
+   text is replaced, so browsing files doesn't create new widgets. */
+
+void
+sd_editor_preview_tab (SDEditor *self, const gchar *filename, GFile *file)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  SDEditorTabData *data = priv->preview;
+  GtkWidget *toplevel;
+  GtkTextIter start;
+  gchar *contents;
+  gsize len;
+
+  if (sd_editor_switch_to_file (self, file))
+    return;
+  if (data == NULL)
+    {
+      if (sd_editor_open_tab (self, filename, file))
+	{
+	  data = g_ptr_array_index (priv->files, priv->files->len - 1);
+	  data->preview = TRUE;
+	  priv->preview = data;
+	  sd_editor_update_label (data);
+	}
+      return;
+    }
+  if (!sd_editor_load_contents (filename, file, &contents, &len))
+    return;
+
+  data->loading = TRUE;
+  sd_editor_set_contents (data->buffer, filename, contents, len);
+  data->loading = FALSE;
+  g_free (contents);
+  g_object_unref (data->file);
+  data->file = g_object_ref (file);
+  g_free (data->name);
+  data->name = g_strdup (filename);
+  sd_diff_reload (data->diff);
+  sd_fold_set_file (data->fold, file);
+  if (g_settings_get_boolean (priv->settings, "diff-against-head"))
+    sd_diff_load_head (data->diff, file);
+  sd_editor_update_label (data);
+
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (data->buffer), &start);
+  gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (data->buffer), &start);
+  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (data->view), &start, 0, FALSE,
+				0, 0);
+  sd_editor_switch_to_file (self, file);
+  toplevel = gtk_widget_get_toplevel (GTK_WIDGET (self));
+  if (SD_IS_WINDOW (toplevel))
+    sd_window_update_title (SD_WINDOW (toplevel), data->name);
+}
+
+/* Returns the files open in the editor in tab order, and the index of the
+   current tab in CURRENT */
+
+GPtrArray *
+sd_editor_get_files (SDEditor *self, gint *current)
+{
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_object_unref);
+  gint i;
+
+  *current = gtk_notebook_get_current_page (GTK_NOTEBOOK (self));
+  for (i = 0; i < gtk_notebook_get_n_pages (GTK_NOTEBOOK (self)); i++)
+    {
+      GtkWidget *widget = gtk_notebook_get_nth_page (GTK_NOTEBOOK (self), i);
+      SDEditorTabData *data = sd_editor_get_tab_data (self, widget);
+      if (data != NULL)
+	g_ptr_array_add (files, g_object_ref (data->file));
+    }
+  return files;
+}
+
+/* Closes the tab showing FILE, if there is one. Returns whether a tab was
+   closed. */
+
+gboolean
+sd_editor_close_file (SDEditor *self, GFile *file)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  gint i;
+  for (i = 0; i < priv->files->len; i++)
+    {
+      SDEditorTabData *data = g_ptr_array_index (priv->files, i);
+      if (g_file_equal (data->file, file))
+	return sd_editor_close_tab (data);
+    }
+  return FALSE;
+}
+
+/* Returns the number of tabs the editor keeps records for, which is the
+   number of pages in the notebook */
+
+guint
+sd_editor_get_n_tabs (SDEditor *self)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  return priv->files->len;
+}
+
+/* Returns the buffer of the tab FILE is open in, or NULL if it isn't open */
+
+GtkTextBuffer *
+sd_editor_get_buffer (SDEditor *self, GFile *file)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  gint i;
+  for (i = 0; i < priv->files->len; i++)
+    {
+      SDEditorTabData *data = g_ptr_array_index (priv->files, i);
+      if (g_file_equal (data->file, file))
+	return GTK_TEXT_BUFFER (data->buffer);
+    }
+  return NULL;
+}
+
+void
+sd_editor_goto_line (SDEditor *self, gint line, gint column)
+{
+  SDEditorTabData *data = sd_editor_get_current_tab_data (self);
+  GtkTextIter iter;
+
+  if (data == NULL)
+    return;
+
+  /* Lines and columns are numbered from 1, as in compiler output */
+  gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (data->buffer), &iter,
+				    MAX (line - 1, 0));
+  if (column > 1 && gtk_text_iter_get_chars_in_line (&iter) >= column)
+    gtk_text_iter_set_line_offset (&iter, column - 1);
+  gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (data->buffer), &iter);
+  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (data->view), &iter, 0.25,
+				FALSE, 0, 0);
+  gtk_widget_grab_focus (GTK_WIDGET (data->view));
+}
+
+/* Shows the find bar of the current tab */
+
+void
+sd_editor_find (SDEditor *self)
+{
+  SDEditorTabData *data = sd_editor_get_current_tab_data (self);
+  if (data != NULL)
+    sd_search_bar_start (data->search_bar);
+}
+
+/* Splits the focused view of the current tab in two, side by side if
+   ORIENTATION is horizontal or stacked if it is vertical. The new view
+   shares the tab's buffer. */
+
+void
+sd_editor_split (SDEditor *self, GtkOrientation orientation)
+{
+  SDEditorTabData *data = sd_editor_get_current_tab_data (self);
+  GtkSourceView *view;
+  GtkAllocation alloc;
+  GtkWidget *window;
+  GtkWidget *old;
+  GtkWidget *parent;
+  GtkWidget *paned;
+  gboolean first = FALSE;
+
+  if (data == NULL)
+    return;
+  old = gtk_widget_get_parent (GTK_WIDGET (data->view));
+  parent = gtk_widget_get_parent (old);
+  if (GTK_IS_PANED (parent))
+    first = gtk_paned_get_child1 (GTK_PANED (parent)) == old;
+  gtk_widget_get_allocation (old, &alloc);
+
+  view = GTK_SOURCE_VIEW (gtk_source_view_new_with_buffer (data->buffer));
+  window = sd_editor_add_view (self, data, view);
+  paned = gtk_paned_new (orientation);
+  g_object_ref (old);
+  gtk_container_remove (GTK_CONTAINER (parent), old);
+  gtk_paned_pack1 (GTK_PANED (paned), old, TRUE, FALSE);
+  gtk_paned_pack2 (GTK_PANED (paned), window, TRUE, FALSE);
+  g_object_unref (old);
+  gtk_paned_set_position (GTK_PANED (paned),
+			  (orientation == GTK_ORIENTATION_HORIZONTAL ?
+			   alloc.width : alloc.height) / 2);
+
+  if (!GTK_IS_PANED (parent))
+    gtk_container_add (GTK_CONTAINER (parent), paned);
+  else if (first)
+    gtk_paned_pack1 (GTK_PANED (parent), paned, TRUE, FALSE);
+  else
+    gtk_paned_pack2 (GTK_PANED (parent), paned, TRUE, FALSE);
+  gtk_widget_show_all (paned);
+
+  gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (view),
+				gtk_text_buffer_get_insert
+				(GTK_TEXT_BUFFER (data->buffer)), 0.25, FALSE,
+				0, 0);
+  gtk_widget_grab_focus (GTK_WIDGET (view));
+}
+
+/* Closes the focused view of the current tab, if it has more than one */
+
+void
+sd_editor_unsplit (SDEditor *self)
+{
+  SDEditorTabData *data = sd_editor_get_current_tab_data (self);
+  GtkWidget *window;
+  GtkWidget *paned;
+  GtkWidget *parent;
+  GtkWidget *sibling;
+  gboolean first = FALSE;
+
+  if (data == NULL || data->views->len < 2)
+    return;
+  window = gtk_widget_get_parent (GTK_WIDGET (data->view));
+  paned = gtk_widget_get_parent (window);
+  parent = gtk_widget_get_parent (paned);
+  g_return_if_fail (GTK_IS_PANED (paned));
+  sibling = gtk_paned_get_child1 (GTK_PANED (paned)) == window ?
+    gtk_paned_get_child2 (GTK_PANED (paned)) :
+    gtk_paned_get_child1 (GTK_PANED (paned));
+  if (GTK_IS_PANED (parent))
+    first = gtk_paned_get_child1 (GTK_PANED (parent)) == paned;
+
+  g_object_ref (sibling);
+  gtk_container_remove (GTK_CONTAINER (paned), sibling);
+  gtk_widget_destroy (paned);
+  if (!GTK_IS_PANED (parent))
+    gtk_container_add (GTK_CONTAINER (parent), sibling);
+  else if (first)
+    gtk_paned_pack1 (GTK_PANED (parent), sibling, TRUE, FALSE);
+  else
+    gtk_paned_pack2 (GTK_PANED (parent), sibling, TRUE, FALSE);
+  g_object_unref (sibling);
+  gtk_widget_grab_focus (GTK_WIDGET (data->view));
 }
 
 static void
-sd_editor_save_text (GFile *file, GtkTextBuffer *buffer)
+sd_editor_save_thread (gpointer data, gpointer user_data)
 {
-  GtkTextIter start;
-  GtkTextIter end;
-  gchar *text;
-  GError *err = NULL;
+  SDEditorSaveJob *job = data;
+  gchar *path = g_file_get_path (job->file);
 
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_end_iter (buffer, &end);
-  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-  g_file_replace_contents (file, text, strlen (text), NULL, FALSE,
-			   G_FILE_CREATE_NONE, NULL, NULL, &err);
-  g_free (text);
-  if (err != NULL)
+  if (path == NULL)
+    g_file_replace_contents (job->file, job->text, job->len, NULL, FALSE,
+			     G_FILE_CREATE_NONE, NULL, NULL, &job->err);
+  else
+    sd_io_replace_contents (path, job->text, job->len, &job->err);
+  g_free (path);
+  g_free (job->text);
+  job->text = NULL;
+
+  if (g_atomic_int_dec_and_test (&job->batch->pending))
+    g_idle_add (sd_editor_save_finish, job->batch);
+}
+
+static gboolean
+sd_editor_save_finish (gpointer user_data)
+{
+  SDEditorSaveBatch *batch = user_data;
+  GString *errors = g_string_new (NULL);
+  GPtrArray *resave = g_ptr_array_new ();
+  GPtrArray *buffers = g_ptr_array_new_with_free_func (g_object_unref);
+  guint nfailed = 0;
+  gint i;
+
+  for (i = 0; i < batch->jobs->len; i++)
     {
-      gchar *path = g_file_get_path (file);
-      g_critical ("Failed to write to %s: %s", path, err->message);
-      g_free (path);
-      g_error_free (err);
+      SDEditorSaveJob *job = g_ptr_array_index (batch->jobs, i);
+      if (job->err != NULL)
+	{
+	  gchar *path = g_file_get_parse_name (job->file);
+	  g_critical ("Failed to write to %s: %s", path, job->err->message);
+	  g_string_append_printf (errors, "%s: %s\n", path, job->err->message);
+	  g_free (path);
+	  g_error_free (job->err);
+	  nfailed++;
+	}
+      else if (job->generation == job->data->generation
+	       && sd_editor_has_tab_data (batch->editor, job->data))
+	{
+	  /* Only mark the buffer clean if it was not edited while it was
+	     being written and its tab is still open */
+	  gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (job->buffer), FALSE);
+	}
+
+      /* Saves requested while this one was running were held back so the
+	 writes could not be reordered, and now save the latest text */
+      job->data->saving = FALSE;
+      if (job->data->save_pending)
+	{
+	  job->data->save_pending = FALSE;
+	  g_ptr_array_add (resave, job->data);
+	  g_ptr_array_add (buffers, g_object_ref (job->buffer));
+	}
+      g_object_unref (job->buffer);
+      g_object_unref (job->file);
+      g_free (job);
+    }
+
+  if (nfailed > 0 && gtk_widget_get_realized (GTK_WIDGET (batch->editor)))
+    {
+      GtkWidget *toplevel =
+	gtk_widget_get_toplevel (GTK_WIDGET (batch->editor));
+      GtkWidget *dialog =
+	gtk_message_dialog_new (GTK_WINDOW (toplevel),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+				"Failed to save %u of %u files", nfailed,
+				batch->jobs->len);
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog),
+						"%s", errors->str);
+      g_signal_connect_swapped (dialog, "response",
+				G_CALLBACK (gtk_widget_destroy), dialog);
+      gtk_widget_show (dialog);
+    }
+
+  /* The tab data of a closed tab lives only as long as its buffer, so the
+     buffers are held until the new jobs have taken their own references */
+  sd_editor_save_tabs (batch->editor, resave);
+  g_ptr_array_free (resave, TRUE);
+  g_ptr_array_free (buffers, TRUE);
+  g_string_free (errors, TRUE);
+  g_ptr_array_free (batch->jobs, TRUE);
+  g_object_unref (batch->editor);
+  g_free (batch);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_editor_save_tabs (SDEditor *self, GPtrArray *tabs)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  SDEditorSaveBatch *batch;
+  gint i;
+
+  if (tabs->len == 0)
+    return;
+
+  batch = g_malloc (sizeof (SDEditorSaveBatch));
+  batch->editor = g_object_ref (self);
+  batch->jobs = g_ptr_array_sized_new (tabs->len);
+
+  /* Snapshot every buffer before starting any writes, so the contents on
+     disk match what was in the editor when the save was requested. Only
+     one save of a tab runs at a time, or an older snapshot could be
+     renamed over a newer one, so a save requested while another is
+     running is held back and saves the latest text once that finishes. */
+  for (i = 0; i < tabs->len; i++)
+    {
+      SDEditorTabData *data = g_ptr_array_index (tabs, i);
+      SDEditorSaveJob *job;
+      GtkTextIter start;
+      GtkTextIter end;
+
+      if (data->saving)
+	{
+	  data->save_pending = TRUE;
+	  continue;
+	}
+      data->saving = TRUE;
+      job = g_malloc (sizeof (SDEditorSaveJob));
+      gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (data->buffer), &start,
+				  &end);
+      job->batch = batch;
+      job->data = data;
+      job->buffer = g_object_ref (data->buffer);
+      job->file = g_object_ref (data->file);
+      job->text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (data->buffer),
+					    &start, &end, FALSE);
+      job->len = strlen (job->text);
+      job->generation = data->generation;
+      job->err = NULL;
+      g_ptr_array_add (batch->jobs, job);
+    }
+
+  if (batch->jobs->len == 0)
+    {
+      g_ptr_array_free (batch->jobs, TRUE);
+      g_object_unref (batch->editor);
+      g_free (batch);
+      return;
     }
+  batch->pending = batch->jobs->len;
+  for (i = 0; i < batch->jobs->len; i++)
+    g_thread_pool_push (priv->save_pool, g_ptr_array_index (batch->jobs, i),
+			NULL);
 }
 
 void
 sd_editor_save_file (SDEditor *self)
 {
-  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
   gint page = gtk_notebook_get_current_page (GTK_NOTEBOOK (self));
-  GtkWidget *widget;
-  gint i;
+  SDEditorTabData *data;
+  GPtrArray *tabs;
 
   if (page == -1)
     return; /* No page currently open */
 
   g_debug ("Saving contents of tab %d to disk", page);
-  widget = gtk_notebook_get_nth_page (GTK_NOTEBOOK (self), page);
+  data = sd_editor_get_tab_data (self,
+				 gtk_notebook_get_nth_page (GTK_NOTEBOOK (self),
+							    page));
+  g_return_if_fail (data != NULL);
+  tabs = g_ptr_array_new ();
+  g_ptr_array_add (tabs, data);
+  sd_editor_save_tabs (self, tabs);
+  g_ptr_array_free (tabs, TRUE);
+}
+
+void
+sd_editor_save_all (SDEditor *self)
+{
+  SDEditorPrivate *priv = sd_editor_get_instance_private (self);
+  GPtrArray *tabs = g_ptr_array_new ();
+  gint i;
+
   for (i = 0; i < priv->files->len; i++)
     {
       SDEditorTabData *data = g_ptr_array_index (priv->files, i);
-      if (data->widget == widget)
-	{
-	  GList *list = gtk_container_get_children (GTK_CONTAINER (widget));
-	  GtkTextBuffer *buffer =
-	    gtk_text_view_get_buffer (GTK_TEXT_VIEW (list->data));
-	  sd_editor_save_text (data->file, buffer);
-	  return;
-	}
+      if (gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (data->buffer)))
+	g_ptr_array_add (tabs, data);
+    }
+  g_debug ("Saving %u modified tabs to disk", tabs->len);
+  sd_editor_save_tabs (self, tabs);
+  g_ptr_array_free (tabs, TRUE);
+}
+
+/* Adds the estimated memory use of each tab to REPORT, in tab order */
+
+void
+sd_editor_get_memory (SDEditor *self, SDMemoryReport *report)
+{
+  gint i;
+
+  for (i = 0; i < gtk_notebook_get_n_pages (GTK_NOTEBOOK (self)); i++)
+    {
+      SDEditorTabData *data =
+	sd_editor_get_tab_data (self,
+				gtk_notebook_get_nth_page (GTK_NOTEBOOK (self),
+							   i));
+      if (data == NULL)
+	continue;
+      sd_memory_report_begin (report, data->name);
+      sd_memory_report_add_buffer (report, GTK_TEXT_BUFFER (data->buffer));
+      sd_memory_report_add (report, "Undo history",
+			    sd_undo_get_size (data->undo));
+      sd_memory_report_add (report, "Change markers",
+			    sd_diff_get_size (data->diff));
+      sd_memory_report_add (report, "Folds", sd_fold_get_size (data->fold));
     }
-  g_return_if_reached ();
 }
@@ -17,6 +17,7 @@
 #ifndef _SD_EDITOR_H
 #define _SD_EDITOR_H
 
+#include "sd-memory.h"
 #include "sd-window.h"
 
 G_BEGIN_DECLS
@@ -30,8 +31,21 @@ struct _SDEditor
 };
 
 SDEditor *sd_editor_new (SDWindow *window);
-void sd_editor_open_tab (SDEditor *self, const gchar *filename, GFile *file);
+gboolean sd_editor_open_tab (SDEditor *self, const gchar *filename,
+			     GFile *file);
+void sd_editor_preview_tab (SDEditor *self, const gchar *filename,
+			    GFile *file);
+void sd_editor_goto_line (SDEditor *self, gint line, gint column);
+void sd_editor_find (SDEditor *self);
+void sd_editor_split (SDEditor *self, GtkOrientation orientation);
+void sd_editor_unsplit (SDEditor *self);
+GPtrArray *sd_editor_get_files (SDEditor *self, gint *current);
+gboolean sd_editor_close_file (SDEditor *self, GFile *file);
+guint sd_editor_get_n_tabs (SDEditor *self);
+GtkTextBuffer *sd_editor_get_buffer (SDEditor *self, GFile *file);
 void sd_editor_save_file (SDEditor *self);
+void sd_editor_save_all (SDEditor *self);
+void sd_editor_get_memory (SDEditor *self, SDMemoryReport *report);
 
 G_END_DECLS
 
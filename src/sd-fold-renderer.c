@@ -0,0 +1,127 @@
+/* sd-fold-renderer.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-fold-renderer.h"
+
+/* Width of the gutter column in pixels */
+#define SD_FOLD_RENDERER_SIZE 12
+
+struct _SDFoldRendererPrivate
+{
+  SDFold *fold;
+};
+
+typedef struct _SDFoldRendererPrivate SDFoldRendererPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDFoldRenderer, sd_fold_renderer,
+			    GTK_SOURCE_TYPE_GUTTER_RENDERER)
+
+/* Draws a triangle beside lines that start a region, pointing right if the
+   region is folded and down if it isn't */
+
+static void
+sd_fold_renderer_draw (GtkSourceGutterRenderer *renderer, cairo_t *cr,
+		       GdkRectangle *background_area, GdkRectangle *cell_area,
+		       GtkTextIter *start, GtkTextIter *end,
+		       GtkSourceGutterRendererState state)
+{
+  SDFoldRendererPrivate *priv =
+    sd_fold_renderer_get_instance_private (SD_FOLD_RENDERER (renderer));
+  SDFoldState fold = sd_fold_get_state (priv->fold,
+					gtk_text_iter_get_line (start));
+  gdouble size = MIN (cell_area->width, cell_area->height) / 2.0;
+  gdouble x = cell_area->x + (cell_area->width - size) / 2.0;
+  gdouble y = cell_area->y + (cell_area->height - size) / 2.0;
+
+  GTK_SOURCE_GUTTER_RENDERER_CLASS (sd_fold_renderer_parent_class)->draw
+    (renderer, cr, background_area, cell_area, start, end, state);
+  if (fold == SD_FOLD_NONE)
+    return;
+  cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
+  if (fold == SD_FOLD_FOLDED)
+    {
+      cairo_move_to (cr, x, y);
+      cairo_line_to (cr, x + size, y + size / 2);
+      cairo_line_to (cr, x, y + size);
+    }
+  else
+    {
+      cairo_move_to (cr, x, y);
+      cairo_line_to (cr, x + size, y);
+      cairo_line_to (cr, x + size / 2, y + size);
+    }
+  cairo_close_path (cr);
+  cairo_fill (cr);
+}
+
+static gboolean
+sd_fold_renderer_query_activatable (GtkSourceGutterRenderer *renderer,
+				    GtkTextIter *iter, GdkRectangle *area,
+				    GdkEvent *event)
+{
+  SDFoldRendererPrivate *priv =
+    sd_fold_renderer_get_instance_private (SD_FOLD_RENDERER (renderer));
+  return sd_fold_get_state (priv->fold, gtk_text_iter_get_line (iter)) !=
+    SD_FOLD_NONE;
+}
+
+static void
+sd_fold_renderer_activate (GtkSourceGutterRenderer *renderer,
+			   GtkTextIter *iter, GdkRectangle *area,
+			   GdkEvent *event)
+{
+  SDFoldRendererPrivate *priv =
+    sd_fold_renderer_get_instance_private (SD_FOLD_RENDERER (renderer));
+  sd_fold_toggle (priv->fold, gtk_text_iter_get_line (iter));
+}
+
+static void
+sd_fold_renderer_dispose (GObject *obj)
+{
+  SDFoldRendererPrivate *priv =
+    sd_fold_renderer_get_instance_private (SD_FOLD_RENDERER (obj));
+  g_clear_object (&priv->fold);
+  G_OBJECT_CLASS (sd_fold_renderer_parent_class)->dispose (obj);
+}
+
+static void
+sd_fold_renderer_init (SDFoldRenderer *self)
+{
+}
+
+static void
+sd_fold_renderer_class_init (SDFoldRendererClass *klass)
+{
+  GtkSourceGutterRendererClass *renderer_class =
+    GTK_SOURCE_GUTTER_RENDERER_CLASS (klass);
+  G_OBJECT_CLASS (klass)->dispose = sd_fold_renderer_dispose;
+  renderer_class->draw = sd_fold_renderer_draw;
+  renderer_class->query_activatable = sd_fold_renderer_query_activatable;
+  renderer_class->activate = sd_fold_renderer_activate;
+}
+
+GtkSourceGutterRenderer *
+sd_fold_renderer_new (SDFold *fold)
+{
+  SDFoldRenderer *self = g_object_new (SD_TYPE_FOLD_RENDERER, "size",
+				       SD_FOLD_RENDERER_SIZE, NULL);
+  SDFoldRendererPrivate *priv = sd_fold_renderer_get_instance_private (self);
+  priv->fold = g_object_ref (fold);
+  g_signal_connect_object (fold, "changed",
+			   G_CALLBACK (gtk_source_gutter_renderer_queue_draw),
+			   self, G_CONNECT_SWAPPED);
+  return GTK_SOURCE_GUTTER_RENDERER (self);
+}
@@ -0,0 +1,788 @@
+/* sd-fold.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <string.h>
+#include <gtksourceview/gtksource.h>
+#include "sd-fold.h"
+
+/* Delay in milliseconds between an edit and finding the fold regions
+   again, so they are recomputed at most this often while typing */
+#define SD_FOLD_UPDATE_DELAY 250
+
+/* Number of files whose fold regions are remembered after closing them */
+#define SD_FOLD_CACHE_SIZE 64
+
+#define SD_FOLD_TAB_WIDTH 8
+
+/* A region starting at line START. Folding it hides the lines after START
+   up to END, so the line with the closing brace stays visible. */
+
+struct _SDFoldRegion
+{
+  gint start;
+  gint end;
+  gboolean folded;
+};
+
+typedef struct _SDFoldRegion SDFoldRegion;
+
+struct _SDFoldJob
+{
+  guint generation;
+  gboolean indent;
+  gchar *text;
+  GArray *regions;
+  guint checksum;
+};
+
+typedef struct _SDFoldJob SDFoldJob;
+
+/* The regions of a file as of when its text had CHECKSUM */
+
+struct _SDFoldCacheEntry
+{
+  guint checksum;
+  GArray *regions;
+};
+
+typedef struct _SDFoldCacheEntry SDFoldCacheEntry;
+
+/* REGIONS are sorted by their first line. No region covers more than
+   SPAN lines, which bounds how far before an edit the regions containing
+   it can start. CHECKSUM is the checksum of the text they were found in,
+   which is still the text of the buffer if GENERATION hasn't changed
+   since CHECKSUM_GENERATION. */
+
+struct _SDFoldPrivate
+{
+  GtkTextBuffer *buffer;
+  GtkTextTag *tag;
+  gchar *key;
+  GArray *regions;
+  gint span;
+  gint nlines;
+  guint generation;
+  guint checksum;
+  guint checksum_generation;
+  guint update_id;
+  guint sync_id;
+  gboolean running;
+};
+
+typedef struct _SDFoldPrivate SDFoldPrivate;
+
+enum
+{
+  SIGNAL_CHANGED,
+  N_SIGNALS
+};
+
+static guint sd_fold_signals[N_SIGNALS];
+
+/* Languages whose blocks are found by indentation instead of braces */
+static const gchar *const sd_fold_indent_langs[] = {
+  "coffee", "haskell", "python", "python3", "yaml", NULL
+};
+
+static GHashTable *sd_fold_cache;
+static GQueue sd_fold_cache_order = G_QUEUE_INIT;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDFold, sd_fold, G_TYPE_OBJECT)
+
+static void
+sd_fold_job_free (gpointer data)
+{
+  SDFoldJob *job = data;
+  g_free (job->text);
+  if (job->regions != NULL)
+    g_array_unref (job->regions);
+  g_free (job);
+}
+
+static void
+sd_fold_cache_entry_free (gpointer data)
+{
+  SDFoldCacheEntry *entry = data;
+  g_array_unref (entry->regions);
+  g_free (entry);
+}
+
+static void
+sd_fold_cache_store (const gchar *key, guint checksum, GArray *regions)
+{
+  SDFoldCacheEntry *entry = g_malloc (sizeof (SDFoldCacheEntry));
+  GList *link;
+
+  if (sd_fold_cache == NULL)
+    sd_fold_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					   sd_fold_cache_entry_free);
+  link = g_queue_find_custom (&sd_fold_cache_order, key,
+			      (GCompareFunc) strcmp);
+  if (link != NULL)
+    {
+      g_free (link->data);
+      g_queue_delete_link (&sd_fold_cache_order, link);
+    }
+  g_queue_push_tail (&sd_fold_cache_order, g_strdup (key));
+  while (sd_fold_cache_order.length > SD_FOLD_CACHE_SIZE)
+    {
+      gchar *oldest = g_queue_pop_head (&sd_fold_cache_order);
+      g_hash_table_remove (sd_fold_cache, oldest);
+      g_free (oldest);
+    }
+
+  entry->checksum = checksum;
+  entry->regions = g_array_sized_new (FALSE, FALSE, sizeof (SDFoldRegion),
+				      regions->len);
+  g_array_append_vals (entry->regions, regions->data, regions->len);
+  g_hash_table_insert (sd_fold_cache, g_strdup (key), entry);
+}
+
+static void
+sd_fold_add_region (GArray *regions, gint start, gint end)
+{
+  SDFoldRegion region = {start, end, FALSE};
+  if (end - start >= 2)
+    g_array_append_val (regions, region);
+}
+
+/* Finds regions between matching braces, skipping braces in comments and
+   string or character literals */
+
+static void
+sd_fold_scan_braces (const gchar *text, GArray *regions)
+{
+  GArray *stack = g_array_new (FALSE, FALSE, sizeof (gint));
+  const gchar *ptr;
+  gboolean line_comment = FALSE;
+  gboolean block_comment = FALSE;
+  gchar quote = '\0';
+  gint line = 0;
+  gint start;
+
+  for (ptr = text; *ptr != '\0'; ptr++)
+    {
+      if (*ptr == '\n')
+	{
+	  line++;
+	  line_comment = FALSE;
+	  quote = '\0';
+	  continue;
+	}
+      if (line_comment)
+	continue;
+      if (block_comment)
+	{
+	  if (*ptr == '*' && ptr[1] == '/')
+	    {
+	      block_comment = FALSE;
+	      ptr++;
+	    }
+	  continue;
+	}
+      if (quote != '\0')
+	{
+	  if (*ptr == '\\' && ptr[1] != '\0' && ptr[1] != '\n')
+	    ptr++;
+	  else if (*ptr == quote)
+	    quote = '\0';
+	  continue;
+	}
+
+      switch (*ptr)
+	{
+	case '"':
+	case '\'':
+	  quote = *ptr;
+	  break;
+	case '/':
+	  if (ptr[1] == '/')
+	    line_comment = TRUE;
+	  else if (ptr[1] == '*')
+	    {
+	      block_comment = TRUE;
+	      ptr++;
+	    }
+	  break;
+	case '{':
+	  g_array_append_val (stack, line);
+	  break;
+	case '}':
+	  if (stack->len == 0)
+	    break;
+	  start = g_array_index (stack, gint, stack->len - 1);
+	  g_array_set_size (stack, stack->len - 1);
+	  sd_fold_add_region (regions, start, line);
+	  break;
+	}
+    }
+  g_array_unref (stack);
+}
+
+/* Finds regions of lines indented further than the line before them.
+   Blank lines at the end of a region are left outside it. */
+
+static void
+sd_fold_scan_indent (const gchar *text, GArray *regions)
+{
+  GArray *stack = g_array_new (FALSE, FALSE, sizeof (gint));
+  const gchar *ptr = text;
+  gint line = 0;
+  gint last = -1;
+
+  while (TRUE)
+    {
+      gint indent = 0;
+      for (; *ptr == ' ' || *ptr == '\t'; ptr++)
+	indent = *ptr == '\t' ?
+	  (indent / SD_FOLD_TAB_WIDTH + 1) * SD_FOLD_TAB_WIDTH : indent + 1;
+      if (*ptr != '\n' && *ptr != '\r' && *ptr != '\0')
+	{
+	  /* The stack holds the line and indentation of each open block */
+	  while (stack->len > 0
+		 && g_array_index (stack, gint, stack->len - 1) >= indent)
+	    {
+	      sd_fold_add_region (regions,
+				  g_array_index (stack, gint, stack->len - 2),
+				  last + 1);
+	      g_array_set_size (stack, stack->len - 2);
+	    }
+	  g_array_append_val (stack, line);
+	  g_array_append_val (stack, indent);
+	  last = line;
+	}
+      ptr = strchr (ptr, '\n');
+      if (ptr == NULL)
+	break;
+      ptr++;
+      line++;
+    }
+  for (; stack->len > 0; g_array_set_size (stack, stack->len - 2))
+    sd_fold_add_region (regions, g_array_index (stack, gint, stack->len - 2),
+			last + 1);
+  g_array_unref (stack);
+}
+
+/* Sorts regions by their first line, outermost first */
+
+static gint
+sd_fold_region_compare (gconstpointer a, gconstpointer b)
+{
+  const SDFoldRegion *ra = a;
+  const SDFoldRegion *rb = b;
+  if (ra->start != rb->start)
+    return ra->start < rb->start ? -1 : 1;
+  return rb->end - ra->end;
+}
+
+static void
+sd_fold_thread (GTask *task, gpointer source_object, gpointer task_data,
+		GCancellable *cancellable)
+{
+  SDFoldJob *job = task_data;
+  guint i;
+  guint j;
+
+  job->checksum = g_str_hash (job->text);
+  job->regions = g_array_new (FALSE, FALSE, sizeof (SDFoldRegion));
+  if (job->indent)
+    sd_fold_scan_indent (job->text, job->regions);
+  else
+    sd_fold_scan_braces (job->text, job->regions);
+  g_array_sort (job->regions, sd_fold_region_compare);
+
+  /* Only the outermost of regions starting on the same line is kept */
+  for (i = 0, j = 0; i < job->regions->len; i++)
+    {
+      if (j > 0 && g_array_index (job->regions, SDFoldRegion, j - 1).start ==
+	  g_array_index (job->regions, SDFoldRegion, i).start)
+	continue;
+      g_array_index (job->regions, SDFoldRegion, j++) =
+	g_array_index (job->regions, SDFoldRegion, i);
+    }
+  g_array_set_size (job->regions, j);
+  g_task_return_boolean (task, TRUE);
+}
+
+/* Hides the lines of folded regions with an invisible tag, which also
+   saves GtkTextView from laying them out */
+
+/* Finds the most lines covered by any region, after they were replaced */
+
+static void
+sd_fold_set_span (SDFoldPrivate *priv)
+{
+  guint i;
+
+  priv->span = 0;
+  for (i = 0; i < priv->regions->len; i++)
+    {
+      SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+      priv->span = MAX (priv->span, region->end - region->start);
+    }
+}
+
+/* Returns the index of the first region starting at or after LINE */
+
+static guint
+sd_fold_search (SDFoldPrivate *priv, gint line)
+{
+  guint low = 0;
+  guint high = priv->regions->len;
+
+  while (low < high)
+    {
+      guint mid = (low + high) / 2;
+      if (g_array_index (priv->regions, SDFoldRegion, mid).start < line)
+	low = mid + 1;
+      else
+	high = mid;
+    }
+  return low;
+}
+
+static void
+sd_fold_sync (SDFold *self)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  GtkTextIter start;
+  GtkTextIter end;
+  guint i;
+
+  if (priv->buffer == NULL)
+    return;
+  gtk_text_buffer_get_bounds (priv->buffer, &start, &end);
+  gtk_text_buffer_remove_tag (priv->buffer, priv->tag, &start, &end);
+  for (i = 0; i < priv->regions->len; i++)
+    {
+      SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+      if (!region->folded || region->end - region->start < 2
+	  || region->start + 1 >= priv->nlines)
+	continue;
+      gtk_text_buffer_get_iter_at_line (priv->buffer, &start,
+					region->start + 1);
+      if (region->end < priv->nlines)
+	gtk_text_buffer_get_iter_at_line (priv->buffer, &end, region->end);
+      else
+	gtk_text_buffer_get_end_iter (priv->buffer, &end);
+      gtk_text_buffer_apply_tag (priv->buffer, priv->tag, &start, &end);
+    }
+}
+
+static gboolean
+sd_fold_sync_idle (gpointer user_data)
+{
+  SDFold *self = SD_FOLD (user_data);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  priv->sync_id = 0;
+  sd_fold_sync (self);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean sd_fold_update (gpointer user_data);
+
+static void
+sd_fold_schedule (SDFold *self, guint delay)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  if (priv->update_id != 0)
+    g_source_remove (priv->update_id);
+  priv->update_id = g_timeout_add (delay, sd_fold_update, self);
+}
+
+static void
+sd_fold_update_done (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDFold *self = SD_FOLD (obj);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  SDFoldJob *job = g_task_get_task_data (G_TASK (result));
+  guint i;
+  guint j;
+
+  priv->running = FALSE;
+  if (priv->buffer == NULL)
+    return;
+
+  /* The buffer was edited while the regions were being found, so line
+     numbers in the result may be out of date */
+  if (job->generation != priv->generation)
+    {
+      sd_fold_schedule (self, SD_FOLD_UPDATE_DELAY);
+      return;
+    }
+
+  /* Regions stay folded if they still start on the same line */
+  for (i = 0, j = 0; i < job->regions->len; i++)
+    {
+      SDFoldRegion *region = &g_array_index (job->regions, SDFoldRegion, i);
+      while (j < priv->regions->len
+	     && g_array_index (priv->regions, SDFoldRegion, j).start <
+	     region->start)
+	j++;
+      if (j < priv->regions->len
+	  && g_array_index (priv->regions, SDFoldRegion, j).start ==
+	  region->start)
+	region->folded = g_array_index (priv->regions, SDFoldRegion, j).folded;
+    }
+  g_array_unref (priv->regions);
+  priv->regions = g_array_ref (job->regions);
+  sd_fold_set_span (priv);
+  priv->checksum = job->checksum;
+  priv->checksum_generation = priv->generation;
+  sd_fold_sync (self);
+  sd_fold_cache_store (priv->key, priv->checksum, priv->regions);
+  g_signal_emit (self, sd_fold_signals[SIGNAL_CHANGED], 0);
+}
+
+static gboolean
+sd_fold_update (gpointer user_data)
+{
+  SDFold *self = SD_FOLD (user_data);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  GtkSourceLanguage *lang = NULL;
+  SDFoldJob *job;
+  GtkTextIter start;
+  GtkTextIter end;
+  GTask *task;
+
+  priv->update_id = 0;
+  if (priv->buffer == NULL)
+    return G_SOURCE_REMOVE;
+  if (priv->running)
+    {
+      sd_fold_schedule (self, SD_FOLD_UPDATE_DELAY);
+      return G_SOURCE_REMOVE;
+    }
+
+  job = g_malloc0 (sizeof (SDFoldJob));
+  job->generation = priv->generation;
+  if (GTK_SOURCE_IS_BUFFER (priv->buffer))
+    lang = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (priv->buffer));
+  job->indent = lang == NULL
+    || g_strv_contains (sd_fold_indent_langs,
+			gtk_source_language_get_id (lang));
+  gtk_text_buffer_get_bounds (priv->buffer, &start, &end);
+  job->text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+
+  priv->running = TRUE;
+  task = g_task_new (self, NULL, sd_fold_update_done, NULL);
+  g_task_set_task_data (task, job, sd_fold_job_free);
+  g_task_run_in_thread (task, sd_fold_thread);
+  g_object_unref (task);
+  return G_SOURCE_REMOVE;
+}
+
+/* Edits move the regions immediately, so the gutter stays in place while
+   the regions are found again. Only the regions that could contain the
+   edit and those after it are visited. A folded region whose hidden lines
+   are edited is unfolded. */
+
+static void
+sd_fold_edited (SDFold *self, gboolean moved, gboolean unfolded)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  if (unfolded && priv->sync_id == 0)
+    priv->sync_id = g_idle_add (sd_fold_sync_idle, self);
+  priv->generation++;
+  if (moved || unfolded)
+    g_signal_emit (self, sd_fold_signals[SIGNAL_CHANGED], 0);
+  if (priv->update_id == 0)
+    sd_fold_schedule (self, SD_FOLD_UPDATE_DELAY);
+}
+
+static void
+sd_fold_insert_text (GtkTextBuffer *buffer, GtkTextIter *location,
+		     gchar *text, gint len, gpointer user_data)
+{
+  SDFold *self = SD_FOLD (user_data);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  gint added = gtk_text_buffer_get_line_count (buffer) - priv->nlines;
+  gint line = gtk_text_iter_get_line (location) - added;
+  guint after = sd_fold_search (priv, line + 1);
+  gboolean unfolded = FALSE;
+  guint i;
+
+  /* Regions starting on or before the line only grow if they contain it */
+  for (i = sd_fold_search (priv, line - priv->span); i < after; i++)
+    {
+      SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+      if (region->folded && line > region->start && line < region->end)
+	{
+	  region->folded = FALSE;
+	  unfolded = TRUE;
+	}
+      if (region->end > line)
+	{
+	  region->end += added;
+	  priv->span = MAX (priv->span, region->end - region->start);
+	}
+    }
+  if (added != 0)
+    for (; i < priv->regions->len; i++)
+      {
+	SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+	region->start += added;
+	region->end += added;
+      }
+  priv->nlines += added;
+  sd_fold_edited (self, added != 0, unfolded);
+}
+
+static void
+sd_fold_delete_range (GtkTextBuffer *buffer, GtkTextIter *start,
+		      GtkTextIter *end, gpointer user_data)
+{
+  SDFold *self = SD_FOLD (user_data);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  gint removed = priv->nlines - gtk_text_buffer_get_line_count (buffer);
+  gint line = gtk_text_iter_get_line (start);
+  guint after = sd_fold_search (priv, line + removed + 1);
+  gboolean unfolded = FALSE;
+  guint i;
+
+  /* Regions starting after the deleted lines only move up. Deleting lines
+     never makes a region longer, so SPAN stays a bound. */
+  for (i = sd_fold_search (priv, line - priv->span); i < after; i++)
+    {
+      SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+      if (region->folded && line < region->end
+	  && line + removed > region->start)
+	{
+	  region->folded = FALSE;
+	  unfolded = TRUE;
+	}
+      if (region->start > line)
+	region->start = line;
+      if (region->end > line + removed)
+	region->end -= removed;
+      else if (region->end > line)
+	region->end = line;
+    }
+  if (removed != 0)
+    for (; i < priv->regions->len; i++)
+      {
+	SDFoldRegion *region = &g_array_index (priv->regions, SDFoldRegion, i);
+	region->start -= removed;
+	region->end -= removed;
+      }
+  priv->nlines -= removed;
+  sd_fold_edited (self, removed != 0, unfolded);
+}
+
+static void
+sd_fold_dispose (GObject *obj)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (SD_FOLD (obj));
+  if (priv->update_id != 0)
+    {
+      g_source_remove (priv->update_id);
+      priv->update_id = 0;
+    }
+  if (priv->sync_id != 0)
+    {
+      g_source_remove (priv->sync_id);
+      priv->sync_id = 0;
+    }
+  if (priv->buffer != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->buffer, obj);
+      g_object_remove_weak_pointer (G_OBJECT (priv->buffer),
+				    (gpointer *) &priv->buffer);
+      priv->buffer = NULL;
+    }
+  G_OBJECT_CLASS (sd_fold_parent_class)->dispose (obj);
+}
+
+static void
+sd_fold_finalize (GObject *obj)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (SD_FOLD (obj));
+  g_array_unref (priv->regions);
+  g_free (priv->key);
+  G_OBJECT_CLASS (sd_fold_parent_class)->finalize (obj);
+}
+
+static void
+sd_fold_init (SDFold *self)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  priv->regions = g_array_new (FALSE, FALSE, sizeof (SDFoldRegion));
+}
+
+static void
+sd_fold_class_init (SDFoldClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_fold_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_fold_finalize;
+  sd_fold_signals[SIGNAL_CHANGED] =
+    g_signal_new ("changed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 0,
+		  NULL, NULL, NULL, G_TYPE_NONE, 0);
+}
+
+/* Finds the regions of BUFFER that can be folded, which has the contents
+   of FILE. The fold doesn't keep BUFFER alive, so it can be owned by the
+   buffer. */
+
+SDFold *
+sd_fold_new (GtkTextBuffer *buffer, GFile *file)
+{
+  SDFold *self = g_object_new (SD_TYPE_FOLD, NULL);
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+
+  priv->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer *) &priv->buffer);
+  priv->tag = gtk_text_buffer_create_tag (buffer, NULL, "invisible", TRUE,
+					  NULL);
+  priv->nlines = gtk_text_buffer_get_line_count (buffer);
+  g_signal_connect_after (buffer, "insert-text",
+			  G_CALLBACK (sd_fold_insert_text), self);
+  g_signal_connect_after (buffer, "delete-range",
+			  G_CALLBACK (sd_fold_delete_range), self);
+  sd_fold_set_file (self, file);
+  return self;
+}
+
+/* Starts over with the regions of FILE, after the buffer was replaced with
+   its contents. If the file was open before with the same contents, its
+   regions and their fold state are restored without finding them
+   again. */
+
+void
+sd_fold_set_file (SDFold *self, GFile *file)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  SDFoldCacheEntry *entry = NULL;
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+
+  g_free (priv->key);
+  priv->key = g_file_get_uri (file);
+  priv->generation++;
+  g_array_set_size (priv->regions, 0);
+  priv->span = 0;
+  if (sd_fold_cache != NULL)
+    entry = g_hash_table_lookup (sd_fold_cache, priv->key);
+  if (entry != NULL)
+    {
+      /* Fold state is carried over to the new regions by line number if
+	 the file changed since */
+      g_array_append_vals (priv->regions, entry->regions->data,
+			   entry->regions->len);
+      sd_fold_set_span (priv);
+      gtk_text_buffer_get_bounds (priv->buffer, &start, &end);
+      text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+      priv->checksum = g_str_hash (text);
+      g_free (text);
+      if (priv->checksum == entry->checksum)
+	{
+	  priv->checksum_generation = priv->generation;
+	  sd_fold_sync (self);
+	  g_signal_emit (self, sd_fold_signals[SIGNAL_CHANGED], 0);
+	  return;
+	}
+    }
+  g_signal_emit (self, sd_fold_signals[SIGNAL_CHANGED], 0);
+  sd_fold_schedule (self, 0);
+}
+
+/* Returns the region starting at LINE, or NULL if there is none */
+
+static SDFoldRegion *
+sd_fold_find (SDFoldPrivate *priv, gint line)
+{
+  guint low = sd_fold_search (priv, line);
+  SDFoldRegion *region;
+
+  if (low == priv->regions->len)
+    return NULL;
+  region = &g_array_index (priv->regions, SDFoldRegion, low);
+  if (region->start != line || region->end - region->start < 2)
+    return NULL;
+  return region;
+}
+
+/* Returns whether LINE starts a region and whether it is folded */
+
+SDFoldState
+sd_fold_get_state (SDFold *self, gint line)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  SDFoldRegion *region = sd_fold_find (priv, line);
+  if (region == NULL)
+    return SD_FOLD_NONE;
+  return region->folded ? SD_FOLD_FOLDED : SD_FOLD_EXPANDED;
+}
+
+/* Folds or unfolds the region starting at LINE. The cursor is moved out
+   of the region if it would be hidden. */
+
+void
+sd_fold_toggle (SDFold *self, gint line)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  SDFoldRegion *region = sd_fold_find (priv, line);
+  GtkTextIter iter;
+  gint cursor;
+
+  if (priv->buffer == NULL || region == NULL)
+    return;
+  region->folded = !region->folded;
+  gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter,
+				    gtk_text_buffer_get_insert (priv->buffer));
+  cursor = gtk_text_iter_get_line (&iter);
+  if (region->folded && cursor > region->start && cursor < region->end)
+    {
+      gtk_text_buffer_get_iter_at_line (priv->buffer, &iter, region->start);
+      gtk_text_iter_forward_to_line_end (&iter);
+      gtk_text_buffer_place_cursor (priv->buffer, &iter);
+    }
+  sd_fold_sync (self);
+  if (priv->checksum_generation == priv->generation)
+    sd_fold_cache_store (priv->key, priv->checksum, priv->regions);
+  g_signal_emit (self, sd_fold_signals[SIGNAL_CHANGED], 0);
+}
+
+/* Returns the number of bytes used by the regions of the buffer */
+
+gsize
+sd_fold_get_size (SDFold *self)
+{
+  SDFoldPrivate *priv = sd_fold_get_instance_private (self);
+  return sizeof (SDFoldPrivate) + priv->regions->len * sizeof (SDFoldRegion);
+}
+
+/* Returns the number of bytes used by the regions remembered for files */
+
+gsize
+sd_fold_get_cache_size (void)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  gsize size = 0;
+
+  if (sd_fold_cache == NULL)
+    return 0;
+  g_hash_table_iter_init (&iter, sd_fold_cache);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      SDFoldCacheEntry *entry = value;
+      size += 2 * (strlen (key) + 1) + sizeof (SDFoldCacheEntry)
+	+ entry->regions->len * sizeof (SDFoldRegion);
+    }
+  return size;
+}
@@ -0,0 +1,50 @@
+/* sd-fold.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_FOLD_H
+#define _SD_FOLD_H
+
+#include <gtk/gtk.h>
+
+/* Whether a line starts a region that can be folded */
+
+typedef enum
+{
+  SD_FOLD_NONE,
+  SD_FOLD_EXPANDED,
+  SD_FOLD_FOLDED
+} SDFoldState;
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_FOLD sd_fold_get_type ()
+G_DECLARE_FINAL_TYPE (SDFold, sd_fold, SD, FOLD, GObject)
+
+struct _SDFold
+{
+  GObject parent;
+};
+
+SDFold *sd_fold_new (GtkTextBuffer *buffer, GFile *file);
+void sd_fold_set_file (SDFold *self, GFile *file);
+SDFoldState sd_fold_get_state (SDFold *self, gint line);
+void sd_fold_toggle (SDFold *self, gint line);
+gsize sd_fold_get_size (SDFold *self);
+gsize sd_fold_get_cache_size (void);
+
+G_END_DECLS
+
+#endif
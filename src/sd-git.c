@@ -0,0 +1,1162 @@
+/* sd-git.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+#include "sd-git.h"
+#include "sd-ignore.h"
+
+/* Delay in milliseconds between a file change and refreshing its status,
+   so bursts of changes are handled together */
+#define SD_GIT_REFRESH_DELAY 250
+
+#define SD_GIT_INDEX_SIGNATURE "DIRC"
+#define SD_GIT_INDEX_HEADER_SIZE 12
+#define SD_GIT_INDEX_ENTRY_SIZE 62
+#define SD_GIT_INDEX_CHECKSUM_SIZE 20
+#define SD_GIT_INDEX_EXTENDED 0x4000
+#define SD_GIT_INDEX_SKIP_WORKTREE 0x4000
+
+/* When the number of index entries changes by more than one in
+   SD_GIT_INDEX_RESCAN_RATIO, such as after checking out another branch,
+   the work tree is rescanned instead of checking each changed entry */
+#define SD_GIT_INDEX_RESCAN_RATIO 4
+
+/* Estimated bytes used by a hash table node, apart from its key and value,
+   and by a directory monitor with its inotify watch */
+#define SD_GIT_NODE_SIZE (3 * sizeof (gpointer))
+#define SD_GIT_MONITOR_SIZE 1024
+
+/* The stat data and object id recorded for a path in .git/index */
+
+struct _SDGitIndexEntry
+{
+  guint32 mtime_sec;
+  guint32 mtime_nsec;
+  guint32 mode;
+  guint32 size;
+  guchar sha[20];
+  gboolean conflict;
+  gboolean skip_worktree;
+};
+
+typedef struct _SDGitIndexEntry SDGitIndexEntry;
+
+struct _SDGitStatusPrivate
+{
+  SDGitStatusFunc func;
+  gpointer user_data;
+  gchar *root;
+  gchar *gitdir;
+  gchar *prefix;
+  GFile *root_file;
+  GThreadPool *worker;
+  GHashTable *monitors;
+  GFileMonitor *index_monitor;
+  GHashTable *pending;
+  gboolean pending_full;
+  gboolean pending_index;
+  guint timeout_id;
+  gsize size;
+
+  /* Only accessed by the worker thread */
+  guint32 index_version;
+  gsize index_size;
+  GHashTable *index;
+  GHashTable *tracked_dirs;
+  GHashTable *states;
+  GHashTable *dir_states;
+  GHashTable *dirty;
+  GHashTable *ignore_dirs;
+  SDIgnore *ignore;
+};
+
+typedef struct _SDGitStatusPrivate SDGitStatusPrivate;
+
+struct _SDGitRequest
+{
+  SDGitStatus *status;
+  GPtrArray *paths;
+  gboolean full;
+  gboolean index;
+};
+
+typedef struct _SDGitRequest SDGitRequest;
+
+struct _SDGitResult
+{
+  SDGitStatus *status;
+  GPtrArray *deltas;
+  GPtrArray *dirs;
+  gboolean full;
+  gsize size;
+};
+
+typedef struct _SDGitResult SDGitResult;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDGitStatus, sd_git_status, G_TYPE_OBJECT)
+
+static void sd_git_status_thread (gpointer data, gpointer user_data);
+
+static void
+sd_git_delta_free (gpointer data)
+{
+  SDGitDelta *delta = data;
+  g_free (delta->path);
+  g_free (delta);
+}
+
+static void
+sd_git_monitor_free (gpointer data)
+{
+  g_file_monitor_cancel (G_FILE_MONITOR (data));
+  g_object_unref (data);
+}
+
+static void
+sd_git_status_dispose (GObject *obj)
+{
+  SDGitStatusPrivate *priv =
+    sd_git_status_get_instance_private (SD_GIT_STATUS (obj));
+  priv->func = NULL;
+  if (priv->timeout_id != 0)
+    {
+      g_source_remove (priv->timeout_id);
+      priv->timeout_id = 0;
+    }
+  if (priv->index_monitor != NULL)
+    {
+      sd_git_monitor_free (priv->index_monitor);
+      priv->index_monitor = NULL;
+    }
+  g_hash_table_remove_all (priv->monitors);
+  G_OBJECT_CLASS (sd_git_status_parent_class)->dispose (obj);
+}
+
+static void
+sd_git_status_finalize (GObject *obj)
+{
+  SDGitStatusPrivate *priv =
+    sd_git_status_get_instance_private (SD_GIT_STATUS (obj));
+  g_thread_pool_free (priv->worker, TRUE, TRUE);
+  g_hash_table_unref (priv->monitors);
+  g_hash_table_unref (priv->pending);
+  g_hash_table_unref (priv->index);
+  g_hash_table_unref (priv->tracked_dirs);
+  g_hash_table_unref (priv->states);
+  g_hash_table_unref (priv->dir_states);
+  g_hash_table_unref (priv->dirty);
+  g_hash_table_unref (priv->ignore_dirs);
+  if (priv->ignore != NULL)
+    sd_ignore_free (priv->ignore);
+  g_object_unref (priv->root_file);
+  g_free (priv->root);
+  g_free (priv->gitdir);
+  g_free (priv->prefix);
+  G_OBJECT_CLASS (sd_git_status_parent_class)->finalize (obj);
+}
+
+static void
+sd_git_status_init (SDGitStatus *self)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  /* A single worker keeps requests in order and owns the status tables */
+  priv->worker = g_thread_pool_new (sd_git_status_thread, NULL, 1, FALSE,
+				    NULL);
+  priv->monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					  sd_git_monitor_free);
+  priv->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					 NULL);
+  priv->index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+				       g_free);
+  priv->tracked_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					      NULL);
+  priv->states = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					NULL);
+  priv->dir_states = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					    NULL);
+  priv->dirty = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  priv->ignore_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					     NULL);
+}
+
+static void
+sd_git_status_class_init (SDGitStatusClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_git_status_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_git_status_finalize;
+}
+
+static guint32
+sd_git_read32 (const guchar *ptr)
+{
+  return ((guint32) ptr[0] << 24) | ((guint32) ptr[1] << 16)
+    | ((guint32) ptr[2] << 8) | ptr[3];
+}
+
+static guint16
+sd_git_read16 (const guchar *ptr)
+{
+  return (ptr[0] << 8) | ptr[1];
+}
+
+static void
+sd_git_add_tracked_dirs (GHashTable *dirs, const gchar *path)
+{
+  const gchar *ptr;
+  for (ptr = strchr (path, '/'); ptr != NULL; ptr = strchr (ptr + 1, '/'))
+    {
+      gchar *dir = g_strndup (path, ptr - path);
+      g_hash_table_add (dirs, dir);
+    }
+}
+
+/* Reads .git/index through a memory map. Only entries under the project
+   directory are kept, with their paths made relative to it. Versions 2 to
+   4 of the index format are supported. */
+
+static gboolean
+sd_git_status_read_index (SDGitStatusPrivate *priv, GHashTable *index,
+			  GHashTable *dirs, guint32 *version_out)
+{
+  GError *err = NULL;
+  GMappedFile *map;
+  GString *name;
+  const guchar *data;
+  const guchar *ptr;
+  const guchar *end;
+  gsize prefix_len = strlen (priv->prefix);
+  gchar *path;
+  guint32 version;
+  guint32 count;
+  guint32 i;
+
+  path = g_build_filename (priv->gitdir, "index", NULL);
+  map = g_mapped_file_new (path, FALSE, &err);
+  if (map == NULL)
+    {
+      /* A repository without any commits may not have an index yet */
+      if (!g_error_matches (err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+	g_warning ("Failed to map %s: %s", path, err->message);
+      g_error_free (err);
+      g_free (path);
+      return FALSE;
+    }
+
+  data = (const guchar *) g_mapped_file_get_contents (map);
+  end = data + g_mapped_file_get_length (map);
+  if (end - data < SD_GIT_INDEX_HEADER_SIZE + SD_GIT_INDEX_CHECKSUM_SIZE
+      || memcmp (data, SD_GIT_INDEX_SIGNATURE, 4) != 0)
+    {
+      g_warning ("%s is not a git index", path);
+      goto fail;
+    }
+  version = sd_git_read32 (data + 4);
+  if (version < 2 || version > 4)
+    {
+      g_warning ("%s has unsupported index version %u", path, version);
+      goto fail;
+    }
+  *version_out = version;
+  count = sd_git_read32 (data + 8);
+  end -= SD_GIT_INDEX_CHECKSUM_SIZE;
+  ptr = data + SD_GIT_INDEX_HEADER_SIZE;
+  name = g_string_new (NULL);
+
+  for (i = 0; i < count; i++)
+    {
+      SDGitIndexEntry *entry;
+      const guchar *nul;
+      guint16 flags;
+      guint16 ext_flags = 0;
+      gsize header = SD_GIT_INDEX_ENTRY_SIZE;
+
+      if (end - ptr < SD_GIT_INDEX_ENTRY_SIZE)
+	goto truncated;
+      flags = sd_git_read16 (ptr + 60);
+      if (flags & SD_GIT_INDEX_EXTENDED)
+	{
+	  if (version < 3 || end - ptr < SD_GIT_INDEX_ENTRY_SIZE + 2)
+	    goto truncated;
+	  ext_flags = sd_git_read16 (ptr + 62);
+	  header += 2;
+	}
+
+      if (version == 4)
+	{
+	  /* Paths are prefix-compressed against the previous entry */
+	  const guchar *p = ptr + header;
+	  gsize strip;
+	  if (p >= end)
+	    goto truncated;
+	  strip = *p & 0x7f;
+	  while (*p++ & 0x80)
+	    {
+	      if (p >= end)
+		goto truncated;
+	      strip = ((strip + 1) << 7) | (*p & 0x7f);
+	    }
+	  nul = memchr (p, '\0', end - p);
+	  if (nul == NULL || strip > name->len)
+	    goto truncated;
+	  g_string_truncate (name, name->len - strip);
+	  g_string_append_len (name, (const gchar *) p, nul - p);
+	}
+      else
+	{
+	  nul = memchr (ptr + header, '\0', end - (ptr + header));
+	  if (nul == NULL)
+	    goto truncated;
+	  g_string_assign (name, (const gchar *) ptr + header);
+	}
+
+      if (strncmp (name->str, priv->prefix, prefix_len) == 0)
+	{
+	  const gchar *rel = name->str + prefix_len;
+	  entry = g_hash_table_lookup (index, rel);
+	  if (entry != NULL)
+	    entry->conflict = TRUE; /* Multiple stages during a merge */
+	  else
+	    {
+	      entry = g_malloc (sizeof (SDGitIndexEntry));
+	      entry->mtime_sec = sd_git_read32 (ptr + 8);
+	      entry->mtime_nsec = sd_git_read32 (ptr + 12);
+	      entry->mode = sd_git_read32 (ptr + 24);
+	      entry->size = sd_git_read32 (ptr + 36);
+	      memcpy (entry->sha, ptr + 40, 20);
+	      entry->conflict = (flags & 0x3000) != 0;
+	      entry->skip_worktree =
+		(ext_flags & SD_GIT_INDEX_SKIP_WORKTREE) != 0;
+	      g_hash_table_insert (index, g_strdup (rel), entry);
+	      sd_git_add_tracked_dirs (dirs, rel);
+	    }
+	}
+
+      if (version == 4)
+	ptr = nul + 1;
+      else
+	ptr += (header + (nul - (ptr + header)) + 8) & ~7;
+    }
+
+  g_string_free (name, TRUE);
+  g_mapped_file_unref (map);
+  g_free (path);
+  return TRUE;
+
+ truncated:
+  g_warning ("%s is truncated or corrupt", path);
+  g_string_free (name, TRUE);
+ fail:
+  g_mapped_file_unref (map);
+  g_free (path);
+  return FALSE;
+}
+
+/* Computes the git object id of a file and compares it to SHA */
+
+static gboolean
+sd_git_status_hash_matches (const gchar *path, GStatBuf *st,
+			    const guchar *sha)
+{
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  guint8 digest[20];
+  gsize digest_len = sizeof (digest);
+  gchar *header;
+  gboolean ret = FALSE;
+
+  header = g_strdup_printf ("blob %" G_GUINT64_FORMAT, (guint64) st->st_size);
+  g_checksum_update (checksum, (const guchar *) header, strlen (header) + 1);
+  g_free (header);
+
+  if (S_ISLNK (st->st_mode))
+    {
+      gchar *target = g_file_read_link (path, NULL);
+      if (target == NULL)
+	goto finish;
+      g_checksum_update (checksum, (const guchar *) target, strlen (target));
+      g_free (target);
+    }
+  else
+    {
+      guchar buffer[65536];
+      FILE *file = g_fopen (path, "rb");
+      gsize len;
+      if (file == NULL)
+	goto finish;
+      while ((len = fread (buffer, 1, sizeof (buffer), file)) > 0)
+	g_checksum_update (checksum, buffer, len);
+      fclose (file);
+    }
+
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  ret = memcmp (digest, sha, 20) == 0;
+
+ finish:
+  g_checksum_free (checksum);
+  return ret;
+}
+
+static SDGitState
+sd_git_status_check_file (SDGitStatusPrivate *priv, const gchar *rel,
+			  const gchar *path, GStatBuf *st)
+{
+  SDGitIndexEntry *entry = g_hash_table_lookup (priv->index, rel);
+  if (entry == NULL)
+    return sd_ignore_is_ignored (priv->ignore, rel, FALSE) ?
+      SD_GIT_STATE_IGNORED : SD_GIT_STATE_UNTRACKED;
+  if (entry->skip_worktree)
+    return SD_GIT_STATE_CLEAN;
+  if (entry->conflict)
+    return SD_GIT_STATE_MODIFIED;
+  if (S_ISREG (st->st_mode) && (entry->mode & 0100) != (st->st_mode & 0100))
+    return SD_GIT_STATE_MODIFIED;
+  if (entry->size != (guint32) st->st_size)
+    return SD_GIT_STATE_MODIFIED;
+  if (entry->mtime_sec == (guint32) st->st_mtime
+      && (entry->mtime_nsec == 0
+	  || entry->mtime_nsec == (guint32) st->st_mtim.tv_nsec))
+    return SD_GIT_STATE_CLEAN;
+
+  /* The timestamp changed but the contents might not have */
+  return sd_git_status_hash_matches (path, st, entry->sha) ?
+    SD_GIT_STATE_CLEAN : SD_GIT_STATE_MODIFIED;
+}
+
+/* Records the state of a path in STATES, which holds either files or
+   directories, and adds a delta if it changed */
+
+static void
+sd_git_status_set (GHashTable *states, GPtrArray *deltas, const gchar *path,
+		   SDGitState state)
+{
+  SDGitDelta *delta;
+  SDGitState old = GPOINTER_TO_INT (g_hash_table_lookup (states, path));
+
+  if (old == state)
+    return;
+  if (state == SD_GIT_STATE_CLEAN)
+    g_hash_table_remove (states, path);
+  else
+    g_hash_table_insert (states, g_strdup (path), GINT_TO_POINTER (state));
+
+  delta = g_malloc (sizeof (SDGitDelta));
+  delta->path = g_strdup (path);
+  delta->state = state;
+  g_ptr_array_add (deltas, delta);
+}
+
+static SDGitState
+sd_git_status_dir_state (SDGitStatusPrivate *priv, const gchar *dir)
+{
+  if (!g_hash_table_contains (priv->tracked_dirs, dir))
+    return SD_GIT_STATE_UNTRACKED;
+  if (g_hash_table_contains (priv->dirty, dir))
+    return SD_GIT_STATE_MODIFIED;
+  return SD_GIT_STATE_CLEAN;
+}
+
+/* Sets the state of a file and updates the directories containing it.
+   Each directory keeps a count of modified or untracked files below it,
+   so its own state can be updated without rescanning it. */
+
+static void
+sd_git_status_set_file (SDGitStatusPrivate *priv, GPtrArray *deltas,
+			const gchar *path, SDGitState state)
+{
+  SDGitState old =
+    GPOINTER_TO_INT (g_hash_table_lookup (priv->states, path));
+  gboolean was_dirty =
+    old == SD_GIT_STATE_MODIFIED || old == SD_GIT_STATE_UNTRACKED;
+  gboolean is_dirty =
+    state == SD_GIT_STATE_MODIFIED || state == SD_GIT_STATE_UNTRACKED;
+  gchar *dir;
+  gchar *ptr;
+
+  sd_git_status_set (priv->states, deltas, path, state);
+  if (was_dirty == is_dirty)
+    return;
+
+  dir = g_strdup (path);
+  while ((ptr = strrchr (dir, '/')) != NULL)
+    {
+      gint count;
+      *ptr = '\0';
+      count = GPOINTER_TO_INT (g_hash_table_lookup (priv->dirty, dir));
+      count += is_dirty ? 1 : -1;
+      if (count > 0)
+	g_hash_table_insert (priv->dirty, g_strdup (dir),
+			     GINT_TO_POINTER (count));
+      else
+	g_hash_table_remove (priv->dirty, dir);
+      if (GPOINTER_TO_INT (g_hash_table_lookup (priv->dir_states, dir))
+	  != SD_GIT_STATE_IGNORED)
+	sd_git_status_set (priv->dir_states, deltas, dir,
+			   sd_git_status_dir_state (priv, dir));
+    }
+  g_free (dir);
+}
+
+static GPtrArray *
+sd_git_status_find_stale (GHashTable *states, const gchar *prefix,
+			  GHashTable *seen)
+{
+  GHashTableIter iter;
+  GPtrArray *stale = g_ptr_array_new_with_free_func (g_free);
+  gsize len = strlen (prefix);
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, states);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (strncmp (key, prefix, len) == 0
+	  && (len == 0 || ((gchar *) key)[len] == '/')
+	  && (seen == NULL || !g_hash_table_contains (seen, key)))
+	g_ptr_array_add (stale, g_strdup (key));
+    }
+  return stale;
+}
+
+/* Resets every path below PREFIX that was not seen during a scan. Files
+   are reset first, since that can update the state of directories. */
+
+static void
+sd_git_status_clear_stale (SDGitStatusPrivate *priv, GPtrArray *deltas,
+			   const gchar *prefix, GHashTable *seen)
+{
+  GPtrArray *stale;
+  gint i;
+
+  stale = sd_git_status_find_stale (priv->states, prefix, seen);
+  for (i = 0; i < stale->len; i++)
+    sd_git_status_set_file (priv, deltas, g_ptr_array_index (stale, i),
+			    SD_GIT_STATE_CLEAN);
+  g_ptr_array_free (stale, TRUE);
+
+  stale = sd_git_status_find_stale (priv->dir_states, prefix, seen);
+  for (i = 0; i < stale->len; i++)
+    sd_git_status_set (priv->dir_states, deltas,
+		       g_ptr_array_index (stale, i), SD_GIT_STATE_CLEAN);
+  g_ptr_array_free (stale, TRUE);
+}
+
+static void
+sd_git_status_scan (SDGitStatusPrivate *priv, SDGitResult *result,
+		    const gchar *rel, GHashTable *seen)
+{
+  GDir *dir;
+  gchar *path = g_build_filename (priv->root, rel, NULL);
+  const gchar *name;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    {
+      g_free (path);
+      return;
+    }
+  g_ptr_array_add (result->dirs, g_strdup (path));
+
+  /* Rules in the top-level .gitignore are loaded with the matcher */
+  if (*rel != '\0' && !g_hash_table_contains (priv->ignore_dirs, rel))
+    {
+      gchar *ignore = g_build_filename (path, ".gitignore", NULL);
+      gchar *base = g_strconcat (rel, "/", NULL);
+      sd_ignore_add_file (priv->ignore, base, ignore);
+      g_hash_table_add (priv->ignore_dirs, g_strdup (rel));
+      g_free (ignore);
+      g_free (base);
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *child_rel;
+      gchar *child_path;
+      GStatBuf st;
+
+      if (*rel == '\0' && strcmp (name, ".git") == 0)
+	continue;
+      child_rel = *rel == '\0' ? g_strdup (name) :
+	g_strconcat (rel, "/", name, NULL);
+      child_path = g_build_filename (path, name, NULL);
+      if (g_lstat (child_path, &st) == 0)
+	{
+	  if (seen != NULL)
+	    g_hash_table_add (seen, g_strdup (child_rel));
+	  if (S_ISDIR (st.st_mode))
+	    {
+	      if (sd_ignore_match (priv->ignore, child_rel, TRUE))
+		{
+		  sd_git_status_clear_stale (priv, result->deltas, child_rel,
+					     NULL);
+		  sd_git_status_set (priv->dir_states, result->deltas,
+				     child_rel, SD_GIT_STATE_IGNORED);
+		}
+	      else
+		{
+		  sd_git_status_scan (priv, result, child_rel, seen);
+		  sd_git_status_set (priv->dir_states, result->deltas,
+				     child_rel,
+				     sd_git_status_dir_state (priv,
+							      child_rel));
+		}
+	    }
+	  else
+	    sd_git_status_set_file (priv, result->deltas, child_rel,
+				    sd_git_status_check_file (priv, child_rel,
+							      child_path,
+							      &st));
+	}
+      g_free (child_rel);
+      g_free (child_path);
+    }
+  g_dir_close (dir);
+  g_free (path);
+}
+
+/* Counts the bytes of the index entries after the index is read, so the
+   size of the tables can be estimated from their entry counts */
+
+static void
+sd_git_status_set_index_size (SDGitStatusPrivate *priv)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  priv->index_size = 0;
+  g_hash_table_iter_init (&iter, priv->index);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    priv->index_size += strlen (key) + 1 + sizeof (SDGitIndexEntry)
+      + SD_GIT_NODE_SIZE;
+}
+
+/* Returns the estimated bytes of the tables owned by the worker. Paths
+   in the other tables are assumed to be as long as those in the index on
+   average. */
+
+static gsize
+sd_git_status_tables_size (SDGitStatusPrivate *priv)
+{
+  guint entries = g_hash_table_size (priv->index);
+  gsize path = entries > 0 ?
+    (priv->index_size / entries) - sizeof (SDGitIndexEntry)
+    - SD_GIT_NODE_SIZE : 0;
+  gsize paths = g_hash_table_size (priv->tracked_dirs)
+    + g_hash_table_size (priv->states) + g_hash_table_size (priv->dir_states)
+    + g_hash_table_size (priv->dirty) + g_hash_table_size (priv->ignore_dirs);
+
+  return priv->index_size + paths * (path + SD_GIT_NODE_SIZE);
+}
+
+/* Checks the whole work tree against the index that was last read */
+
+static void
+sd_git_status_rescan (SDGitStatusPrivate *priv, SDGitResult *result)
+{
+  GHashTable *seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					    NULL);
+
+  g_hash_table_remove_all (priv->ignore_dirs);
+  if (priv->ignore != NULL)
+    sd_ignore_free (priv->ignore);
+  priv->ignore = sd_ignore_new (priv->root, priv->gitdir, priv->prefix);
+
+  result->full = TRUE;
+  sd_git_status_scan (priv, result, "", seen);
+  sd_git_status_clear_stale (priv, result->deltas, "", seen);
+  g_hash_table_unref (seen);
+}
+
+static void
+sd_git_status_refresh_full (SDGitStatusPrivate *priv, SDGitResult *result)
+{
+  g_hash_table_remove_all (priv->index);
+  g_hash_table_remove_all (priv->tracked_dirs);
+  priv->index_version = 0;
+  sd_git_status_read_index (priv, priv->index, priv->tracked_dirs,
+			    &priv->index_version);
+  sd_git_status_set_index_size (priv);
+  sd_git_status_rescan (priv, result);
+}
+
+static void
+sd_git_status_refresh_path (SDGitStatusPrivate *priv, SDGitResult *result,
+			    const gchar *rel)
+{
+  gchar *path = g_build_filename (priv->root, rel, NULL);
+  GStatBuf st;
+
+  if (g_lstat (path, &st) != 0)
+    {
+      /* The path was deleted */
+      sd_git_status_clear_stale (priv, result->deltas, rel, NULL);
+      sd_git_status_set_file (priv, result->deltas, rel, SD_GIT_STATE_CLEAN);
+      sd_git_status_set (priv->dir_states, result->deltas, rel,
+			 SD_GIT_STATE_CLEAN);
+    }
+  else if (S_ISDIR (st.st_mode))
+    {
+      if (sd_ignore_is_ignored (priv->ignore, rel, TRUE))
+	{
+	  sd_git_status_clear_stale (priv, result->deltas, rel, NULL);
+	  sd_git_status_set (priv->dir_states, result->deltas, rel,
+			     SD_GIT_STATE_IGNORED);
+	}
+      else
+	{
+	  GHashTable *seen = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, NULL);
+	  sd_git_status_scan (priv, result, rel, seen);
+	  sd_git_status_clear_stale (priv, result->deltas, rel, seen);
+	  sd_git_status_set (priv->dir_states, result->deltas, rel,
+			     sd_git_status_dir_state (priv, rel));
+	  g_hash_table_unref (seen);
+	}
+    }
+  else
+    sd_git_status_set_file (priv, result->deltas, rel,
+			    sd_git_status_check_file (priv, rel, path, &st));
+  g_free (path);
+}
+
+static gboolean
+sd_git_index_entry_equal (const SDGitIndexEntry *a, const SDGitIndexEntry *b)
+{
+  return a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec
+    && a->mode == b->mode && a->size == b->size
+    && memcmp (a->sha, b->sha, 20) == 0 && a->conflict == b->conflict
+    && a->skip_worktree == b->skip_worktree;
+}
+
+/* Returns whether REL is below a directory that is ignored, whose
+   contents aren't checked */
+
+static gboolean
+sd_git_status_in_ignored_dir (SDGitStatusPrivate *priv, const gchar *rel)
+{
+  gchar *dir = g_strdup (rel);
+  gchar *ptr;
+  gboolean ignored = FALSE;
+
+  while (!ignored && (ptr = strrchr (dir, '/')) != NULL)
+    {
+      *ptr = '\0';
+      ignored = GPOINTER_TO_INT (g_hash_table_lookup (priv->dir_states, dir))
+	== SD_GIT_STATE_IGNORED;
+    }
+  g_free (dir);
+  return ignored;
+}
+
+static void
+sd_git_status_add_changed (GHashTable *changed, GHashTable *a, GHashTable *b,
+			   gboolean entries)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, a);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      gpointer other;
+      if (!g_hash_table_lookup_extended (b, key, NULL, &other)
+	  || (entries && !sd_git_index_entry_equal (value, other)))
+	g_hash_table_add (changed, key);
+    }
+}
+
+/* Reads the index again after git wrote it, and only checks the paths
+   whose entries changed along with directories that started or stopped
+   being tracked. Returns FALSE if the index changed so much that the
+   work tree was rescanned instead. */
+
+static gboolean
+sd_git_status_refresh_index (SDGitStatusPrivate *priv, SDGitResult *result)
+{
+  GHashTable *index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					     g_free);
+  GHashTable *dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					    NULL);
+  GHashTable *changed = g_hash_table_new (g_str_hash, g_str_equal);
+  GHashTable *old_index = priv->index;
+  GHashTable *old_dirs = priv->tracked_dirs;
+  guint32 version = 0;
+  guint old_count = g_hash_table_size (priv->index);
+  guint new_count;
+  GHashTableIter iter;
+  gpointer key;
+
+  sd_git_status_read_index (priv, index, dirs, &version);
+  new_count = g_hash_table_size (index);
+  if (version != priv->index_version
+      || (new_count > old_count ? new_count - old_count :
+	  old_count - new_count) > old_count / SD_GIT_INDEX_RESCAN_RATIO)
+    {
+      g_hash_table_unref (old_index);
+      g_hash_table_unref (old_dirs);
+      priv->index = index;
+      priv->tracked_dirs = dirs;
+      priv->index_version = version;
+      sd_git_status_set_index_size (priv);
+      g_hash_table_unref (changed);
+      sd_git_status_rescan (priv, result);
+      return FALSE;
+    }
+
+  sd_git_status_add_changed (changed, index, old_index, TRUE);
+  sd_git_status_add_changed (changed, old_index, index, FALSE);
+  sd_git_status_add_changed (changed, dirs, old_dirs, FALSE);
+  sd_git_status_add_changed (changed, old_dirs, dirs, FALSE);
+  priv->index = index;
+  priv->tracked_dirs = dirs;
+  sd_git_status_set_index_size (priv);
+
+  /* Some keys in CHANGED belong to the old tables, which are kept until
+     the paths have been checked against the new ones */
+  g_hash_table_iter_init (&iter, changed);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (!sd_git_status_in_ignored_dir (priv, key))
+	sd_git_status_refresh_path (priv, result, key);
+    }
+  g_hash_table_unref (changed);
+  g_hash_table_unref (old_index);
+  g_hash_table_unref (old_dirs);
+  return TRUE;
+}
+
+static void
+sd_git_status_update_monitors (SDGitStatus *self, GPtrArray *dirs,
+			       gboolean full);
+
+static gboolean
+sd_git_status_deliver (gpointer user_data)
+{
+  SDGitResult *result = user_data;
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (result->status);
+
+  priv->size = result->size;
+  if (priv->func != NULL)
+    {
+      if (result->deltas->len > 0)
+	priv->func (result->deltas, priv->user_data);
+      sd_git_status_update_monitors (result->status, result->dirs,
+				     result->full);
+    }
+  g_ptr_array_free (result->deltas, TRUE);
+  g_ptr_array_free (result->dirs, TRUE);
+  g_object_unref (result->status);
+  g_free (result);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_git_status_thread (gpointer data, gpointer user_data)
+{
+  SDGitRequest *request = data;
+  SDGitStatusPrivate *priv =
+    sd_git_status_get_instance_private (request->status);
+  SDGitResult *result = g_malloc (sizeof (SDGitResult));
+  gint64 start = g_get_monotonic_time ();
+
+  result->status = request->status;
+  result->deltas = g_ptr_array_new_with_free_func (sd_git_delta_free);
+  result->dirs = g_ptr_array_new_with_free_func (g_free);
+  result->full = request->full || priv->ignore == NULL;
+
+  if (result->full)
+    sd_git_status_refresh_full (priv, result);
+  else if (!request->index || sd_git_status_refresh_index (priv, result))
+    {
+      gint i;
+      for (i = 0; i < request->paths->len; i++)
+	sd_git_status_refresh_path (priv, result,
+				    g_ptr_array_index (request->paths, i));
+    }
+  g_debug ("Git status %s refresh took %" G_GINT64_FORMAT " us, %u changes",
+	   result->full ? "full" : "incremental",
+	   g_get_monotonic_time () - start, result->deltas->len);
+  result->size = sd_git_status_tables_size (priv);
+
+  g_ptr_array_free (request->paths, TRUE);
+  g_free (request);
+  g_idle_add (sd_git_status_deliver, result);
+}
+
+static void
+sd_git_status_push (SDGitStatus *self, gboolean full, gboolean index)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  SDGitRequest *request = g_malloc (sizeof (SDGitRequest));
+  GHashTableIter iter;
+  gpointer key;
+
+  request->status = g_object_ref (self);
+  request->paths = g_ptr_array_new_with_free_func (g_free);
+  request->full = full;
+  request->index = index;
+  g_hash_table_iter_init (&iter, priv->pending);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      g_ptr_array_add (request->paths, key);
+      g_hash_table_iter_steal (&iter);
+    }
+  g_thread_pool_push (priv->worker, request, NULL);
+}
+
+static gboolean
+sd_git_status_timeout (gpointer user_data)
+{
+  SDGitStatus *self = SD_GIT_STATUS (user_data);
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  priv->timeout_id = 0;
+  sd_git_status_push (self, priv->pending_full, priv->pending_index);
+  priv->pending_full = FALSE;
+  priv->pending_index = FALSE;
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_git_status_schedule (SDGitStatus *self)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  if (priv->timeout_id == 0)
+    priv->timeout_id = g_timeout_add (SD_GIT_REFRESH_DELAY,
+				      sd_git_status_timeout, self);
+}
+
+static void
+sd_git_status_dir_changed (GFileMonitor *monitor, GFile *file, GFile *other,
+			   GFileMonitorEvent event, gpointer user_data)
+{
+  SDGitStatus *self = SD_GIT_STATUS (user_data);
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  const gchar *name;
+  gchar *rel;
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+      break;
+    default:
+      return;
+    }
+
+  rel = g_file_get_relative_path (priv->root_file, file);
+  if (rel == NULL)
+    return;
+  if (event == G_FILE_MONITOR_EVENT_DELETED)
+    {
+      gchar *path = g_file_get_path (file);
+      g_hash_table_remove (priv->monitors, path);
+      g_free (path);
+    }
+
+  /* Changed ignore rules can affect any path, so rescan everything */
+  name = strrchr (rel, '/');
+  if (strcmp (name == NULL ? rel : name + 1, ".gitignore") == 0)
+    priv->pending_full = TRUE;
+  g_hash_table_add (priv->pending, rel);
+  sd_git_status_schedule (self);
+}
+
+static void
+sd_git_status_index_changed (GFileMonitor *monitor, GFile *file, GFile *other,
+			     GFileMonitorEvent event, gpointer user_data)
+{
+  SDGitStatus *self = SD_GIT_STATUS (user_data);
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  if (event == G_FILE_MONITOR_EVENT_CHANGED)
+    return;
+  priv->pending_index = TRUE;
+  sd_git_status_schedule (self);
+}
+
+static void
+sd_git_status_update_monitors (SDGitStatus *self, GPtrArray *dirs,
+			       gboolean full)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  GHashTable *keep = NULL;
+  gint i;
+
+  if (full)
+    keep = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < dirs->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (dirs, i);
+      if (keep != NULL)
+	g_hash_table_add (keep, (gpointer) path);
+      if (!g_hash_table_contains (priv->monitors, path))
+	{
+	  GFile *file = g_file_new_for_path (path);
+	  GFileMonitor *monitor =
+	    g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+	  g_object_unref (file);
+	  if (monitor == NULL)
+	    continue;
+	  g_signal_connect (monitor, "changed",
+			    G_CALLBACK (sd_git_status_dir_changed), self);
+	  g_hash_table_insert (priv->monitors, g_strdup (path), monitor);
+	}
+    }
+
+  /* After a full scan, stop watching directories that are gone or are
+     now ignored */
+  if (keep != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      g_hash_table_iter_init (&iter, priv->monitors);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+	{
+	  if (!g_hash_table_contains (keep, key))
+	    g_hash_table_iter_remove (&iter);
+	}
+      g_hash_table_unref (keep);
+    }
+}
+
+/* Finds the git directory for the work tree containing PATH. Sets PREFIX
+   to the path of PATH relative to the top of the work tree. Returns NULL
+   if PATH is not in a work tree. */
+
+gchar *
+sd_git_find_gitdir (const gchar *path, gchar **prefix)
+{
+  gchar *dir = g_strdup (path);
+  GString *rel = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      gchar *dotgit = g_build_filename (dir, ".git", NULL);
+      gchar *parent;
+      gchar *basename;
+      gchar *contents;
+
+      if (g_file_test (dotgit, G_FILE_TEST_IS_DIR))
+	goto found;
+      if (g_file_get_contents (dotgit, &contents, NULL, NULL))
+	{
+	  /* Linked work trees and submodules use a file pointing to the
+	     real git directory */
+	  if (g_str_has_prefix (contents, "gitdir: "))
+	    {
+	      gchar *target = g_strstrip (contents + strlen ("gitdir: "));
+	      g_free (dotgit);
+	      if (g_path_is_absolute (target))
+		dotgit = g_strdup (target);
+	      else
+		dotgit = g_build_filename (dir, target, NULL);
+	      g_free (contents);
+	      goto found;
+	    }
+	  g_free (contents);
+	}
+      g_free (dotgit);
+
+      parent = g_path_get_dirname (dir);
+      if (strcmp (parent, dir) == 0)
+	{
+	  g_free (parent);
+	  g_free (dir);
+	  g_string_free (rel, TRUE);
+	  return NULL;
+	}
+      basename = g_path_get_basename (dir);
+      g_string_prepend_c (rel, '/');
+      g_string_prepend (rel, basename);
+      g_free (basename);
+      g_free (dir);
+      dir = parent;
+      continue;
+
+    found:
+      g_free (dir);
+      *prefix = g_string_free (rel, FALSE);
+      return dotgit;
+    }
+}
+
+SDGitStatus *
+sd_git_status_new (GFile *root, SDGitStatusFunc func, gpointer user_data)
+{
+  SDGitStatus *status;
+  SDGitStatusPrivate *priv;
+  gchar *path = g_file_get_path (root);
+  gchar *gitdir;
+  gchar *prefix;
+  gchar *index;
+  GFile *file;
+
+  if (path == NULL)
+    return NULL;
+  gitdir = sd_git_find_gitdir (path, &prefix);
+  if (gitdir == NULL)
+    {
+      g_debug ("%s is not in a git work tree", path);
+      g_free (path);
+      return NULL;
+    }
+
+  status = g_object_new (SD_TYPE_GIT_STATUS, NULL);
+  priv = sd_git_status_get_instance_private (status);
+  priv->func = func;
+  priv->user_data = user_data;
+  priv->root = path;
+  priv->gitdir = gitdir;
+  priv->prefix = prefix;
+  priv->root_file = g_object_ref (root);
+
+  index = g_build_filename (gitdir, "index", NULL);
+  file = g_file_new_for_path (index);
+  priv->index_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL,
+					     NULL);
+  if (priv->index_monitor != NULL)
+    g_signal_connect (priv->index_monitor, "changed",
+		      G_CALLBACK (sd_git_status_index_changed), status);
+  g_object_unref (file);
+  g_free (index);
+
+  sd_git_status_push (status, TRUE, FALSE);
+  return status;
+}
+
+void
+sd_git_status_refresh (SDGitStatus *self)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  priv->pending_full = TRUE;
+  sd_git_status_schedule (self);
+}
+
+/* Returns the estimated bytes used by the parsed index, the state and
+   count of each path and the directory monitors. The tables owned by the
+   worker are measured after each refresh. */
+
+gsize
+sd_git_status_get_size (SDGitStatus *self)
+{
+  SDGitStatusPrivate *priv = sd_git_status_get_instance_private (self);
+  return sizeof (SDGitStatusPrivate) + priv->size
+    + g_hash_table_size (priv->monitors)
+    * (SD_GIT_MONITOR_SIZE + SD_GIT_NODE_SIZE);
+}
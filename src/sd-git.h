@@ -0,0 +1,61 @@
+/* sd-git.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_GIT_H
+#define _SD_GIT_H
+
+#include <gio/gio.h>
+
+typedef enum
+{
+  SD_GIT_STATE_CLEAN = 0,
+  SD_GIT_STATE_MODIFIED,
+  SD_GIT_STATE_UNTRACKED,
+  SD_GIT_STATE_IGNORED
+} SDGitState;
+
+/* A change in the status of a path, relative to the project directory */
+
+struct _SDGitDelta
+{
+  gchar *path;
+  SDGitState state;
+};
+
+typedef struct _SDGitDelta SDGitDelta;
+
+typedef void (*SDGitStatusFunc) (GPtrArray *deltas, gpointer user_data);
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_GIT_STATUS sd_git_status_get_type ()
+G_DECLARE_FINAL_TYPE (SDGitStatus, sd_git_status, SD, GIT_STATUS, GObject)
+
+struct _SDGitStatus
+{
+  GObject parent;
+};
+
+SDGitStatus *sd_git_status_new (GFile *root, SDGitStatusFunc func,
+				gpointer user_data);
+void sd_git_status_refresh (SDGitStatus *self);
+gsize sd_git_status_get_size (SDGitStatus *self);
+
+gchar *sd_git_find_gitdir (const gchar *path, gchar **prefix);
+
+G_END_DECLS
+
+#endif
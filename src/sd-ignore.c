@@ -0,0 +1,314 @@
+/* sd-ignore.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <fnmatch.h>
+#include <string.h>
+#include "sd-ignore.h"
+
+struct _SDIgnoreRule
+{
+  gchar *base;
+  gchar *pattern;
+  gboolean negate;
+  gboolean dir_only;
+  gboolean anchored;
+  gboolean any_depth;
+  gint flags;
+};
+
+typedef struct _SDIgnoreRule SDIgnoreRule;
+
+/* Rules are stored relative to the top of the work tree, which is above
+   the root when a subdirectory of a repository is opened. PREFIX is the
+   path of the root relative to the top, and is either empty or ends with
+   `/'. */
+
+struct _SDIgnore
+{
+  GPtrArray *rules;
+  gchar *prefix;
+};
+
+static void
+sd_ignore_rule_free (gpointer data)
+{
+  SDIgnoreRule *rule = data;
+  g_free (rule->base);
+  g_free (rule->pattern);
+  g_free (rule);
+}
+
+static void
+sd_ignore_add_rule (SDIgnore *self, const gchar *dir, gchar *line)
+{
+  SDIgnoreRule *rule;
+  gchar *pattern = line;
+  gsize len;
+
+  g_strchomp (pattern);
+  if (*pattern == '\0' || *pattern == '#')
+    return;
+
+  rule = g_malloc (sizeof (SDIgnoreRule));
+  rule->negate = FALSE;
+  rule->dir_only = FALSE;
+  rule->anchored = FALSE;
+  rule->any_depth = FALSE;
+  rule->flags = FNM_PATHNAME;
+
+  if (*pattern == '!')
+    {
+      rule->negate = TRUE;
+      pattern++;
+    }
+  else if (*pattern == '\\')
+    pattern++;
+
+  len = strlen (pattern);
+  if (len > 3 && g_str_has_suffix (pattern, "/**"))
+    {
+      /* Everything inside a directory, which is treated like ignoring the
+	 directory itself */
+      len -= 3;
+      pattern[len] = '\0';
+      rule->dir_only = TRUE;
+    }
+  if (len > 1 && pattern[len - 1] == '/')
+    {
+      pattern[--len] = '\0';
+      rule->dir_only = TRUE;
+    }
+  if (g_str_has_prefix (pattern, "**/"))
+    {
+      pattern += 3;
+      rule->any_depth = TRUE;
+    }
+  if (*pattern == '/')
+    {
+      pattern++;
+      rule->anchored = TRUE;
+    }
+  else if (strchr (pattern, '/') != NULL)
+    rule->anchored = TRUE;
+  if (strstr (pattern, "**") != NULL)
+    rule->flags = 0;
+
+  if (*pattern == '\0')
+    {
+      g_free (rule);
+      return;
+    }
+  rule->base = g_strdup (dir);
+  rule->pattern = g_strdup (pattern);
+  g_ptr_array_add (self->rules, rule);
+}
+
+static gboolean
+sd_ignore_rule_match (SDIgnoreRule *rule, const gchar *path, gboolean is_dir)
+{
+  const gchar *rel;
+
+  if (rule->dir_only && !is_dir)
+    return FALSE;
+  if (!g_str_has_prefix (path, rule->base))
+    return FALSE;
+  rel = path + strlen (rule->base);
+
+  if (!rule->anchored)
+    {
+      const gchar *name = strrchr (rel, '/');
+      return fnmatch (rule->pattern, name == NULL ? rel : name + 1, 0) == 0;
+    }
+  if (fnmatch (rule->pattern, rel, rule->flags) == 0)
+    return TRUE;
+  if (rule->any_depth)
+    {
+      const gchar *ptr;
+      for (ptr = strchr (rel, '/'); ptr != NULL; ptr = strchr (ptr + 1, '/'))
+	{
+	  if (fnmatch (rule->pattern, ptr + 1, rule->flags) == 0)
+	    return TRUE;
+	}
+    }
+  return FALSE;
+}
+
+/* Adds the rules in the ignore file PATH, which apply to paths under DIR.
+   DIR is relative to the top of the work tree. */
+
+static void
+sd_ignore_add_rules (SDIgnore *self, const gchar *dir, const gchar *path)
+{
+  gchar *contents;
+  gchar **lines;
+  gint i;
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return;
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  for (i = 0; lines[i] != NULL; i++)
+    sd_ignore_add_rule (self, dir, lines[i]);
+  g_strfreev (lines);
+}
+
+/* Adds the rules of the .gitignore files in TOP and in each directory
+   between it and the root, outermost first so deeper files take
+   precedence */
+
+static void
+sd_ignore_add_parents (SDIgnore *self, const gchar *top)
+{
+  GString *dir = g_string_new (NULL);
+  gchar **parts = g_strsplit (self->prefix, "/", -1);
+  gint i;
+
+  for (i = 0; parts[i] != NULL && *parts[i] != '\0'; i++)
+    {
+      gchar *path = g_build_filename (top, dir->str, ".gitignore", NULL);
+      sd_ignore_add_rules (self, dir->str, path);
+      g_free (path);
+      g_string_append (dir, parts[i]);
+      g_string_append_c (dir, '/');
+    }
+  g_strfreev (parts);
+  g_string_free (dir, TRUE);
+}
+
+/* Creates a matcher with the rules that apply to the project at ROOT.
+   GITDIR is the git directory of the work tree containing ROOT, or NULL
+   if it is not in one, and PREFIX is the path of ROOT relative to the top
+   of the work tree. */
+
+SDIgnore *
+sd_ignore_new (const gchar *root, const gchar *gitdir, const gchar *prefix)
+{
+  SDIgnore *self = g_malloc (sizeof (SDIgnore));
+  gchar *commondir;
+  gchar *top;
+  gchar *path;
+  gint i;
+
+  self->rules = g_ptr_array_new_with_free_func (sd_ignore_rule_free);
+  self->prefix = g_strdup (gitdir == NULL ? "" : prefix);
+  if (gitdir != NULL)
+    {
+      /* Linked work trees share info/exclude with the main repository */
+      path = g_build_filename (gitdir, "commondir", NULL);
+      if (g_file_get_contents (path, &commondir, NULL, NULL))
+	{
+	  g_strstrip (commondir);
+	  if (!g_path_is_absolute (commondir))
+	    {
+	      gchar *full = g_build_filename (gitdir, commondir, NULL);
+	      g_free (commondir);
+	      commondir = full;
+	    }
+	}
+      else
+	commondir = g_strdup (gitdir);
+      g_free (path);
+      path = g_build_filename (commondir, "info", "exclude", NULL);
+      sd_ignore_add_rules (self, "", path);
+      g_free (path);
+      g_free (commondir);
+
+      top = g_strdup (root);
+      for (i = 0; self->prefix[i] != '\0'; i++)
+	{
+	  if (self->prefix[i] == '/')
+	    {
+	      gchar *parent = g_path_get_dirname (top);
+	      g_free (top);
+	      top = parent;
+	    }
+	}
+      sd_ignore_add_parents (self, top);
+      g_free (top);
+    }
+  path = g_build_filename (root, ".gitignore", NULL);
+  sd_ignore_add_file (self, "", path);
+  g_free (path);
+  return self;
+}
+
+void
+sd_ignore_free (SDIgnore *self)
+{
+  g_ptr_array_free (self->rules, TRUE);
+  g_free (self->prefix);
+  g_free (self);
+}
+
+/* Adds the rules in the ignore file PATH, which apply to paths under DIR.
+   DIR is relative to the root and is either empty or ends with `/'. */
+
+void
+sd_ignore_add_file (SDIgnore *self, const gchar *dir, const gchar *path)
+{
+  gchar *base = g_strconcat (self->prefix, dir, NULL);
+  sd_ignore_add_rules (self, base, path);
+  g_free (base);
+}
+
+/* Returns whether PATH itself matches the rules. Later rules take
+   precedence over earlier ones, as in git. */
+
+gboolean
+sd_ignore_match (SDIgnore *self, const gchar *path, gboolean is_dir)
+{
+  gchar *full = NULL;
+  gboolean ret = FALSE;
+  gint i;
+
+  if (*self->prefix != '\0')
+    path = full = g_strconcat (self->prefix, path, NULL);
+  for (i = self->rules->len - 1; i >= 0; i--)
+    {
+      SDIgnoreRule *rule = g_ptr_array_index (self->rules, i);
+      if (sd_ignore_rule_match (rule, path, is_dir))
+	{
+	  ret = !rule->negate;
+	  break;
+	}
+    }
+  g_free (full);
+  return ret;
+}
+
+/* Like sd_ignore_match, but also returns TRUE if any directory containing
+   PATH is ignored */
+
+gboolean
+sd_ignore_is_ignored (SDIgnore *self, const gchar *path, gboolean is_dir)
+{
+  gchar *copy = g_strdup (path);
+  gchar *ptr;
+  gboolean ret = FALSE;
+
+  for (ptr = strchr (copy, '/'); ptr != NULL; ptr = strchr (ptr + 1, '/'))
+    {
+      *ptr = '\0';
+      ret = sd_ignore_match (self, copy, TRUE);
+      *ptr = '/';
+      if (ret)
+	break;
+    }
+  if (!ret)
+    ret = sd_ignore_match (self, path, is_dir);
+  g_free (copy);
+  return ret;
+}
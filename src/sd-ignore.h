@@ -0,0 +1,40 @@
+/* sd-ignore.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_IGNORE_H
+#define _SD_IGNORE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Matches paths against gitignore-style rules. Paths are relative to the
+   directory the matcher was created for and use `/' as the separator. An
+   SDIgnore is not thread-safe and should be used from one thread. */
+
+typedef struct _SDIgnore SDIgnore;
+
+SDIgnore *sd_ignore_new (const gchar *root, const gchar *gitdir,
+			 const gchar *prefix);
+void sd_ignore_free (SDIgnore *self);
+void sd_ignore_add_file (SDIgnore *self, const gchar *dir, const gchar *path);
+gboolean sd_ignore_match (SDIgnore *self, const gchar *path, gboolean is_dir);
+gboolean sd_ignore_is_ignored (SDIgnore *self, const gchar *path,
+			       gboolean is_dir);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,114 @@
+/* sd-index.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include "sd-index.h"
+#include "sd-io.h"
+#include "sd-scan.h"
+
+/* The index of a project is the list of its files, as found by
+   sd_scan_files. It is kept in the user cache directory in a file named
+   after a hash of the project's path, with a header line followed by one
+   relative path per line. */
+
+#define SD_INDEX_HEADER "simpledevelop-index 1\n"
+
+static gchar *
+sd_index_get_path (const gchar *root)
+{
+  gchar *hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, root, -1);
+  gchar *path = g_build_filename (g_get_user_cache_dir (), "simpledevelop",
+				  "index", hash, NULL);
+  g_free (hash);
+  return path;
+}
+
+/* Returns the files listed in the saved index of the project at ROOT, or
+   NULL if it has not been indexed */
+
+GPtrArray *
+sd_index_load (const gchar *root)
+{
+  gchar *path = sd_index_get_path (root);
+  GPtrArray *files;
+  gchar *contents;
+  gchar *line;
+  gchar *end;
+  gsize len;
+
+  if (!g_file_get_contents (path, &contents, &len, NULL))
+    {
+      g_free (path);
+      return NULL;
+    }
+  g_free (path);
+  if (!g_str_has_prefix (contents, SD_INDEX_HEADER))
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  for (line = contents + strlen (SD_INDEX_HEADER); *line != '\0'; line = end)
+    {
+      end = strchr (line, '\n');
+      if (end == NULL)
+	end = line + strlen (line);
+      if (end > line)
+	g_ptr_array_add (files, g_strndup (line, end - line));
+      if (*end == '\n')
+	end++;
+    }
+  g_free (contents);
+  return files;
+}
+
+gboolean
+sd_index_save (const gchar *root, GPtrArray *files, GError **err)
+{
+  GString *contents = g_string_new (SD_INDEX_HEADER);
+  gchar *path = sd_index_get_path (root);
+  gchar *dir = g_path_get_dirname (path);
+  gboolean ret;
+  guint i;
+
+  for (i = 0; i < files->len; i++)
+    {
+      const gchar *file = g_ptr_array_index (files, i);
+      if (strchr (file, '\n') == NULL)
+	{
+	  g_string_append (contents, file);
+	  g_string_append_c (contents, '\n');
+	}
+    }
+  g_mkdir_with_parents (dir, 0755);
+  ret = sd_io_replace_contents (path, contents->str, contents->len, err);
+  g_string_free (contents, TRUE);
+  g_free (dir);
+  g_free (path);
+  return ret;
+}
+
+/* Returns the files in the project at ROOT from its index, or by scanning
+   the project if it has not been indexed */
+
+GPtrArray *
+sd_index_get_files (const gchar *root)
+{
+  GPtrArray *files = sd_index_load (root);
+  return files == NULL ? sd_scan_files (root, NULL) : files;
+}
@@ -0,0 +1,207 @@
+/* sd-io.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sd-io.h"
+
+/* Files are written to a temporary file in the same directory as the
+   target and renamed over it once complete, so readers never observe a
+   partially written file. Symlinks are followed so the file they point
+   to is replaced. If the temporary file can't be given the owner of the
+   file being replaced, the file is instead overwritten in place. */
+
+struct _SDAtomicFile
+{
+  gchar *path;
+  gchar *tmp_path;
+  gint fd;
+};
+
+static void
+sd_atomic_file_set_error (GError **err, gint saved_errno, const gchar *action,
+			  const gchar *path)
+{
+  g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+	       "Failed to %s %s: %s", action, path, g_strerror (saved_errno));
+}
+
+static void
+sd_atomic_file_free (SDAtomicFile *file)
+{
+  g_free (file->path);
+  g_free (file->tmp_path);
+  g_free (file);
+}
+
+/* Writes straight to the target, for files whose metadata can't be kept
+   by replacing them */
+
+static gboolean
+sd_atomic_file_open_direct (SDAtomicFile *file, GError **err)
+{
+  g_clear_pointer (&file->tmp_path, g_free);
+  file->fd = g_open (file->path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (file->fd == -1)
+    {
+      sd_atomic_file_set_error (err, errno, "open", file->path);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+SDAtomicFile *
+sd_atomic_file_open (const gchar *path, GError **err)
+{
+  SDAtomicFile *file;
+  GStatBuf st;
+  gchar *target;
+  gchar *dirname;
+  gchar *basename;
+  gboolean exists;
+
+  file = g_malloc (sizeof (SDAtomicFile));
+  target = realpath (path, NULL);
+  if (target != NULL)
+    {
+      file->path = g_strdup (target);
+      free (target);
+    }
+  else
+    file->path = g_strdup (path);
+
+  /* A symlink that could not be resolved is dangling, and writing through
+     it creates the file it points to */
+  if (g_lstat (file->path, &st) == 0 && S_ISLNK (st.st_mode))
+    {
+      file->tmp_path = NULL;
+      if (sd_atomic_file_open_direct (file, err))
+	return file;
+      sd_atomic_file_free (file);
+      return NULL;
+    }
+  exists = g_stat (file->path, &st) == 0;
+
+  dirname = g_path_get_dirname (file->path);
+  basename = g_path_get_basename (file->path);
+  file->tmp_path = g_strdup_printf ("%s/.%s.XXXXXX", dirname, basename);
+  g_free (dirname);
+  g_free (basename);
+
+  file->fd = g_mkstemp_full (file->tmp_path, O_WRONLY,
+			     exists ? st.st_mode & 07777 : 0666);
+  if (file->fd == -1)
+    {
+      sd_atomic_file_set_error (err, errno, "create temporary file for",
+				path);
+      sd_atomic_file_free (file);
+      return NULL;
+    }
+  if (!exists)
+    return file;
+
+  /* Keep the owner and permissions of the file being replaced */
+  if ((st.st_uid != getuid () || st.st_gid != getgid ())
+      && fchown (file->fd, st.st_uid, st.st_gid) == -1)
+    {
+      close (file->fd);
+      g_unlink (file->tmp_path);
+      if (sd_atomic_file_open_direct (file, err))
+	return file;
+      sd_atomic_file_free (file);
+      return NULL;
+    }
+  if (fchmod (file->fd, st.st_mode & 07777) == -1)
+    g_debug ("Failed to preserve permissions of %s", path);
+  return file;
+}
+
+gboolean
+sd_atomic_file_write (SDAtomicFile *file, const gchar *data, gsize len,
+		      GError **err)
+{
+  while (len > 0)
+    {
+      gssize ret = write (file->fd, data, len);
+      if (ret == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  sd_atomic_file_set_error (err, errno, "write to", file->path);
+	  return FALSE;
+	}
+      data += ret;
+      len -= ret;
+    }
+  return TRUE;
+}
+
+gboolean
+sd_atomic_file_commit (SDAtomicFile *file, GError **err)
+{
+  if (fsync (file->fd) == -1 && errno != EINVAL)
+    {
+      sd_atomic_file_set_error (err, errno, "flush", file->path);
+      sd_atomic_file_abort (file);
+      return FALSE;
+    }
+  if (close (file->fd) == -1)
+    {
+      file->fd = -1;
+      sd_atomic_file_set_error (err, errno, "close", file->path);
+      sd_atomic_file_abort (file);
+      return FALSE;
+    }
+  file->fd = -1;
+  if (file->tmp_path != NULL && g_rename (file->tmp_path, file->path) == -1)
+    {
+      sd_atomic_file_set_error (err, errno, "rename temporary file over",
+				file->path);
+      sd_atomic_file_abort (file);
+      return FALSE;
+    }
+  sd_atomic_file_free (file);
+  return TRUE;
+}
+
+void
+sd_atomic_file_abort (SDAtomicFile *file)
+{
+  if (file->fd != -1)
+    close (file->fd);
+  if (file->tmp_path != NULL)
+    g_unlink (file->tmp_path);
+  sd_atomic_file_free (file);
+}
+
+gboolean
+sd_io_replace_contents (const gchar *path, const gchar *contents, gsize len,
+			GError **err)
+{
+  SDAtomicFile *file = sd_atomic_file_open (path, err);
+  if (file == NULL)
+    return FALSE;
+  if (!sd_atomic_file_write (file, contents, len, err))
+    {
+      sd_atomic_file_abort (file);
+      return FALSE;
+    }
+  return sd_atomic_file_commit (file, err);
+}
@@ -0,0 +1,37 @@
+/* sd-io.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_IO_H
+#define _SD_IO_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _SDAtomicFile SDAtomicFile;
+
+SDAtomicFile *sd_atomic_file_open (const gchar *path, GError **err);
+gboolean sd_atomic_file_write (SDAtomicFile *file, const gchar *data, gsize len,
+			       GError **err);
+gboolean sd_atomic_file_commit (SDAtomicFile *file, GError **err);
+void sd_atomic_file_abort (SDAtomicFile *file);
+
+gboolean sd_io_replace_contents (const gchar *path, const gchar *contents,
+				 gsize len, GError **err);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,285 @@
+/* sd-memory-dialog.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-memory-dialog.h"
+
+/* Seconds between refreshes of the estimates while the dialog is open */
+#define SD_MEMORY_DIALOG_REFRESH_INTERVAL 2
+
+enum
+{
+  USAGE_NAME_COLUMN = 0,
+  USAGE_SIZE_COLUMN,
+  USAGE_N_COLUMNS
+};
+
+struct _SDMemoryDialogPrivate
+{
+  SDWindow *window;
+  GtkWidget *usage_view;
+  GtkWidget *total_label;
+  GtkWidget *save_button;
+  GtkTreeStore *store;
+  guint refresh_id;
+};
+
+typedef struct _SDMemoryDialogPrivate SDMemoryDialogPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDMemoryDialog, sd_memory_dialog,
+			    GTK_TYPE_DIALOG)
+
+/* Sets the Nth child of PARENT to NAME with a size of BYTES. A row
+   already showing NAME is updated in place, so it keeps its expansion and
+   selection, and rows before it whose groups or items are gone are
+   removed. Returns whether a new row was inserted. */
+
+static gboolean
+sd_memory_dialog_set_row (SDMemoryDialogPrivate *priv, GtkTreeIter *parent,
+			  gint n, const gchar *name, gsize bytes,
+			  GtkTreeIter *iter)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (priv->store);
+  gchar *size = g_format_size (bytes);
+  gboolean found = FALSE;
+  gint skip = 0;
+
+  if (gtk_tree_model_iter_nth_child (model, iter, parent, n))
+    do
+      {
+	gchar *row_name;
+	gtk_tree_model_get (model, iter, USAGE_NAME_COLUMN, &row_name, -1);
+	found = g_strcmp0 (row_name, name) == 0;
+	g_free (row_name);
+	if (!found)
+	  skip++;
+      }
+    while (!found && gtk_tree_model_iter_next (model, iter));
+
+  if (found)
+    {
+      GtkTreeIter gone;
+      while (skip-- > 0)
+	{
+	  gtk_tree_model_iter_nth_child (model, &gone, parent, n);
+	  gtk_tree_store_remove (priv->store, &gone);
+	}
+      gtk_tree_store_set (priv->store, iter, USAGE_SIZE_COLUMN, size, -1);
+    }
+  else
+    gtk_tree_store_insert_with_values (priv->store, iter, parent, n,
+				       USAGE_NAME_COLUMN, name,
+				       USAGE_SIZE_COLUMN, size, -1);
+  g_free (size);
+  return !found;
+}
+
+/* Removes the children of PARENT from the Nth on */
+
+static void
+sd_memory_dialog_trim_rows (SDMemoryDialogPrivate *priv, GtkTreeIter *parent,
+			    gint n)
+{
+  GtkTreeIter iter;
+  while (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (priv->store), &iter,
+					parent, n))
+    gtk_tree_store_remove (priv->store, &iter);
+}
+
+static gboolean
+sd_memory_dialog_refresh (gpointer user_data)
+{
+  SDMemoryDialog *self = SD_MEMORY_DIALOG (user_data);
+  SDMemoryDialogPrivate *priv = sd_memory_dialog_get_instance_private (self);
+  SDMemoryReport *report;
+  gchar *size;
+  gchar *text;
+  guint i;
+  guint j;
+
+  if (priv->window == NULL)
+    return G_SOURCE_CONTINUE;
+  report = sd_memory_report_new ();
+  sd_window_get_memory (priv->window, report);
+
+  /* Groups are expanded when they first appear, and are otherwise left as
+     the user collapsed or expanded them */
+  for (i = 0; i < report->groups->len; i++)
+    {
+      SDMemoryGroup *group = g_ptr_array_index (report->groups, i);
+      GtkTreeIter parent;
+      GtkTreeIter iter;
+      gboolean added = sd_memory_dialog_set_row (priv, NULL, i, group->name,
+						 group->bytes, &parent);
+
+      for (j = 0; j < group->items->len; j++)
+	{
+	  SDMemoryItem *item = &g_array_index (group->items, SDMemoryItem, j);
+	  sd_memory_dialog_set_row (priv, &parent, j, item->name, item->bytes,
+				    &iter);
+	}
+      sd_memory_dialog_trim_rows (priv, &parent, j);
+      if (added)
+	{
+	  GtkTreePath *path =
+	    gtk_tree_model_get_path (GTK_TREE_MODEL (priv->store), &parent);
+	  gtk_tree_view_expand_row (GTK_TREE_VIEW (priv->usage_view), path,
+				    FALSE);
+	  gtk_tree_path_free (path);
+	}
+    }
+  sd_memory_dialog_trim_rows (priv, NULL, i);
+
+  size = g_format_size (report->total);
+  text = g_strdup_printf ("Estimated total: %s", size);
+  gtk_label_set_text (GTK_LABEL (priv->total_label), text);
+  g_free (text);
+  g_free (size);
+  sd_memory_report_free (report);
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+sd_memory_dialog_save (GtkButton *button, gpointer user_data)
+{
+  SDMemoryDialog *self = SD_MEMORY_DIALOG (user_data);
+  SDMemoryDialogPrivate *priv = sd_memory_dialog_get_instance_private (self);
+  GtkFileChooserNative *chooser;
+  SDMemoryReport *report;
+  GError *err = NULL;
+  gchar *filename;
+  gchar *json;
+
+  if (priv->window == NULL)
+    return;
+  chooser =
+    gtk_file_chooser_native_new ("Save Memory Usage", GTK_WINDOW (self),
+				 GTK_FILE_CHOOSER_ACTION_SAVE, "_Save",
+				 "_Cancel");
+  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (chooser),
+						  TRUE);
+  gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (chooser),
+				     "simpledevelop-memory.json");
+  if (gtk_native_dialog_run (GTK_NATIVE_DIALOG (chooser)) !=
+      GTK_RESPONSE_ACCEPT)
+    {
+      g_object_unref (chooser);
+      return;
+    }
+  filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (chooser));
+  g_object_unref (chooser);
+
+  report = sd_memory_report_new ();
+  sd_window_get_memory (priv->window, report);
+  json = sd_memory_report_to_json (report);
+  if (!g_file_set_contents (filename, json, -1, &err))
+    {
+      GtkWidget *dialog =
+	gtk_message_dialog_new (GTK_WINDOW (self),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+				"Failed to save memory usage");
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog),
+						"%s", err->message);
+      g_signal_connect_swapped (dialog, "response",
+				G_CALLBACK (gtk_widget_destroy), dialog);
+      gtk_widget_show (dialog);
+      g_error_free (err);
+    }
+  sd_memory_report_free (report);
+  g_free (json);
+  g_free (filename);
+}
+
+static void
+sd_memory_dialog_dispose (GObject *obj)
+{
+  SDMemoryDialogPrivate *priv =
+    sd_memory_dialog_get_instance_private (SD_MEMORY_DIALOG (obj));
+  if (priv->refresh_id != 0)
+    {
+      g_source_remove (priv->refresh_id);
+      priv->refresh_id = 0;
+    }
+  if (priv->window != NULL)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (priv->window),
+				    (gpointer *) &priv->window);
+      priv->window = NULL;
+    }
+  g_clear_object (&priv->store);
+  G_OBJECT_CLASS (sd_memory_dialog_parent_class)->dispose (obj);
+}
+
+static void
+sd_memory_dialog_init (SDMemoryDialog *self)
+{
+  SDMemoryDialogPrivate *priv = sd_memory_dialog_get_instance_private (self);
+  GtkTreeViewColumn *col;
+  GtkCellRenderer *renderer;
+
+  gtk_widget_init_template (GTK_WIDGET (self));
+  priv->store = gtk_tree_store_new (USAGE_N_COLUMNS, G_TYPE_STRING,
+				    G_TYPE_STRING);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->usage_view),
+			   GTK_TREE_MODEL (priv->store));
+  col = gtk_tree_view_column_new_with_attributes ("Used by",
+						  gtk_cell_renderer_text_new (),
+						  "text", USAGE_NAME_COLUMN,
+						  NULL);
+  gtk_tree_view_column_set_expand (col, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->usage_view), col);
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (renderer, "xalign", 1.0, NULL);
+  col = gtk_tree_view_column_new_with_attributes ("Size", renderer, "text",
+						  USAGE_SIZE_COLUMN, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->usage_view), col);
+
+  g_signal_connect (priv->save_button, "clicked",
+		    G_CALLBACK (sd_memory_dialog_save), self);
+}
+
+static void
+sd_memory_dialog_class_init (SDMemoryDialogClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_memory_dialog_dispose;
+  gtk_widget_class_set_template_from_resource (GTK_WIDGET_CLASS (klass),
+					       SD_RESOURCE_MEMORY_DIALOG_UI);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDMemoryDialog, usage_view);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDMemoryDialog, total_label);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDMemoryDialog, save_button);
+}
+
+/* Shows the estimated memory use of WINDOW, refreshed every few seconds
+   while the dialog is open */
+
+SDMemoryDialog *
+sd_memory_dialog_new (SDWindow *window)
+{
+  SDMemoryDialog *self =
+    g_object_new (SD_TYPE_MEMORY_DIALOG, "transient-for", window,
+		  "use-header-bar", TRUE, NULL);
+  SDMemoryDialogPrivate *priv = sd_memory_dialog_get_instance_private (self);
+  priv->window = window;
+  g_object_add_weak_pointer (G_OBJECT (window), (gpointer *) &priv->window);
+  sd_memory_dialog_refresh (self);
+  priv->refresh_id =
+    g_timeout_add_seconds (SD_MEMORY_DIALOG_REFRESH_INTERVAL,
+			   sd_memory_dialog_refresh, self);
+  return self;
+}
@@ -0,0 +1,37 @@
+/* sd-memory-dialog.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_MEMORY_DIALOG_H
+#define _SD_MEMORY_DIALOG_H
+
+#include "sd-window.h"
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_MEMORY_DIALOG sd_memory_dialog_get_type ()
+G_DECLARE_FINAL_TYPE (SDMemoryDialog, sd_memory_dialog, SD, MEMORY_DIALOG,
+		      GtkDialog)
+
+struct _SDMemoryDialog
+{
+  GtkDialog parent;
+};
+
+SDMemoryDialog *sd_memory_dialog_new (SDWindow *window);
+
+G_END_DECLS
+
+#endif
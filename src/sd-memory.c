@@ -0,0 +1,153 @@
+/* sd-memory.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-memory.h"
+
+/* Estimated bytes used by a text buffer for each line and each tag, apart
+   from the text itself */
+#define SD_MEMORY_LINE_SIZE 64
+#define SD_MEMORY_TAG_SIZE 256
+
+static void
+sd_memory_item_clear (gpointer data)
+{
+  SDMemoryItem *item = data;
+  g_free (item->name);
+}
+
+static void
+sd_memory_group_free (gpointer data)
+{
+  SDMemoryGroup *group = data;
+  g_free (group->name);
+  g_array_unref (group->items);
+  g_free (group);
+}
+
+SDMemoryReport *
+sd_memory_report_new (void)
+{
+  SDMemoryReport *report = g_malloc (sizeof (SDMemoryReport));
+  report->groups = g_ptr_array_new_with_free_func (sd_memory_group_free);
+  report->total = 0;
+  return report;
+}
+
+void
+sd_memory_report_free (SDMemoryReport *report)
+{
+  g_ptr_array_unref (report->groups);
+  g_free (report);
+}
+
+/* Starts a new group, which the following items are added to */
+
+void
+sd_memory_report_begin (SDMemoryReport *report, const gchar *group)
+{
+  SDMemoryGroup *new_group = g_malloc (sizeof (SDMemoryGroup));
+  new_group->name = g_strdup (group);
+  new_group->bytes = 0;
+  new_group->items = g_array_new (FALSE, FALSE, sizeof (SDMemoryItem));
+  g_array_set_clear_func (new_group->items, sd_memory_item_clear);
+  g_ptr_array_add (report->groups, new_group);
+}
+
+void
+sd_memory_report_add (SDMemoryReport *report, const gchar *name, gsize bytes)
+{
+  SDMemoryGroup *group;
+  SDMemoryItem item;
+
+  g_return_if_fail (report->groups->len > 0);
+  group = g_ptr_array_index (report->groups, report->groups->len - 1);
+  item.name = g_strdup (name);
+  item.bytes = bytes;
+  g_array_append_val (group->items, item);
+  group->bytes += bytes;
+  report->total += bytes;
+}
+
+/* Adds the text and tags of BUFFER. The number of tags is shown, since
+   tags that are created and never removed add up over time. */
+
+void
+sd_memory_report_add_buffer (SDMemoryReport *report, GtkTextBuffer *buffer)
+{
+  gint tags = gtk_text_tag_table_get_size (gtk_text_buffer_get_tag_table
+					   (buffer));
+  gchar *name = g_strdup_printf ("Tags (%d)", tags);
+
+  sd_memory_report_add (report, "Text",
+			gtk_text_buffer_get_char_count (buffer)
+			+ (gsize) gtk_text_buffer_get_line_count (buffer)
+			* SD_MEMORY_LINE_SIZE);
+  sd_memory_report_add (report, name, (gsize) tags * SD_MEMORY_TAG_SIZE);
+  g_free (name);
+}
+
+static void
+sd_memory_json_string (GString *json, const gchar *str)
+{
+  const gchar *ptr;
+
+  g_string_append_c (json, '"');
+  for (ptr = str; *ptr != '\0'; ptr++)
+    {
+      if (*ptr == '"' || *ptr == '\\')
+	g_string_append_printf (json, "\\%c", *ptr);
+      else if ((guchar) *ptr < 0x20)
+	g_string_append_printf (json, "\\u%04x", *ptr);
+      else
+	g_string_append_c (json, *ptr);
+    }
+  g_string_append_c (json, '"');
+}
+
+/* Returns the report as JSON, to attach to bug reports */
+
+gchar *
+sd_memory_report_to_json (SDMemoryReport *report)
+{
+  GString *json = g_string_new ("{\n");
+  guint i;
+  guint j;
+
+  g_string_append_printf (json, "  \"total\": %" G_GSIZE_FORMAT ",\n",
+			  report->total);
+  g_string_append (json, "  \"groups\": [");
+  for (i = 0; i < report->groups->len; i++)
+    {
+      SDMemoryGroup *group = g_ptr_array_index (report->groups, i);
+      g_string_append (json, i == 0 ? "\n    {\"name\": " :
+		       ",\n    {\"name\": ");
+      sd_memory_json_string (json, group->name);
+      g_string_append_printf (json, ", \"bytes\": %" G_GSIZE_FORMAT
+			      ", \"items\": [", group->bytes);
+      for (j = 0; j < group->items->len; j++)
+	{
+	  SDMemoryItem *item = &g_array_index (group->items, SDMemoryItem, j);
+	  g_string_append (json, j == 0 ? "\n      {\"name\": " :
+			   ",\n      {\"name\": ");
+	  sd_memory_json_string (json, item->name);
+	  g_string_append_printf (json, ", \"bytes\": %" G_GSIZE_FORMAT "}",
+				  item->bytes);
+	}
+      g_string_append (json, "]}");
+    }
+  g_string_append (json, "\n  ]\n}\n");
+  return g_string_free (json, FALSE);
+}
@@ -0,0 +1,64 @@
+/* sd-memory.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_MEMORY_H
+#define _SD_MEMORY_H
+
+#include <gtk/gtk.h>
+
+/* Estimated memory use, in groups such as one per editor tab. Sizes are
+   estimated from counts kept by each part of the program, so a report is
+   cheap to make. */
+
+struct _SDMemoryItem
+{
+  gchar *name;
+  gsize bytes;
+};
+
+typedef struct _SDMemoryItem SDMemoryItem;
+
+struct _SDMemoryGroup
+{
+  gchar *name;
+  gsize bytes;
+  GArray *items;
+};
+
+typedef struct _SDMemoryGroup SDMemoryGroup;
+
+struct _SDMemoryReport
+{
+  GPtrArray *groups;
+  gsize total;
+};
+
+typedef struct _SDMemoryReport SDMemoryReport;
+
+G_BEGIN_DECLS
+
+SDMemoryReport *sd_memory_report_new (void);
+void sd_memory_report_free (SDMemoryReport *report);
+void sd_memory_report_begin (SDMemoryReport *report, const gchar *group);
+void sd_memory_report_add (SDMemoryReport *report, const gchar *name,
+			   gsize bytes);
+void sd_memory_report_add_buffer (SDMemoryReport *report,
+				  GtkTextBuffer *buffer);
+gchar *sd_memory_report_to_json (SDMemoryReport *report);
+
+G_END_DECLS
+
+#endif
@@ -21,6 +21,10 @@ struct _SDPreferencesPrivate
   GSettings *settings;
   GtkWidget *linenos;
   GtkWidget *font;
+  GtkWidget *diff_head;
+  GtkWidget *undo_limit;
+  GtkWidget *undo_memory;
+  GtkWidget *undo_swap;
 };
 
 typedef struct _SDPreferencesPrivate SDPreferencesPrivate;
@@ -46,6 +50,14 @@ sd_preferences_init (SDPreferences *self)
 		   G_SETTINGS_BIND_DEFAULT);
   g_settings_bind (priv->settings, "font", priv->font, "font",
 		   G_SETTINGS_BIND_DEFAULT);
+  g_settings_bind (priv->settings, "diff-against-head", priv->diff_head,
+		   "active", G_SETTINGS_BIND_DEFAULT);
+  g_settings_bind (priv->settings, "undo-limit", priv->undo_limit, "value",
+		   G_SETTINGS_BIND_DEFAULT);
+  g_settings_bind (priv->settings, "undo-memory-limit", priv->undo_memory,
+		   "value", G_SETTINGS_BIND_DEFAULT);
+  g_settings_bind (priv->settings, "undo-swap", priv->undo_swap, "active",
+		   G_SETTINGS_BIND_DEFAULT);
 }
 
 static void
@@ -58,6 +70,14 @@ sd_preferences_class_init (SDPreferencesClass *klass)
 						SDPreferences, linenos);
   gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
 						SDPreferences, font);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDPreferences, diff_head);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDPreferences, undo_limit);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDPreferences, undo_memory);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDPreferences, undo_swap);
 }
 
 SDPreferences *
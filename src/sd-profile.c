@@ -0,0 +1,116 @@
+/* sd-profile.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include "sd-profile.h"
+
+struct _SDProfileStage
+{
+  gchar *name;
+  gint64 start;
+  gint64 end;
+};
+
+typedef struct _SDProfileStage SDProfileStage;
+
+struct _SDProfile
+{
+  gchar *name;
+  GArray *stages;
+};
+
+static gint64 sd_profile_start;
+static gboolean sd_profile_enabled;
+
+static void
+sd_profile_stage_clear (gpointer data)
+{
+  SDProfileStage *stage = data;
+  g_free (stage->name);
+}
+
+void
+sd_profile_init (void)
+{
+  sd_profile_start = g_get_monotonic_time ();
+}
+
+void
+sd_profile_set_enabled (gboolean enabled)
+{
+  sd_profile_enabled = enabled;
+}
+
+gboolean
+sd_profile_get_enabled (void)
+{
+  return sd_profile_enabled;
+}
+
+gint64
+sd_profile_now (void)
+{
+  return g_get_monotonic_time () - sd_profile_start;
+}
+
+SDProfile *
+sd_profile_new (const gchar *name)
+{
+  SDProfile *self = g_malloc (sizeof (SDProfile));
+  self->name = g_strdup (name);
+  self->stages = g_array_new (FALSE, FALSE, sizeof (SDProfileStage));
+  g_array_set_clear_func (self->stages, sd_profile_stage_clear);
+  return self;
+}
+
+void
+sd_profile_free (SDProfile *self)
+{
+  g_array_free (self->stages, TRUE);
+  g_free (self->name);
+  g_free (self);
+}
+
+void
+sd_profile_add (SDProfile *self, const gchar *stage, gint64 start, gint64 end)
+{
+  SDProfileStage s;
+  s.name = g_strdup (stage);
+  s.start = start;
+  s.end = end;
+  g_array_append_val (self->stages, s);
+  g_debug ("Startup stage `%s' of %s took %.1f ms", stage, self->name,
+	   (end - start) / 1000.0);
+}
+
+/* Prints one line per stage with its start time and duration in
+   milliseconds, separated by tabs */
+
+void
+sd_profile_print (SDProfile *self)
+{
+  guint i;
+  printf ("# Startup profile for %s\n", self->name);
+  printf ("# stage\tstart-ms\tduration-ms\n");
+  for (i = 0; i < self->stages->len; i++)
+    {
+      SDProfileStage *stage =
+	&g_array_index (self->stages, SDProfileStage, i);
+      printf ("%s\t%.1f\t%.1f\n", stage->name, stage->start / 1000.0,
+	      (stage->end - stage->start) / 1000.0);
+    }
+  fflush (stdout);
+}
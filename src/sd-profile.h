@@ -0,0 +1,43 @@
+/* sd-profile.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_PROFILE_H
+#define _SD_PROFILE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Records how long each startup stage of a window took. Times are in
+   microseconds from sd_profile_init, which should be called as early as
+   possible in main. */
+
+typedef struct _SDProfile SDProfile;
+
+void sd_profile_init (void);
+void sd_profile_set_enabled (gboolean enabled);
+gboolean sd_profile_get_enabled (void);
+gint64 sd_profile_now (void);
+
+SDProfile *sd_profile_new (const gchar *name);
+void sd_profile_free (SDProfile *self);
+void sd_profile_add (SDProfile *self, const gchar *stage, gint64 start,
+		     gint64 end);
+void sd_profile_print (SDProfile *self);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,951 @@
+/* sd-project-search.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <string.h>
+#include "sd-index.h"
+#include "sd-io.h"
+#include "sd-project-search.h"
+#include "sd-scan.h"
+
+/* At most this many matches are shown for each file */
+#define SD_PROJECT_SEARCH_HUNK_LIMIT 100
+
+/* Results are added to the view for at most this many microseconds
+   before yielding to the main loop */
+#define SD_PROJECT_SEARCH_BATCH_TIME 8000
+
+enum
+{
+  RESULT_ACTIVE_COLUMN = 0,
+  RESULT_IS_FILE_COLUMN,
+  RESULT_LOCATION_COLUMN,
+  RESULT_BEFORE_COLUMN,
+  RESULT_AFTER_COLUMN,
+  RESULT_PATH_COLUMN,
+  RESULT_LINE_COLUMN,
+  RESULT_N_COLUMNS
+};
+
+struct _SDProjectSearchHunk
+{
+  gint line;
+  gchar *before;
+  gchar *after;
+};
+
+typedef struct _SDProjectSearchHunk SDProjectSearchHunk;
+
+struct _SDProjectSearchFile
+{
+  guint count;
+  GPtrArray *hunks;
+};
+
+typedef struct _SDProjectSearchFile SDProjectSearchFile;
+
+/* A search or rewrite of a set of files on the thread pool. Workers only
+   read the fields that are set before the first file is queued, and each
+   one writes to its own slot of COUNTS, RESULTS and ERRORS, so the job
+   needs no locking. The job is finished on the main thread after the last
+   file is done. */
+
+struct _SDProjectSearchJob
+{
+  SDProjectSearch *dialog;
+  gchar *root;
+  GRegex *regex;
+  gchar *replace;
+  gboolean expand;
+  gboolean rewrite;
+  GHashTable *buffers;
+  GPtrArray *paths;
+  GPtrArray *results;
+  GPtrArray *errors;
+  guint *counts;
+  GCancellable *cancellable;
+  gint pending;
+  guint pos;
+  guint nfiles;
+  guint nmatches;
+  gint64 start;
+};
+
+typedef struct _SDProjectSearchJob SDProjectSearchJob;
+
+struct _SDProjectSearchTask
+{
+  SDProjectSearchJob *job;
+  guint index;
+};
+
+typedef struct _SDProjectSearchTask SDProjectSearchTask;
+
+struct _SDProjectSearchPrivate
+{
+  SDWindow *window;
+  SDEditor *editor;
+  GFile *root;
+  GtkWidget *search_entry;
+  GtkWidget *replace_entry;
+  GtkWidget *case_check;
+  GtkWidget *regex_check;
+  GtkWidget *find_button;
+  GtkWidget *replace_button;
+  GtkWidget *results_view;
+  GtkWidget *status_label;
+  GtkTreeStore *store;
+  SDProjectSearchJob *job;
+  GRegex *regex;
+  gchar *replace;
+  gboolean expand;
+  gboolean disposed;
+};
+
+typedef struct _SDProjectSearchPrivate SDProjectSearchPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDProjectSearch, sd_project_search, GTK_TYPE_DIALOG)
+
+static void sd_project_search_worker (gpointer data, gpointer user_data);
+
+/* Every dialog shares one pool, sized to the number of processors. It is
+   never freed, so rewrites that are still queued when a dialog is closed
+   run to completion. */
+
+static GThreadPool *
+sd_project_search_get_pool (void)
+{
+  static gsize init = 0;
+  static GThreadPool *pool;
+  if (g_once_init_enter (&init))
+    {
+      pool = g_thread_pool_new (sd_project_search_worker, NULL,
+				g_get_num_processors (), FALSE, NULL);
+      g_once_init_leave (&init, 1);
+    }
+  return pool;
+}
+
+static void
+sd_project_search_hunk_free (gpointer data)
+{
+  SDProjectSearchHunk *hunk = data;
+  g_free (hunk->before);
+  g_free (hunk->after);
+  g_free (hunk);
+}
+
+static void
+sd_project_search_file_free (gpointer data)
+{
+  SDProjectSearchFile *file = data;
+  if (file == NULL)
+    return;
+  g_ptr_array_free (file->hunks, TRUE);
+  g_free (file);
+}
+
+static SDProjectSearchJob *
+sd_project_search_job_new (SDProjectSearch *self, gboolean rewrite)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  SDProjectSearchJob *job = g_malloc0 (sizeof (SDProjectSearchJob));
+  job->dialog = g_object_ref (self);
+  job->root = g_file_get_path (priv->root);
+  job->regex = g_regex_ref (priv->regex);
+  job->replace = g_strdup (priv->replace);
+  job->expand = priv->expand;
+  job->rewrite = rewrite;
+  job->buffers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					g_free);
+  job->results = g_ptr_array_new_with_free_func (sd_project_search_file_free);
+  job->errors = g_ptr_array_new_with_free_func (g_free);
+  job->cancellable = g_cancellable_new ();
+  job->start = g_get_monotonic_time ();
+  return job;
+}
+
+static void
+sd_project_search_job_free (SDProjectSearchJob *job)
+{
+  g_object_unref (job->dialog);
+  g_free (job->root);
+  g_regex_unref (job->regex);
+  g_free (job->replace);
+  g_hash_table_unref (job->buffers);
+  if (job->paths != NULL)
+    g_ptr_array_free (job->paths, TRUE);
+  g_ptr_array_free (job->results, TRUE);
+  g_ptr_array_free (job->errors, TRUE);
+  g_free (job->counts);
+  g_object_unref (job->cancellable);
+  g_free (job);
+}
+
+/* Reads the contents of a file to search. Unsaved text of files open in
+   the editor is used instead of their contents on disk. Returns NULL if
+   the file can't be read or doesn't look like text. */
+
+static gchar *
+sd_project_search_load (SDProjectSearchJob *job, const gchar *rel,
+			gsize *len)
+{
+  const gchar *text = g_hash_table_lookup (job->buffers, rel);
+  gchar *contents;
+
+  if (text != NULL)
+    {
+      *len = strlen (text);
+      return g_strdup (text);
+    }
+  else
+    {
+      gchar *path = g_build_filename (job->root, rel, NULL);
+      gboolean ret = g_file_get_contents (path, &contents, len, NULL);
+      g_free (path);
+      if (!ret)
+	return NULL;
+    }
+
+  if (!sd_scan_is_text (contents, *len))
+    {
+      g_free (contents);
+      return NULL;
+    }
+  return contents;
+}
+
+static gchar *
+sd_project_search_expand (SDProjectSearchJob *job, const GMatchInfo *info)
+{
+  gchar *text = NULL;
+  if (job->expand)
+    text = g_match_info_expand_references (info, job->replace, NULL);
+  return text == NULL ? g_strdup (job->replace) : text;
+}
+
+static void
+sd_project_search_file (SDProjectSearchJob *job, guint index)
+{
+  const gchar *rel = g_ptr_array_index (job->paths, index);
+  SDProjectSearchFile *result;
+  GMatchInfo *info;
+  gchar *contents;
+  gsize len;
+  gsize pos = 0;
+  gint line = 1;
+
+  contents = sd_project_search_load (job, rel, &len);
+  if (contents == NULL)
+    return;
+  g_regex_match_full (job->regex, contents, len, 0, 0, &info, NULL);
+  if (!g_match_info_matches (info))
+    {
+      g_match_info_free (info);
+      g_free (contents);
+      return;
+    }
+
+  result = g_malloc (sizeof (SDProjectSearchFile));
+  result->count = 0;
+  result->hunks = g_ptr_array_new_with_free_func (sd_project_search_hunk_free);
+  while (g_match_info_matches (info))
+    {
+      gint start;
+      gint end;
+
+      g_match_info_fetch_pos (info, 0, &start, &end);
+      for (; pos < start; pos++)
+	{
+	  if (contents[pos] == '\n')
+	    line++;
+	}
+      result->count++;
+
+      if (result->hunks->len < SD_PROJECT_SEARCH_HUNK_LIMIT)
+	{
+	  SDProjectSearchHunk *hunk = g_malloc (sizeof (SDProjectSearchHunk));
+	  const gchar *line_start = contents + start;
+	  const gchar *line_end = memchr (contents + start, '\n', len - start);
+	  gchar *replace = sd_project_search_expand (job, info);
+
+	  while (line_start > contents && line_start[-1] != '\n')
+	    line_start--;
+	  if (line_end == NULL)
+	    line_end = contents + len;
+
+	  /* The preview only shows the line the match starts on */
+	  hunk->line = line;
+	  hunk->before = g_strndup (line_start, line_end - line_start);
+	  hunk->after =
+	    g_strdup_printf ("%.*s%s%.*s", (gint) (contents + start - line_start),
+			     line_start, replace,
+			     contents + end < line_end ?
+			     (gint) (line_end - contents - end) : 0,
+			     contents + end);
+	  g_ptr_array_add (result->hunks, hunk);
+	  g_free (replace);
+	}
+      g_match_info_next (info, NULL);
+    }
+  g_match_info_free (info);
+  g_free (contents);
+  g_ptr_array_index (job->results, index) = result;
+}
+
+/* Writes the replaced contents of a file to a temporary file a piece at a
+   time, then renames it over the original */
+
+static void
+sd_project_search_rewrite_file (SDProjectSearchJob *job, guint index)
+{
+  const gchar *rel = g_ptr_array_index (job->paths, index);
+  gchar *path = g_build_filename (job->root, rel, NULL);
+  SDAtomicFile *file = NULL;
+  GError *err = NULL;
+  GMatchInfo *info;
+  gchar *contents;
+  gsize len;
+  gsize last = 0;
+  guint count = 0;
+
+  contents = sd_project_search_load (job, rel, &len);
+  if (contents == NULL)
+    {
+      g_free (path);
+      return;
+    }
+
+  g_regex_match_full (job->regex, contents, len, 0, 0, &info, NULL);
+  while (g_match_info_matches (info))
+    {
+      gchar *replace = sd_project_search_expand (job, info);
+      gint start;
+      gint end;
+
+      g_match_info_fetch_pos (info, 0, &start, &end);
+      if (file == NULL)
+	file = sd_atomic_file_open (path, &err);
+      if (file == NULL
+	  || !sd_atomic_file_write (file, contents + last, start - last, &err)
+	  || !sd_atomic_file_write (file, replace, strlen (replace), &err))
+	{
+	  g_free (replace);
+	  break;
+	}
+      g_free (replace);
+      last = end;
+      count++;
+      g_match_info_next (info, NULL);
+    }
+  g_match_info_free (info);
+
+  if (file != NULL)
+    {
+      if (err == NULL
+	  && sd_atomic_file_write (file, contents + last, len - last, &err))
+	sd_atomic_file_commit (file, &err);
+      else
+	sd_atomic_file_abort (file);
+    }
+  if (err != NULL)
+    {
+      g_ptr_array_index (job->errors, index) = g_strdup (err->message);
+      g_error_free (err);
+    }
+  else
+    job->counts[index] = count;
+  g_free (contents);
+  g_free (path);
+}
+
+static gboolean sd_project_search_insert_batch (gpointer user_data);
+static gboolean sd_project_search_rewrite_done (gpointer user_data);
+
+static void
+sd_project_search_worker (gpointer data, gpointer user_data)
+{
+  SDProjectSearchTask *task = data;
+  SDProjectSearchJob *job = task->job;
+
+  if (!g_cancellable_is_cancelled (job->cancellable))
+    {
+      if (job->rewrite)
+	sd_project_search_rewrite_file (job, task->index);
+      else
+	sd_project_search_file (job, task->index);
+    }
+  if (g_atomic_int_dec_and_test (&job->pending))
+    g_idle_add (job->rewrite ? sd_project_search_rewrite_done :
+		sd_project_search_insert_batch, job);
+  g_free (task);
+}
+
+/* Queues every file of JOB on the thread pool. May be called from any
+   thread. */
+
+static void
+sd_project_search_queue (SDProjectSearchJob *job)
+{
+  GThreadPool *pool = sd_project_search_get_pool ();
+  guint i;
+
+  g_ptr_array_set_size (job->results, job->paths->len);
+  g_ptr_array_set_size (job->errors, job->paths->len);
+  job->counts = g_new0 (guint, job->paths->len);
+  if (job->paths->len == 0)
+    {
+      g_idle_add (job->rewrite ? sd_project_search_rewrite_done :
+		  sd_project_search_insert_batch, job);
+      return;
+    }
+
+  job->pending = job->paths->len;
+  for (i = 0; i < job->paths->len; i++)
+    {
+      SDProjectSearchTask *task = g_malloc (sizeof (SDProjectSearchTask));
+      task->job = job;
+      task->index = i;
+      g_thread_pool_push (pool, task, NULL);
+    }
+}
+
+/* Lists the project's files on a separate thread, since the pool's
+   threads may all be busy with another job */
+
+static gpointer
+sd_project_search_scan_thread (gpointer data)
+{
+  SDProjectSearchJob *job = data;
+  job->paths = sd_scan_files (job->root, job->cancellable);
+
+  /* Keep the index used by the command line tools up to date */
+  if (!g_cancellable_is_cancelled (job->cancellable))
+    sd_index_save (job->root, job->paths, NULL);
+  sd_project_search_queue (job);
+  return NULL;
+}
+
+/* Adds the results of a finished search to the view for a bounded slice of
+   time, so searches matching many files don't block the main loop */
+
+static gboolean
+sd_project_search_insert_batch (gpointer user_data)
+{
+  SDProjectSearchJob *job = user_data;
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (job->dialog);
+  gint64 start = g_get_monotonic_time ();
+  gchar *text;
+
+  if (priv->disposed || priv->job != job)
+    {
+      sd_project_search_job_free (job);
+      return G_SOURCE_REMOVE;
+    }
+
+  for (; job->pos < job->paths->len; job->pos++)
+    {
+      SDProjectSearchFile *result =
+	g_ptr_array_index (job->results, job->pos);
+      const gchar *rel = g_ptr_array_index (job->paths, job->pos);
+      GtkTreeIter parent;
+      GtkTreeIter iter;
+      guint i;
+
+      if (g_get_monotonic_time () - start > SD_PROJECT_SEARCH_BATCH_TIME)
+	return G_SOURCE_CONTINUE;
+      if (result == NULL)
+	continue;
+
+      text = g_strdup_printf (result->count == 1 ? "%s (%u match)" :
+			      "%s (%u matches)", rel, result->count);
+      gtk_tree_store_insert_with_values (priv->store, &parent, NULL, -1,
+					 RESULT_ACTIVE_COLUMN, TRUE,
+					 RESULT_IS_FILE_COLUMN, TRUE,
+					 RESULT_LOCATION_COLUMN, text,
+					 RESULT_PATH_COLUMN, rel,
+					 RESULT_LINE_COLUMN, 0, -1);
+      g_free (text);
+      for (i = 0; i < result->hunks->len; i++)
+	{
+	  SDProjectSearchHunk *hunk = g_ptr_array_index (result->hunks, i);
+	  text = g_strdup_printf ("%d", hunk->line);
+	  gtk_tree_store_insert_with_values (priv->store, &iter, &parent, -1,
+					     RESULT_ACTIVE_COLUMN, FALSE,
+					     RESULT_IS_FILE_COLUMN, FALSE,
+					     RESULT_LOCATION_COLUMN, text,
+					     RESULT_BEFORE_COLUMN, hunk->before,
+					     RESULT_AFTER_COLUMN, hunk->after,
+					     RESULT_PATH_COLUMN, rel,
+					     RESULT_LINE_COLUMN, hunk->line, -1);
+	  g_free (text);
+	}
+      job->nfiles++;
+      job->nmatches += result->count;
+    }
+
+  g_debug ("Searched %u files in %.1f ms", job->paths->len,
+	   (g_get_monotonic_time () - job->start) / 1000.0);
+  text = g_strdup_printf ("%u matches in %u of %u files", job->nmatches,
+			  job->nfiles, job->paths->len);
+  gtk_label_set_text (GTK_LABEL (priv->status_label), text);
+  g_free (text);
+  gtk_widget_set_sensitive (priv->replace_button, job->nmatches > 0);
+  priv->job = NULL;
+  sd_project_search_job_free (job);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+sd_project_search_rewrite_done (gpointer user_data)
+{
+  SDProjectSearchJob *job = user_data;
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (job->dialog);
+  GString *errors = g_string_new (NULL);
+  guint nfailed = 0;
+  guint i;
+
+  for (i = 0; i < job->paths->len; i++)
+    {
+      const gchar *err = g_ptr_array_index (job->errors, i);
+      if (err != NULL)
+	{
+	  g_critical ("%s", err);
+	  g_string_append_printf (errors, "%s\n", err);
+	  nfailed++;
+	}
+      else if (job->counts[i] > 0)
+	{
+	  job->nfiles++;
+	  job->nmatches += job->counts[i];
+	}
+    }
+  g_debug ("Rewrote %u files in %.1f ms", job->nfiles,
+	   (g_get_monotonic_time () - job->start) / 1000.0);
+
+  if (!priv->disposed)
+    {
+      gchar *text = g_strdup_printf ("Replaced %u matches in %u files",
+				     job->nmatches, job->nfiles);
+      gtk_label_set_text (GTK_LABEL (priv->status_label), text);
+      g_free (text);
+      gtk_widget_set_sensitive (priv->find_button, TRUE);
+    }
+  if (nfailed > 0 && priv->window != NULL)
+    {
+      GtkWidget *dialog =
+	gtk_message_dialog_new (GTK_WINDOW (priv->window),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+				"Failed to replace text in %u of %u files",
+				nfailed, job->paths->len);
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog),
+						"%s", errors->str);
+      g_signal_connect_swapped (dialog, "response",
+				G_CALLBACK (gtk_widget_destroy), dialog);
+      gtk_widget_show (dialog);
+    }
+  g_string_free (errors, TRUE);
+  sd_project_search_job_free (job);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_project_search_cancel (SDProjectSearch *self)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  if (priv->job != NULL)
+    {
+      /* The job is freed on the main thread when its queued files have
+	 been skipped */
+      g_cancellable_cancel (priv->job->cancellable);
+      priv->job = NULL;
+    }
+}
+
+static void
+sd_project_search_find (GtkWidget *widget, gpointer user_data)
+{
+  SDProjectSearch *self = SD_PROJECT_SEARCH (user_data);
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  const gchar *search = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+  GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+  GError *err = NULL;
+  GPtrArray *files;
+  gchar *pattern;
+  gint current;
+  guint i;
+
+  sd_project_search_cancel (self);
+  gtk_tree_store_clear (priv->store);
+  gtk_widget_set_sensitive (priv->replace_button, FALSE);
+  g_clear_pointer (&priv->regex, g_regex_unref);
+  g_clear_pointer (&priv->replace, g_free);
+  if (*search == '\0')
+    {
+      gtk_label_set_text (GTK_LABEL (priv->status_label), NULL);
+      return;
+    }
+
+  priv->expand =
+    gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->regex_check));
+  if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->case_check)))
+    flags |= G_REGEX_CASELESS;
+  pattern = priv->expand ? g_strdup (search) :
+    g_regex_escape_string (search, -1);
+  priv->regex = g_regex_new (pattern, flags, 0, &err);
+  g_free (pattern);
+  if (priv->regex == NULL)
+    {
+      gtk_label_set_text (GTK_LABEL (priv->status_label), err->message);
+      g_error_free (err);
+      return;
+    }
+  priv->replace =
+    g_strdup (gtk_entry_get_text (GTK_ENTRY (priv->replace_entry)));
+
+  /* Search the current text of open files rather than what was last
+     saved */
+  priv->job = sd_project_search_job_new (self, FALSE);
+  files = sd_editor_get_files (priv->editor, &current);
+  for (i = 0; i < files->len; i++)
+    {
+      GFile *file = g_ptr_array_index (files, i);
+      GtkTextBuffer *buffer = sd_editor_get_buffer (priv->editor, file);
+      gchar *rel = g_file_get_relative_path (priv->root, file);
+      GtkTextIter start;
+      GtkTextIter end;
+
+      if (rel == NULL || buffer == NULL)
+	{
+	  g_free (rel);
+	  continue;
+	}
+      gtk_text_buffer_get_bounds (buffer, &start, &end);
+      g_hash_table_insert (priv->job->buffers, rel,
+			   gtk_text_buffer_get_text (buffer, &start, &end,
+						     TRUE));
+    }
+  g_ptr_array_free (files, TRUE);
+
+  gtk_label_set_text (GTK_LABEL (priv->status_label), "Searching...");
+  g_thread_unref (g_thread_new ("sd-project-search",
+				sd_project_search_scan_thread, priv->job));
+}
+
+/* Replaces every match in an open file's buffer as a single user action,
+   so the editor's contents are never overwritten on disk. Returns the
+   number of matches replaced. */
+
+static guint
+sd_project_search_replace_buffer (SDProjectSearch *self,
+				  GtkTextBuffer *buffer)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  GArray *offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+  GPtrArray *replacements = g_ptr_array_new_with_free_func (g_free);
+  GMatchInfo *info;
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  gint last_byte = 0;
+  gint last_offset = 0;
+  guint count;
+  gint i;
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+  g_regex_match (priv->regex, text, 0, &info);
+  while (g_match_info_matches (info))
+    {
+      gchar *replace = NULL;
+      gint pos[2];
+      gint s;
+      gint e;
+
+      g_match_info_fetch_pos (info, 0, &s, &e);
+      pos[0] = last_offset + g_utf8_strlen (text + last_byte, s - last_byte);
+      pos[1] = pos[0] + g_utf8_strlen (text + s, e - s);
+      last_byte = e;
+      last_offset = pos[1];
+      g_array_append_vals (offsets, pos, 2);
+      if (priv->expand)
+	replace = g_match_info_expand_references (info, priv->replace, NULL);
+      g_ptr_array_add (replacements,
+		       replace == NULL ? g_strdup (priv->replace) : replace);
+      g_match_info_next (info, NULL);
+    }
+  g_match_info_free (info);
+  g_free (text);
+
+  count = replacements->len;
+  if (count > 0)
+    {
+      gtk_text_buffer_begin_user_action (buffer);
+      for (i = count - 1; i >= 0; i--)
+	{
+	  gtk_text_buffer_get_iter_at_offset (buffer, &start,
+					      g_array_index (offsets, gint,
+							     i * 2));
+	  gtk_text_buffer_get_iter_at_offset (buffer, &end,
+					      g_array_index (offsets, gint,
+							     i * 2 + 1));
+	  gtk_text_buffer_delete (buffer, &start, &end);
+	  gtk_text_buffer_insert (buffer, &start,
+				  g_ptr_array_index (replacements, i), -1);
+	}
+      gtk_text_buffer_end_user_action (buffer);
+    }
+  g_array_free (offsets, TRUE);
+  g_ptr_array_free (replacements, TRUE);
+  return count;
+}
+
+static void
+sd_project_search_replace (GtkButton *button, gpointer user_data)
+{
+  SDProjectSearch *self = SD_PROJECT_SEARCH (user_data);
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  GtkTreeModel *model = GTK_TREE_MODEL (priv->store);
+  SDProjectSearchJob *job;
+  GtkTreeIter iter;
+  guint nbuffers = 0;
+  guint nmatches = 0;
+
+  if (priv->regex == NULL || priv->job != NULL)
+    return;
+
+  /* Files open in the editor are changed in their buffers, and the rest
+     are rewritten on the thread pool */
+  job = sd_project_search_job_new (self, TRUE);
+  job->paths = g_ptr_array_new_with_free_func (g_free);
+  if (gtk_tree_model_get_iter_first (model, &iter))
+    {
+      do
+	{
+	  GtkTextBuffer *buffer;
+	  gboolean active;
+	  GFile *file;
+	  gchar *rel;
+
+	  gtk_tree_model_get (model, &iter, RESULT_ACTIVE_COLUMN, &active,
+			      RESULT_PATH_COLUMN, &rel, -1);
+	  if (!active)
+	    {
+	      g_free (rel);
+	      continue;
+	    }
+	  file = g_file_resolve_relative_path (priv->root, rel);
+	  buffer = sd_editor_get_buffer (priv->editor, file);
+	  g_object_unref (file);
+	  if (buffer != NULL)
+	    {
+	      guint count = sd_project_search_replace_buffer (self, buffer);
+	      if (count > 0)
+		{
+		  nbuffers++;
+		  nmatches += count;
+		}
+	      g_free (rel);
+	    }
+	  else
+	    g_ptr_array_add (job->paths, rel);
+	}
+      while (gtk_tree_model_iter_next (model, &iter));
+    }
+
+  /* The results no longer match the files */
+  gtk_tree_store_clear (priv->store);
+  gtk_widget_set_sensitive (priv->replace_button, FALSE);
+  gtk_widget_set_sensitive (priv->find_button, FALSE);
+  gtk_label_set_text (GTK_LABEL (priv->status_label), "Replacing...");
+  job->nfiles = nbuffers;
+  job->nmatches = nmatches;
+  sd_project_search_queue (job);
+}
+
+static void
+sd_project_search_toggled (GtkCellRendererToggle *renderer, gchar *path,
+			   gpointer user_data)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (SD_PROJECT_SEARCH (user_data));
+  GtkTreeIter iter;
+  gboolean active;
+
+  if (!gtk_tree_model_get_iter_from_string (GTK_TREE_MODEL (priv->store),
+					    &iter, path))
+    return;
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
+		      RESULT_ACTIVE_COLUMN, &active, -1);
+  gtk_tree_store_set (priv->store, &iter, RESULT_ACTIVE_COLUMN, !active, -1);
+}
+
+static void
+sd_project_search_activated (GtkTreeView *view, GtkTreePath *path,
+			     GtkTreeViewColumn *column, gpointer user_data)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (SD_PROJECT_SEARCH (user_data));
+  GtkTreeIter iter;
+  GFile *file;
+  gchar *name;
+  gchar *rel;
+  gint line;
+
+  if (priv->window == NULL
+      || !gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), &iter, path))
+    return;
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
+		      RESULT_PATH_COLUMN, &rel, RESULT_LINE_COLUMN, &line, -1);
+  file = g_file_resolve_relative_path (priv->root, rel);
+  name = g_file_get_basename (file);
+  sd_window_editor_open_at (priv->window, name, file, line, 0);
+  g_free (name);
+  g_free (rel);
+  g_object_unref (file);
+}
+
+static void
+sd_project_search_dispose (GObject *obj)
+{
+  SDProjectSearch *self = SD_PROJECT_SEARCH (obj);
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  sd_project_search_cancel (self);
+  priv->disposed = TRUE;
+  priv->editor = NULL;
+  g_clear_object (&priv->store);
+  G_OBJECT_CLASS (sd_project_search_parent_class)->dispose (obj);
+}
+
+static void
+sd_project_search_finalize (GObject *obj)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (SD_PROJECT_SEARCH (obj));
+
+  /* Rewrites can finish after the dialog is closed, and still report
+     errors on the main window */
+  if (priv->window != NULL)
+    g_object_remove_weak_pointer (G_OBJECT (priv->window),
+				  (gpointer *) &priv->window);
+  g_clear_object (&priv->root);
+  g_clear_pointer (&priv->regex, g_regex_unref);
+  g_free (priv->replace);
+  G_OBJECT_CLASS (sd_project_search_parent_class)->finalize (obj);
+}
+
+static void
+sd_project_search_init (SDProjectSearch *self)
+{
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  GtkCellRenderer *renderer;
+  GtkTreeViewColumn *col;
+
+  gtk_widget_init_template (GTK_WIDGET (self));
+  priv->store = gtk_tree_store_new (RESULT_N_COLUMNS, G_TYPE_BOOLEAN,
+				    G_TYPE_BOOLEAN, G_TYPE_STRING,
+				    G_TYPE_STRING, G_TYPE_STRING,
+				    G_TYPE_STRING, G_TYPE_INT);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->results_view),
+			   GTK_TREE_MODEL (priv->store));
+
+  renderer = gtk_cell_renderer_toggle_new ();
+  g_signal_connect (renderer, "toggled",
+		    G_CALLBACK (sd_project_search_toggled), self);
+  col = gtk_tree_view_column_new_with_attributes (NULL, renderer,
+						  "active",
+						  RESULT_ACTIVE_COLUMN,
+						  "visible",
+						  RESULT_IS_FILE_COLUMN, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->results_view), col);
+  col = gtk_tree_view_column_new_with_attributes ("Location",
+						  gtk_cell_renderer_text_new (),
+						  "text",
+						  RESULT_LOCATION_COLUMN,
+						  NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->results_view), col);
+  col = gtk_tree_view_column_new_with_attributes ("Before",
+						  gtk_cell_renderer_text_new (),
+						  "text",
+						  RESULT_BEFORE_COLUMN, NULL);
+  gtk_tree_view_column_set_resizable (col, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->results_view), col);
+  col = gtk_tree_view_column_new_with_attributes ("After",
+						  gtk_cell_renderer_text_new (),
+						  "text",
+						  RESULT_AFTER_COLUMN, NULL);
+  gtk_tree_view_column_set_resizable (col, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (priv->results_view), col);
+
+  g_signal_connect (priv->results_view, "row-activated",
+		    G_CALLBACK (sd_project_search_activated), self);
+  g_signal_connect (priv->search_entry, "activate",
+		    G_CALLBACK (sd_project_search_find), self);
+  g_signal_connect (priv->find_button, "clicked",
+		    G_CALLBACK (sd_project_search_find), self);
+  g_signal_connect (priv->replace_button, "clicked",
+		    G_CALLBACK (sd_project_search_replace), self);
+}
+
+static void
+sd_project_search_class_init (SDProjectSearchClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_project_search_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_project_search_finalize;
+  gtk_widget_class_set_template_from_resource (GTK_WIDGET_CLASS (klass),
+					       SD_RESOURCE_PROJECT_SEARCH_UI);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, search_entry);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, replace_entry);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, case_check);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, regex_check);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, find_button);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch,
+						replace_button);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, results_view);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDProjectSearch, status_label);
+}
+
+SDProjectSearch *
+sd_project_search_new (SDWindow *window, GFile *root, SDEditor *editor)
+{
+  SDProjectSearch *self =
+    g_object_new (SD_TYPE_PROJECT_SEARCH, "transient-for", window,
+		  "use-header-bar", TRUE, NULL);
+  SDProjectSearchPrivate *priv =
+    sd_project_search_get_instance_private (self);
+  priv->window = window;
+  g_object_add_weak_pointer (G_OBJECT (window), (gpointer *) &priv->window);
+  priv->editor = editor;
+  priv->root = g_object_ref (root);
+  return self;
+}
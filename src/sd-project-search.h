@@ -0,0 +1,38 @@
+/* sd-project-search.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_PROJECT_SEARCH_H
+#define _SD_PROJECT_SEARCH_H
+
+#include "sd-editor.h"
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_PROJECT_SEARCH sd_project_search_get_type ()
+G_DECLARE_FINAL_TYPE (SDProjectSearch, sd_project_search, SD, PROJECT_SEARCH,
+		      GtkDialog)
+
+struct _SDProjectSearch
+{
+  GtkDialog parent;
+};
+
+SDProjectSearch *sd_project_search_new (SDWindow *window, GFile *root,
+					SDEditor *editor);
+
+G_END_DECLS
+
+#endif
@@ -14,27 +14,180 @@
    You should have received a copy of the GNU General Public License
    along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
 
+#include <string.h>
 #include "sd-project-tree.h"
 
+/* Rows are inserted in batches, checking the time taken after every
+   SD_PROJECT_TREE_BATCH_CHECK rows and yielding to the main loop after
+   SD_PROJECT_TREE_BATCH_TIME microseconds */
+#define SD_PROJECT_TREE_BATCH_CHECK 256
+#define SD_PROJECT_TREE_BATCH_TIME 8000
+
+/* Milliseconds the cursor must rest on a file before it is previewed, so
+   moving through the tree with the arrow keys doesn't load every file */
+#define SD_PROJECT_TREE_PREVIEW_DELAY 150
+
+/* Filtered trees with at most this many matches are fully expanded */
+#define SD_PROJECT_TREE_EXPAND_LIMIT 1000
+
+struct _SDProjectTreeNode
+{
+  gchar *path;
+  gchar *display;
+  gchar *key;
+  GFile *file;
+  gint parent;
+};
+
+typedef struct _SDProjectTreeNode SDProjectTreeNode;
+
+struct _SDProjectTreeLoad
+{
+  GFile *root;
+  GPtrArray *nodes;
+  GArray *iters;
+  guint pos;
+  gboolean expanded;
+  gint64 insert_start;
+};
+
+typedef struct _SDProjectTreeLoad SDProjectTreeLoad;
+
+struct _SDProjectTreeFilter
+{
+  GPtrArray *keys;
+  GArray *parents;
+  gchar *query;
+  GArray *candidates;
+  GArray *matches;
+  guint8 *visible;
+};
+
+typedef struct _SDProjectTreeFilter SDProjectTreeFilter;
+
 struct _SDProjectTreePrivate
 {
   GtkTreeStore *store;
+  GtkTreeIter root_iter;
+  GFile *root;
   GtkCellRenderer *renderer;
   GtkTreeViewColumn *col;
+  GHashTable *rows;
+  SDGitStatus *git;
+  GCancellable *load_cancel;
+  SDWindow *window;
+  guint preview_id;
+
+  /* Filtering. Each node scanned when loading has its casefolded path in
+     KEYS, the index of its parent directory in PARENTS and its row in
+     ITERS. The last completed filter matched the nodes in MATCHES, and
+     VISIBLE is the visibility currently set in the store. */
+  GtkTreeModel *filter;
+  GPtrArray *keys;
+  GArray *parents;
+  GArray *iters;
+  gboolean loaded;
+  gchar *pending;
+  gchar *query;
+  GArray *matches;
+  GCancellable *filter_cancel;
+  guint8 *visible;
+  guint8 *target;
+  guint apply_pos;
+  guint apply_id;
+
+  /* Bytes of the names, paths and keys of the rows */
+  gsize display_size;
+  gsize path_size;
+  gsize key_size;
 };
 
 typedef struct _SDProjectTreePrivate SDProjectTreePrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (SDProjectTree, sd_project_tree, GTK_TYPE_TREE_VIEW)
 
+static const gchar *
+sd_project_tree_color (const gchar *name, SDGitState state)
+{
+  switch (state)
+    {
+    case SD_GIT_STATE_MODIFIED:
+      return "DarkOrange3";
+    case SD_GIT_STATE_UNTRACKED:
+      return "ForestGreen";
+    case SD_GIT_STATE_IGNORED:
+      return "LightSlateGray";
+    default:
+      return *name == '.' ? "LightSlateGray" : "Black";
+    }
+}
+
+/* Rows are looked up by their path relative to the project directory,
+   which is how git status changes are reported. Tree store iters stay
+   valid as long as the row exists. */
+
+static void
+sd_project_tree_add_row (SDProjectTreePrivate *priv, const gchar *path,
+			 GtkTreeIter *iter)
+{
+  GtkTreeIter *copy = g_new (GtkTreeIter, 1);
+  *copy = *iter;
+  g_hash_table_insert (priv->rows, g_strdup (path), copy);
+}
+
+static void
+sd_project_tree_git_changed (GPtrArray *deltas, gpointer user_data)
+{
+  SDProjectTreePrivate *priv =
+    sd_project_tree_get_instance_private (SD_PROJECT_TREE (user_data));
+  gint i;
+
+  for (i = 0; i < deltas->len; i++)
+    {
+      SDGitDelta *delta = g_ptr_array_index (deltas, i);
+      GtkTreeIter *iter = g_hash_table_lookup (priv->rows, delta->path);
+      const gchar *name;
+      if (iter == NULL)
+	continue;
+      name = strrchr (delta->path, '/');
+      name = name == NULL ? delta->path : name + 1;
+      gtk_tree_store_set (priv->store, iter, FG_COLUMN,
+			  sd_project_tree_color (name, delta->state), -1);
+    }
+}
+
 static void
-sd_project_tree_populate (GtkTreeStore *store, GtkTreeIter *parent, GFile *file)
+sd_project_tree_node_free (gpointer data)
+{
+  SDProjectTreeNode *node = data;
+  g_free (node->path);
+  g_free (node->display);
+  g_free (node->key);
+  g_object_unref (node->file);
+  g_free (node);
+}
+
+static void
+sd_project_tree_load_free (gpointer data)
+{
+  SDProjectTreeLoad *load = data;
+  g_ptr_array_free (load->nodes, TRUE);
+  g_array_unref (load->iters);
+  g_object_unref (load->root);
+  g_free (load);
+}
+
+/* Lists the contents of FILE into NODES, parents before their children */
+
+static void
+sd_project_tree_scan (GPtrArray *nodes, GFile *file, gint parent,
+		      const gchar *prefix)
 {
   GError *err = NULL;
-  GtkTreeIter child;
   GFileEnumerator *en =
     g_file_enumerate_children (file, G_FILE_ATTRIBUTE_STANDARD_NAME ","
-			       G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
+			       G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
+			       G_FILE_ATTRIBUTE_STANDARD_TYPE,
 			       G_FILE_QUERY_INFO_NONE, NULL, &err);
   if (err != NULL)
     {
@@ -50,23 +203,27 @@ sd_project_tree_populate (GtkTreeStore *store, GtkTreeIter *parent, GFile *file)
 
   while (TRUE)
     {
+      SDProjectTreeNode *node;
       GFileInfo *info;
-      GFile *subfile;
-      const gchar *dispname;
       if (!g_file_enumerator_iterate (en, &info, NULL, NULL, &err))
 	goto finish;
       if (info == NULL)
 	break;
 
-      dispname = g_file_info_get_display_name (info);
-      gtk_tree_store_append (store, &child, parent);
-      subfile = g_file_get_child (file, g_file_info_get_name (info));
-      gtk_tree_store_set (store, &child, NAME_COLUMN, dispname, FG_COLUMN,
-			  *dispname == '.' ? "LightSlateGray" : "Black",
-			  FILE_COLUMN, subfile, -1);
+      node = g_malloc (sizeof (SDProjectTreeNode));
+      node->path = g_strconcat (prefix, g_file_info_get_name (info), NULL);
+      node->display = g_strdup (g_file_info_get_display_name (info));
+      node->key = g_utf8_casefold (node->path, -1);
+      node->file = g_file_get_child (file, g_file_info_get_name (info));
+      node->parent = parent;
+      g_ptr_array_add (nodes, node);
 
       if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
-        sd_project_tree_populate (store, &child, subfile);
+	{
+	  gchar *subprefix = g_strconcat (node->path, "/", NULL);
+	  sd_project_tree_scan (nodes, node->file, nodes->len - 1, subprefix);
+	  g_free (subprefix);
+	}
     }
 
  finish:
@@ -80,32 +237,229 @@ sd_project_tree_populate (GtkTreeStore *store, GtkTreeIter *parent, GFile *file)
   g_object_unref (en);
 }
 
+/* Adds scanned rows to the store for a bounded slice of time, so the
+   window keeps drawing and handling input while a large project loads */
+
+static gboolean
+sd_project_tree_insert_batch (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+  SDProjectTree *self = g_task_get_source_object (task);
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  SDProjectTreeLoad *load = g_task_get_task_data (task);
+  gint64 start = g_get_monotonic_time ();
+  GtkTreePath *path;
+
+  /* Nothing more is added once the tree has been disposed */
+  if (g_task_return_error_if_cancelled (task))
+    return G_SOURCE_REMOVE;
+
+  while (load->pos < load->nodes->len)
+    {
+      SDProjectTreeNode *node = g_ptr_array_index (load->nodes, load->pos);
+      GtkTreeIter *parent = node->parent == -1 ? &priv->root_iter :
+	&g_array_index (load->iters, GtkTreeIter, node->parent);
+      GtkTreeIter iter;
+
+      gtk_tree_store_insert_with_values (priv->store, &iter, parent, -1,
+					 NAME_COLUMN, node->display,
+					 FG_COLUMN,
+					 sd_project_tree_color (node->display,
+								SD_GIT_STATE_CLEAN),
+					 FILE_COLUMN, node->file,
+					 VISIBLE_COLUMN, TRUE, -1);
+      g_array_append_val (load->iters, iter);
+      sd_project_tree_add_row (priv, node->path, &iter);
+      priv->display_size += strlen (node->display) + 1;
+      priv->path_size += strlen (node->path) + 1;
+      priv->key_size += strlen (node->key) + 1;
+      g_ptr_array_add (priv->keys, node->key);
+      node->key = NULL;
+      g_array_append_val (priv->parents, node->parent);
+
+      if (++load->pos % SD_PROJECT_TREE_BATCH_CHECK == 0
+	  && g_get_monotonic_time () - start > SD_PROJECT_TREE_BATCH_TIME)
+	break;
+    }
+
+  if (!load->expanded && load->pos > 0)
+    {
+      path = gtk_tree_path_new_first ();
+      gtk_tree_view_expand_row (GTK_TREE_VIEW (self), path, FALSE);
+      gtk_tree_path_free (path);
+      load->expanded = TRUE;
+    }
+  if (load->pos < load->nodes->len)
+    return G_SOURCE_CONTINUE;
+
+  g_debug ("Inserted %u project tree rows in %.1f ms", load->nodes->len,
+	   (g_get_monotonic_time () - load->insert_start) / 1000.0);
+  priv->git = sd_git_status_new (load->root, sd_project_tree_git_changed,
+				 self);
+
+  /* Filter changes made while loading are applied now */
+  priv->iters = g_array_ref (load->iters);
+  priv->visible = g_malloc (load->nodes->len);
+  memset (priv->visible, TRUE, load->nodes->len);
+  priv->loaded = TRUE;
+  if (priv->pending != NULL)
+    {
+      sd_project_tree_set_filter (self, priv->pending);
+      g_clear_pointer (&priv->pending, g_free);
+    }
+  g_clear_object (&priv->load_cancel);
+  g_task_return_boolean (task, TRUE);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_project_tree_load_thread (GTask *task, gpointer source_object,
+			     gpointer task_data, GCancellable *cancellable)
+{
+  SDProjectTreeLoad *load = task_data;
+  gint64 start = g_get_monotonic_time ();
+  GSource *source;
+
+  sd_project_tree_scan (load->nodes, load->root, -1, "");
+  load->insert_start = g_get_monotonic_time ();
+  g_debug ("Scanned %u project files in %.1f ms", load->nodes->len,
+	   (load->insert_start - start) / 1000.0);
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  /* Rows must be added to the store from the main thread */
+  source = g_idle_source_new ();
+  g_task_attach_source (task, source, sd_project_tree_insert_batch);
+  g_source_unref (source);
+}
+
 static void
 sd_project_tree_activated (GtkTreeView *view, GtkTreePath *path,
 			   GtkTreeViewColumn *col, gpointer user_data)
 {
+  SDProjectTreePrivate *priv =
+    sd_project_tree_get_instance_private (SD_PROJECT_TREE (view));
   GtkTreeModel *model = gtk_tree_view_get_model (view);
   SDWindow *window = SD_WINDOW (user_data);
   GFile *file;
   GtkTreeIter iter;
   gchar *name;
 
+  if (priv->preview_id != 0)
+    {
+      g_source_remove (priv->preview_id);
+      priv->preview_id = 0;
+    }
   g_return_if_fail (gtk_tree_model_get_iter (model, &iter, path));
   gtk_tree_model_get (model, &iter, NAME_COLUMN, &name, FILE_COLUMN, &file, -1);
-  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) !=
+  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) ==
       G_FILE_TYPE_REGULAR)
-    return;
+    sd_window_editor_open (window, name, file);
+  g_object_unref (file);
+  g_free (name);
+}
+
+static gboolean
+sd_project_tree_preview (gpointer user_data)
+{
+  SDProjectTree *self = SD_PROJECT_TREE (user_data);
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  GtkTreeSelection *selection =
+    gtk_tree_view_get_selection (GTK_TREE_VIEW (self));
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  GFile *file;
+  gchar *name;
 
-  sd_window_editor_open (window, name, file);
+  priv->preview_id = 0;
+  if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+    return G_SOURCE_REMOVE;
+  gtk_tree_model_get (model, &iter, NAME_COLUMN, &name, FILE_COLUMN, &file, -1);
+  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) ==
+      G_FILE_TYPE_REGULAR)
+    sd_window_editor_preview (priv->window, name, file);
+  g_object_unref (file);
   g_free (name);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_project_tree_cursor_changed (GtkTreeView *view, gpointer user_data)
+{
+  SDProjectTreePrivate *priv =
+    sd_project_tree_get_instance_private (SD_PROJECT_TREE (view));
+  if (priv->preview_id != 0)
+    g_source_remove (priv->preview_id);
+  priv->preview_id = g_timeout_add (SD_PROJECT_TREE_PREVIEW_DELAY,
+				    sd_project_tree_preview, view);
+}
+
+static void
+sd_project_tree_dispose (GObject *obj)
+{
+  SDProjectTreePrivate *priv =
+    sd_project_tree_get_instance_private (SD_PROJECT_TREE (obj));
+  if (priv->preview_id != 0)
+    {
+      g_source_remove (priv->preview_id);
+      priv->preview_id = 0;
+    }
+  if (priv->apply_id != 0)
+    {
+      g_source_remove (priv->apply_id);
+      priv->apply_id = 0;
+    }
+  if (priv->filter_cancel != NULL)
+    {
+      g_cancellable_cancel (priv->filter_cancel);
+      g_clear_object (&priv->filter_cancel);
+    }
+  if (priv->load_cancel != NULL)
+    {
+      g_cancellable_cancel (priv->load_cancel);
+      g_clear_object (&priv->load_cancel);
+    }
+  g_clear_object (&priv->git);
+  g_clear_object (&priv->root);
+  G_OBJECT_CLASS (sd_project_tree_parent_class)->dispose (obj);
+}
+
+static void
+sd_project_tree_finalize (GObject *obj)
+{
+  SDProjectTreePrivate *priv =
+    sd_project_tree_get_instance_private (SD_PROJECT_TREE (obj));
+  g_clear_object (&priv->git);
+  g_hash_table_unref (priv->rows);
+  g_ptr_array_unref (priv->keys);
+  g_array_unref (priv->parents);
+  if (priv->iters != NULL)
+    g_array_unref (priv->iters);
+  if (priv->matches != NULL)
+    g_array_unref (priv->matches);
+  g_free (priv->pending);
+  g_free (priv->query);
+  g_free (priv->visible);
+  g_free (priv->target);
+  g_object_unref (priv->filter);
+  g_object_unref (priv->store);
+  G_OBJECT_CLASS (sd_project_tree_parent_class)->finalize (obj);
 }
 
 static void
 sd_project_tree_init (SDProjectTree *self)
 {
   SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  priv->rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+				      g_free);
   priv->store = gtk_tree_store_new (N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING,
-				    G_TYPE_FILE);
+				    G_TYPE_FILE, G_TYPE_BOOLEAN);
+  priv->filter =
+    gtk_tree_model_filter_new (GTK_TREE_MODEL (priv->store), NULL);
+  gtk_tree_model_filter_set_visible_column (GTK_TREE_MODEL_FILTER
+					    (priv->filter), VISIBLE_COLUMN);
+  priv->keys = g_ptr_array_new_with_free_func (g_free);
+  priv->parents = g_array_new (FALSE, FALSE, sizeof (gint));
   priv->renderer = gtk_cell_renderer_text_new ();
   /* Causes warning because `file' is not an attribute of GtkCellRenderer
      but seems to work anyway */
@@ -115,12 +469,14 @@ sd_project_tree_init (SDProjectTree *self)
 					      "foreground", FG_COLUMN,
 					      "file", FILE_COLUMN, NULL);
   gtk_tree_view_append_column (GTK_TREE_VIEW (self), priv->col);
-  gtk_tree_view_set_model (GTK_TREE_VIEW (self), GTK_TREE_MODEL (priv->store));
+  gtk_tree_view_set_model (GTK_TREE_VIEW (self), priv->filter);
 }
 
 static void
 sd_project_tree_class_init (SDProjectTreeClass *klass)
 {
+  G_OBJECT_CLASS (klass)->dispose = sd_project_tree_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_project_tree_finalize;
 }
 
 SDProjectTree *
@@ -128,8 +484,6 @@ sd_project_tree_new (SDWindow *window, GFile *file)
 {
   SDProjectTree *tree;
   SDProjectTreePrivate *priv;
-  GtkTreeIter parent;
-  GtkTreePath *path;
   GError *err = NULL;
   GFileInfo *info =
     g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
@@ -146,19 +500,268 @@ sd_project_tree_new (SDWindow *window, GFile *file)
   tree = g_object_new (SD_TYPE_PROJECT_TREE, NULL);
   priv = sd_project_tree_get_instance_private (tree);
 
-  gtk_tree_store_append (priv->store, &parent, NULL);
-  gtk_tree_store_set (priv->store, &parent, NAME_COLUMN,
-		      g_file_info_get_display_name (info),
-		      FG_COLUMN, "Black", FILE_COLUMN, file, -1);
+  priv->root = g_object_ref (file);
+  priv->window = window;
+  gtk_tree_store_insert_with_values (priv->store, &priv->root_iter, NULL, -1,
+				     NAME_COLUMN,
+				     g_file_info_get_display_name (info),
+				     FG_COLUMN, "Black", FILE_COLUMN, file,
+				     VISIBLE_COLUMN, TRUE, -1);
   g_object_unref (info);
-  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->store), &parent);
-  sd_project_tree_populate (priv->store, &parent, file);
-
-  path = gtk_tree_path_new_first ();
-  gtk_tree_view_expand_row (GTK_TREE_VIEW (tree), path, FALSE);
-  gtk_tree_path_free (path);
 
   g_signal_connect (tree, "row-activated",
 		    G_CALLBACK (sd_project_tree_activated), window);
+  g_signal_connect (tree, "cursor-changed",
+		    G_CALLBACK (sd_project_tree_cursor_changed), NULL);
   return tree;
 }
+
+/* Fills the tree with the contents of the project directory. The
+   directory is scanned on a worker thread and the rows are added while
+   the main loop is idle. The load is cancelled if the tree is disposed
+   first. */
+
+void
+sd_project_tree_load_async (SDProjectTree *self, GAsyncReadyCallback callback,
+			    gpointer user_data)
+{
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  SDProjectTreeLoad *load = g_malloc (sizeof (SDProjectTreeLoad));
+  GTask *task;
+
+  if (priv->load_cancel != NULL)
+    {
+      g_cancellable_cancel (priv->load_cancel);
+      g_object_unref (priv->load_cancel);
+    }
+  priv->load_cancel = g_cancellable_new ();
+  task = g_task_new (self, priv->load_cancel, callback, user_data);
+
+  load->root = g_object_ref (priv->root);
+  load->nodes = g_ptr_array_new_with_free_func (sd_project_tree_node_free);
+  load->iters = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+  load->pos = 0;
+  load->expanded = FALSE;
+  load->insert_start = 0;
+  g_task_set_task_data (task, load, sd_project_tree_load_free);
+  g_task_run_in_thread (task, sd_project_tree_load_thread);
+  g_object_unref (task);
+}
+
+gboolean
+sd_project_tree_load_finish (SDProjectTree *self, GAsyncResult *result,
+			     GError **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  return g_task_propagate_boolean (G_TASK (result), err);
+}
+
+static void
+sd_project_tree_filter_free (gpointer data)
+{
+  SDProjectTreeFilter *filter = data;
+  g_ptr_array_unref (filter->keys);
+  g_array_unref (filter->parents);
+  g_free (filter->query);
+  if (filter->candidates != NULL)
+    g_array_unref (filter->candidates);
+  if (filter->matches != NULL)
+    g_array_unref (filter->matches);
+  g_free (filter->visible);
+  g_free (filter);
+}
+
+/* Finds the nodes whose path contains the query, and marks them and their
+   ancestors visible. Only the candidates are checked if there are any. */
+
+static void
+sd_project_tree_filter_thread (GTask *task, gpointer source_object,
+			       gpointer task_data, GCancellable *cancellable)
+{
+  SDProjectTreeFilter *filter = task_data;
+  guint n = filter->candidates == NULL ? filter->keys->len :
+    filter->candidates->len;
+  guint i;
+
+  filter->matches = g_array_new (FALSE, FALSE, sizeof (gint));
+  filter->visible = g_malloc0 (filter->keys->len);
+  for (i = 0; i < n; i++)
+    {
+      gint node = filter->candidates == NULL ? i :
+	g_array_index (filter->candidates, gint, i);
+      if (i % SD_PROJECT_TREE_BATCH_CHECK == 0
+	  && g_cancellable_is_cancelled (cancellable))
+	break;
+      if (strstr (g_ptr_array_index (filter->keys, node), filter->query) ==
+	  NULL)
+	continue;
+      g_array_append_val (filter->matches, node);
+      while (node != -1 && !filter->visible[node])
+	{
+	  filter->visible[node] = TRUE;
+	  node = g_array_index (filter->parents, gint, node);
+	}
+    }
+  g_task_return_boolean (task, !g_cancellable_is_cancelled (cancellable));
+}
+
+/* Sets the visibility of rows that differ from the filter result for a
+   bounded slice of time */
+
+static gboolean
+sd_project_tree_apply_batch (gpointer user_data)
+{
+  SDProjectTree *self = SD_PROJECT_TREE (user_data);
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  gint64 start = g_get_monotonic_time ();
+  GtkTreePath *path;
+
+  while (priv->apply_pos < priv->iters->len)
+    {
+      guint i = priv->apply_pos++;
+      if (priv->visible[i] != priv->target[i])
+	{
+	  priv->visible[i] = priv->target[i];
+	  gtk_tree_store_set (priv->store,
+			      &g_array_index (priv->iters, GtkTreeIter, i),
+			      VISIBLE_COLUMN, priv->visible[i], -1);
+	}
+      if (i % SD_PROJECT_TREE_BATCH_CHECK == 0
+	  && g_get_monotonic_time () - start > SD_PROJECT_TREE_BATCH_TIME)
+	return G_SOURCE_CONTINUE;
+    }
+
+  priv->apply_id = 0;
+  if (*priv->query == '\0')
+    {
+      gtk_tree_view_collapse_all (GTK_TREE_VIEW (self));
+      path = gtk_tree_path_new_first ();
+      gtk_tree_view_expand_row (GTK_TREE_VIEW (self), path, FALSE);
+      gtk_tree_path_free (path);
+    }
+  else if (priv->matches->len <= SD_PROJECT_TREE_EXPAND_LIMIT)
+    gtk_tree_view_expand_all (GTK_TREE_VIEW (self));
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_project_tree_apply (SDProjectTree *self, gchar *query, GArray *matches,
+		       guint8 *target)
+{
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  g_free (priv->query);
+  priv->query = query;
+  if (priv->matches != NULL)
+    g_array_unref (priv->matches);
+  priv->matches = matches;
+  g_free (priv->target);
+  priv->target = target;
+  priv->apply_pos = 0;
+  if (priv->apply_id == 0)
+    priv->apply_id = g_idle_add (sd_project_tree_apply_batch, self);
+}
+
+static void
+sd_project_tree_filter_done (GObject *obj, GAsyncResult *result,
+			     gpointer user_data)
+{
+  SDProjectTreeFilter *filter = g_task_get_task_data (G_TASK (result));
+  if (!g_task_propagate_boolean (G_TASK (result), NULL))
+    return;
+  sd_project_tree_apply (SD_PROJECT_TREE (obj), g_strdup (filter->query),
+			 g_array_ref (filter->matches),
+			 g_steal_pointer (&filter->visible));
+}
+
+/* Narrows the tree to the files and directories whose path contains TEXT,
+   ignoring case, and their parent directories. Matching runs on a worker
+   thread, and when TEXT extends the previous filter only the paths it
+   matched are checked again. */
+
+void
+sd_project_tree_set_filter (SDProjectTree *self, const gchar *text)
+{
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  SDProjectTreeFilter *filter;
+  GTask *task;
+  gchar *query;
+
+  if (!priv->loaded)
+    {
+      g_free (priv->pending);
+      priv->pending = g_strdup (text);
+      return;
+    }
+  if (priv->filter_cancel != NULL)
+    {
+      g_cancellable_cancel (priv->filter_cancel);
+      g_clear_object (&priv->filter_cancel);
+    }
+
+  query = g_utf8_casefold (text, -1);
+  if (*query == '\0')
+    {
+      guint8 *target = g_malloc (priv->keys->len);
+      memset (target, TRUE, priv->keys->len);
+      sd_project_tree_apply (self, query, NULL, target);
+      return;
+    }
+
+  filter = g_malloc0 (sizeof (SDProjectTreeFilter));
+  filter->keys = g_ptr_array_ref (priv->keys);
+  filter->parents = g_array_ref (priv->parents);
+  filter->query = query;
+  if (priv->query != NULL && *priv->query != '\0'
+      && strstr (query, priv->query) != NULL)
+    filter->candidates = g_array_ref (priv->matches);
+
+  priv->filter_cancel = g_cancellable_new ();
+  task = g_task_new (self, priv->filter_cancel, sd_project_tree_filter_done,
+		     NULL);
+  g_task_set_task_data (task, filter, sd_project_tree_filter_free);
+  g_task_run_in_thread (task, sd_project_tree_filter_thread);
+  g_object_unref (task);
+}
+
+/* Adds the estimated memory use of the tree store, the path lookup table
+   and the filter index to REPORT */
+
+void
+sd_project_tree_get_memory (SDProjectTree *self, SDMemoryReport *report)
+{
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  gsize rows = g_hash_table_size (priv->rows) + 1;
+  gchar *root = g_file_get_path (priv->root);
+  gsize filter = priv->key_size + priv->keys->len * sizeof (gpointer)
+    + priv->parents->len * sizeof (gint);
+
+  if (priv->iters != NULL)
+    filter += priv->iters->len * (sizeof (GtkTreeIter) + 2);
+  if (priv->matches != NULL)
+    filter += priv->matches->len * sizeof (gint);
+
+  /* Each row has a node and a value list in the store, and a GFile with
+     its absolute path */
+  sd_memory_report_begin (report, "Project tree");
+  sd_memory_report_add (report, "Rows",
+			rows * (sizeof (GNode) + N_COLUMNS * 2 * sizeof (gpointer))
+			+ priv->display_size);
+  sd_memory_report_add (report, "Files",
+			rows * (sizeof (GObject) + sizeof (gpointer)
+				+ strlen (root) + 2) + priv->path_size);
+  sd_memory_report_add (report, "Path lookup",
+			priv->path_size
+			+ rows * (sizeof (GtkTreeIter) + 3 * sizeof (gpointer)));
+  sd_memory_report_add (report, "Filter index", filter);
+  g_free (root);
+}
+
+/* Returns the git status of the project, or NULL if it isn't in a git
+   work tree or hasn't finished loading */
+
+SDGitStatus *
+sd_project_tree_get_git_status (SDProjectTree *self)
+{
+  SDProjectTreePrivate *priv = sd_project_tree_get_instance_private (self);
+  return priv->git;
+}
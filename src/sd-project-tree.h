@@ -17,6 +17,8 @@
 #ifndef _SD_PROJECT_TREE_H
 #define _SD_PROJECT_TREE_H
 
+#include "sd-git.h"
+#include "sd-memory.h"
 #include "sd-window.h"
 
 enum
@@ -24,6 +26,7 @@ enum
   NAME_COLUMN = 0,
   FG_COLUMN,
   FILE_COLUMN,
+  VISIBLE_COLUMN,
   N_COLUMNS
 };
 
@@ -39,6 +42,15 @@ struct _SDProjectTree
 };
 
 SDProjectTree *sd_project_tree_new (SDWindow *window, GFile *file);
+void sd_project_tree_load_async (SDProjectTree *self,
+				 GAsyncReadyCallback callback,
+				 gpointer user_data);
+gboolean sd_project_tree_load_finish (SDProjectTree *self,
+				      GAsyncResult *result, GError **err);
+void sd_project_tree_set_filter (SDProjectTree *self, const gchar *text);
+void sd_project_tree_get_memory (SDProjectTree *self,
+				 SDMemoryReport *report);
+SDGitStatus *sd_project_tree_get_git_status (SDProjectTree *self);
 
 G_END_DECLS
 
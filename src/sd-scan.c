@@ -0,0 +1,118 @@
+/* sd-scan.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include "sd-git.h"
+#include "sd-ignore.h"
+#include "sd-scan.h"
+
+/* Files with a NUL byte in this many leading bytes are treated as binary */
+#define SD_SCAN_BINARY_CHECK 8000
+
+static void
+sd_scan_dir (SDIgnore *ignore, GPtrArray *files, const gchar *root,
+	     const gchar *rel, GCancellable *cancellable)
+{
+  gchar *path = g_build_filename (root, rel, NULL);
+  const gchar *name;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    {
+      g_free (path);
+      return;
+    }
+
+  /* Rules in the top-level .gitignore are loaded with the matcher */
+  if (*rel != '\0')
+    {
+      gchar *base = g_strconcat (rel, "/", NULL);
+      gchar *file = g_build_filename (path, ".gitignore", NULL);
+      sd_ignore_add_file (ignore, base, file);
+      g_free (file);
+      g_free (base);
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *child_path;
+      gchar *child_rel;
+      GStatBuf st;
+
+      if (g_cancellable_is_cancelled (cancellable))
+	break;
+      if (*rel == '\0' && strcmp (name, ".git") == 0)
+	continue;
+
+      child_path = g_build_filename (path, name, NULL);
+      child_rel = *rel == '\0' ? g_strdup (name) :
+	g_strconcat (rel, "/", name, NULL);
+
+      /* Symbolic links are not followed, so links to parent directories
+	 can't cause loops */
+      if (g_lstat (child_path, &st) == 0)
+	{
+	  if (S_ISDIR (st.st_mode))
+	    {
+	      if (!sd_ignore_match (ignore, child_rel, TRUE))
+		sd_scan_dir (ignore, files, root, child_rel, cancellable);
+	    }
+	  else if (S_ISREG (st.st_mode)
+		   && !sd_ignore_match (ignore, child_rel, FALSE))
+	    {
+	      g_ptr_array_add (files, child_rel);
+	      child_rel = NULL;
+	    }
+	}
+      g_free (child_path);
+      g_free (child_rel);
+    }
+  g_dir_close (dir);
+  g_free (path);
+}
+
+/* Lists the regular files in the project at ROOT, as paths relative to it.
+   The .git directory and files excluded by the project's ignore rules are
+   skipped. This does no I/O on the main loop and may be called from any
+   thread. */
+
+GPtrArray *
+sd_scan_files (const gchar *root, GCancellable *cancellable)
+{
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+  SDIgnore *ignore;
+  gchar *prefix = NULL;
+  gchar *gitdir = sd_git_find_gitdir (root, &prefix);
+
+  ignore = sd_ignore_new (root, gitdir, prefix);
+  g_free (gitdir);
+  g_free (prefix);
+  sd_scan_dir (ignore, files, root, "", cancellable);
+  sd_ignore_free (ignore);
+  return files;
+}
+
+/* Returns whether CONTENTS looks like text that can be searched, which
+   means it is valid UTF-8 and doesn't start with binary data */
+
+gboolean
+sd_scan_is_text (const gchar *contents, gsize len)
+{
+  return memchr (contents, '\0', MIN (len, SD_SCAN_BINARY_CHECK)) == NULL
+    && g_utf8_validate (contents, len, NULL);
+}
@@ -0,0 +1,29 @@
+/* sd-scan.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_SCAN_H
+#define _SD_SCAN_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+GPtrArray *sd_scan_files (const gchar *root, GCancellable *cancellable);
+gboolean sd_scan_is_text (const gchar *contents, gsize len);
+
+G_END_DECLS
+
+#endif
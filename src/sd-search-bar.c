@@ -0,0 +1,685 @@
+/* sd-search-bar.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-search-bar.h"
+
+/* Replace All applies replacements for at most this many microseconds
+   before letting the view redraw */
+#define SD_SEARCH_BAR_REPLACE_TIME 10000
+#define SD_SEARCH_BAR_REPLACE_CHECK 256
+
+struct _SDSearchReplacement
+{
+  gint start;
+  gint end;
+  gchar *text;
+};
+
+typedef struct _SDSearchReplacement SDSearchReplacement;
+
+/* Everything the worker thread needs to find the matches for Replace All,
+   copied from the buffer and settings when it was started */
+
+struct _SDSearchReplaceJob
+{
+  gchar *text;
+  gchar *search;
+  gchar *replace;
+  gboolean regex;
+  gboolean case_sensitive;
+};
+
+typedef struct _SDSearchReplaceJob SDSearchReplaceJob;
+
+struct _SDSearchBarPrivate
+{
+  GtkSourceView *view;
+  GtkSourceBuffer *buffer;
+  GtkSourceSearchSettings *settings;
+  GtkSourceSearchContext *context;
+  GtkWidget *search_entry;
+  GtkWidget *replace_entry;
+  GtkWidget *regex_button;
+  GtkWidget *case_button;
+  GtkWidget *count_label;
+  GtkWidget *replace_button;
+  GtkWidget *replace_all_button;
+  GCancellable *cancellable;
+  GCancellable *replace_cancellable;
+  GArray *replacements;
+  guint replace_pos;
+  guint replace_id;
+  guint generation;
+  guint replace_generation;
+  gboolean replacing;
+  gint64 replace_start;
+};
+
+typedef struct _SDSearchBarPrivate SDSearchBarPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (SDSearchBar, sd_search_bar, GTK_TYPE_SEARCH_BAR)
+
+static void sd_search_bar_replace_all_start (SDSearchBar *self);
+
+static void
+sd_search_replacement_clear (gpointer data)
+{
+  SDSearchReplacement *r = data;
+  g_free (r->text);
+}
+
+static void
+sd_search_replace_job_free (gpointer data)
+{
+  SDSearchReplaceJob *job = data;
+  g_free (job->text);
+  g_free (job->search);
+  g_free (job->replace);
+  g_free (job);
+}
+
+static void
+sd_search_bar_set_sensitive (SDSearchBar *self, gboolean sensitive)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  gtk_widget_set_sensitive (priv->replace_button, sensitive);
+  gtk_widget_set_sensitive (priv->replace_all_button, sensitive);
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (priv->view), sensitive);
+}
+
+static void
+sd_search_bar_finish_replace (SDSearchBar *self)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  if (priv->replace_id != 0)
+    {
+      g_source_remove (priv->replace_id);
+      priv->replace_id = 0;
+      gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (priv->buffer));
+    }
+  g_clear_pointer (&priv->replacements, g_array_unref);
+  priv->replacing = FALSE;
+  gtk_source_search_context_set_highlight (priv->context, TRUE);
+  sd_search_bar_set_sensitive (self, TRUE);
+}
+
+static void
+sd_search_bar_dispose (GObject *obj)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (obj);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  if (priv->cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
+    }
+  if (priv->replace_cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->replace_cancellable);
+      g_clear_object (&priv->replace_cancellable);
+    }
+  if (priv->replacing)
+    sd_search_bar_finish_replace (self);
+  g_clear_object (&priv->context);
+  g_clear_object (&priv->settings);
+  g_clear_object (&priv->view);
+  G_OBJECT_CLASS (sd_search_bar_parent_class)->dispose (obj);
+}
+
+static void
+sd_search_bar_class_init (SDSearchBarClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_search_bar_dispose;
+}
+
+static void
+sd_search_bar_update_count (SDSearchBar *self)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  const GError *err = gtk_source_search_context_get_regex_error (priv->context);
+  gint count = gtk_source_search_context_get_occurrences_count (priv->context);
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  gint pos;
+
+  if (priv->replacing)
+    return;
+  if (err != NULL)
+    {
+      gtk_label_set_text (GTK_LABEL (priv->count_label), err->message);
+      return;
+    }
+  if (gtk_source_search_settings_get_search_text (priv->settings) == NULL)
+    {
+      gtk_label_set_text (GTK_LABEL (priv->count_label), NULL);
+      return;
+    }
+
+  /* The count is -1 while the buffer is still being scanned */
+  if (count == -1)
+    {
+      gtk_label_set_text (GTK_LABEL (priv->count_label), "Searching...");
+      return;
+    }
+
+  gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (priv->buffer),
+					&start, &end);
+  pos = gtk_source_search_context_get_occurrence_position (priv->context,
+							   &start, &end);
+  if (pos > 0)
+    text = g_strdup_printf ("%d of %d", pos, count);
+  else
+    text = g_strdup_printf (count == 1 ? "%d match" : "%d matches", count);
+  gtk_label_set_text (GTK_LABEL (priv->count_label), text);
+  g_free (text);
+}
+
+static void
+sd_search_bar_count_changed (GObject *obj, GParamSpec *pspec,
+			     gpointer user_data)
+{
+  sd_search_bar_update_count (SD_SEARCH_BAR (user_data));
+}
+
+static void
+sd_search_bar_select (SDSearchBar *self, GtkTextIter *start, GtkTextIter *end)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (priv->buffer);
+  gtk_text_buffer_select_range (buffer, start, end);
+  gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (priv->view),
+				gtk_text_buffer_get_insert (buffer), 0.25,
+				FALSE, 0, 0);
+  sd_search_bar_update_count (self);
+}
+
+static void
+sd_search_bar_forward_done (GObject *obj, GAsyncResult *result,
+			    gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (user_data);
+  GtkTextIter start;
+  GtkTextIter end;
+  gboolean wrapped;
+
+  if (gtk_source_search_context_forward_finish2
+      (GTK_SOURCE_SEARCH_CONTEXT (obj), result, &start, &end, &wrapped, NULL))
+    sd_search_bar_select (self, &start, &end);
+  g_object_unref (self);
+}
+
+static void
+sd_search_bar_backward_done (GObject *obj, GAsyncResult *result,
+			     gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (user_data);
+  GtkTextIter start;
+  GtkTextIter end;
+  gboolean wrapped;
+
+  if (gtk_source_search_context_backward_finish2
+      (GTK_SOURCE_SEARCH_CONTEXT (obj), result, &start, &end, &wrapped, NULL))
+    sd_search_bar_select (self, &start, &end);
+  g_object_unref (self);
+}
+
+/* Searching is asynchronous so a search through a large buffer never
+   blocks typing. Only the most recent search is kept. */
+
+static void
+sd_search_bar_find (SDSearchBar *self, gboolean forward, gboolean from_start)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GtkTextIter start;
+  GtkTextIter end;
+
+  if (priv->cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_object_unref (priv->cancellable);
+    }
+  priv->cancellable = g_cancellable_new ();
+
+  gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (priv->buffer),
+					&start, &end);
+  if (forward)
+    gtk_source_search_context_forward_async (priv->context,
+					     from_start ? &start : &end,
+					     priv->cancellable,
+					     sd_search_bar_forward_done,
+					     g_object_ref (self));
+  else
+    gtk_source_search_context_backward_async (priv->context, &start,
+					      priv->cancellable,
+					      sd_search_bar_backward_done,
+					      g_object_ref (self));
+}
+
+static void
+sd_search_bar_search_changed (GtkSearchEntry *entry, gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (user_data);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  const gchar *text = gtk_entry_get_text (GTK_ENTRY (entry));
+
+  gtk_source_search_settings_set_search_text (priv->settings,
+					      *text == '\0' ? NULL : text);
+  if (*text != '\0')
+    sd_search_bar_find (self, TRUE, TRUE);
+  else
+    sd_search_bar_update_count (self);
+}
+
+static void
+sd_search_bar_next (GtkWidget *widget, gpointer user_data)
+{
+  sd_search_bar_find (SD_SEARCH_BAR (user_data), TRUE, FALSE);
+}
+
+static void
+sd_search_bar_previous (GtkWidget *widget, gpointer user_data)
+{
+  sd_search_bar_find (SD_SEARCH_BAR (user_data), FALSE, FALSE);
+}
+
+static void
+sd_search_bar_replace (GtkButton *button, gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (user_data);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  const gchar *replace = gtk_entry_get_text (GTK_ENTRY (priv->replace_entry));
+  GError *err = NULL;
+  GtkTextIter start;
+  GtkTextIter end;
+
+  gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (priv->buffer),
+					&start, &end);
+  if (gtk_source_search_context_get_occurrence_position (priv->context,
+							 &start, &end) > 0
+      && !gtk_source_search_context_replace2 (priv->context, &start, &end,
+					      replace, -1, &err))
+    {
+      gtk_label_set_text (GTK_LABEL (priv->count_label), err->message);
+      g_error_free (err);
+      return;
+    }
+  sd_search_bar_find (self, TRUE, FALSE);
+}
+
+static void
+sd_search_bar_replace_all (GtkButton *button, gpointer user_data)
+{
+  sd_search_bar_replace_all_start (SD_SEARCH_BAR (user_data));
+}
+
+static void
+sd_search_bar_buffer_changed (GtkTextBuffer *buffer, gpointer user_data)
+{
+  SDSearchBarPrivate *priv =
+    sd_search_bar_get_instance_private (SD_SEARCH_BAR (user_data));
+  priv->generation++;
+}
+
+static void
+sd_search_bar_mode_changed (GObject *obj, GParamSpec *pspec,
+			    gpointer user_data)
+{
+  SDSearchBarPrivate *priv =
+    sd_search_bar_get_instance_private (SD_SEARCH_BAR (obj));
+  gtk_source_search_context_set_highlight
+    (priv->context, gtk_search_bar_get_search_mode (GTK_SEARCH_BAR (obj)));
+}
+
+static void
+sd_search_bar_init (SDSearchBar *self)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GtkWidget *grid = gtk_grid_new ();
+  GtkWidget *button;
+
+  gtk_grid_set_row_spacing (GTK_GRID (grid), 6);
+  gtk_grid_set_column_spacing (GTK_GRID (grid), 6);
+
+  priv->search_entry = gtk_search_entry_new ();
+  gtk_widget_set_hexpand (priv->search_entry, TRUE);
+  gtk_grid_attach (GTK_GRID (grid), priv->search_entry, 0, 0, 1, 1);
+  button = gtk_button_new_from_icon_name ("go-up-symbolic",
+					  GTK_ICON_SIZE_BUTTON);
+  g_signal_connect (button, "clicked", G_CALLBACK (sd_search_bar_previous),
+		    self);
+  gtk_grid_attach (GTK_GRID (grid), button, 1, 0, 1, 1);
+  button = gtk_button_new_from_icon_name ("go-down-symbolic",
+					  GTK_ICON_SIZE_BUTTON);
+  g_signal_connect (button, "clicked", G_CALLBACK (sd_search_bar_next), self);
+  gtk_grid_attach (GTK_GRID (grid), button, 2, 0, 1, 1);
+  priv->case_button = gtk_check_button_new_with_mnemonic ("Match _case");
+  gtk_grid_attach (GTK_GRID (grid), priv->case_button, 3, 0, 1, 1);
+  priv->regex_button =
+    gtk_check_button_new_with_mnemonic ("Regular e_xpression");
+  gtk_grid_attach (GTK_GRID (grid), priv->regex_button, 4, 0, 1, 1);
+  priv->count_label = gtk_label_new (NULL);
+  gtk_grid_attach (GTK_GRID (grid), priv->count_label, 5, 0, 1, 1);
+
+  priv->replace_entry = gtk_entry_new ();
+  gtk_entry_set_placeholder_text (GTK_ENTRY (priv->replace_entry),
+				  "Replace with");
+  gtk_grid_attach (GTK_GRID (grid), priv->replace_entry, 0, 1, 1, 1);
+  priv->replace_button = gtk_button_new_with_mnemonic ("_Replace");
+  g_signal_connect (priv->replace_button, "clicked",
+		    G_CALLBACK (sd_search_bar_replace), self);
+  gtk_grid_attach (GTK_GRID (grid), priv->replace_button, 1, 1, 2, 1);
+  priv->replace_all_button = gtk_button_new_with_mnemonic ("Replace _All");
+  g_signal_connect (priv->replace_all_button, "clicked",
+		    G_CALLBACK (sd_search_bar_replace_all), self);
+  gtk_grid_attach (GTK_GRID (grid), priv->replace_all_button, 3, 1, 1, 1);
+
+  gtk_container_add (GTK_CONTAINER (self), grid);
+  gtk_search_bar_connect_entry (GTK_SEARCH_BAR (self),
+				GTK_ENTRY (priv->search_entry));
+  gtk_search_bar_set_show_close_button (GTK_SEARCH_BAR (self), TRUE);
+
+  g_signal_connect (priv->search_entry, "search-changed",
+		    G_CALLBACK (sd_search_bar_search_changed), self);
+  g_signal_connect (priv->search_entry, "activate",
+		    G_CALLBACK (sd_search_bar_next), self);
+  g_signal_connect (priv->search_entry, "next-match",
+		    G_CALLBACK (sd_search_bar_next), self);
+  g_signal_connect (priv->search_entry, "previous-match",
+		    G_CALLBACK (sd_search_bar_previous), self);
+  g_signal_connect (self, "notify::search-mode-enabled",
+		    G_CALLBACK (sd_search_bar_mode_changed), NULL);
+}
+
+/* Finds every match for Replace All on a worker thread. Match positions
+   are converted to character offsets as the text is scanned, and regular
+   expression references in the replacement are expanded here too. */
+
+static void
+sd_search_bar_replace_thread (GTask *task, gpointer source_object,
+			      gpointer task_data, GCancellable *cancellable)
+{
+  SDSearchReplaceJob *job = task_data;
+  GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+  GError *err = NULL;
+  GMatchInfo *info;
+  GRegex *regex;
+  GArray *replacements;
+  gchar *pattern;
+  gint last_byte = 0;
+  gint last_offset = 0;
+
+  if (!job->case_sensitive)
+    flags |= G_REGEX_CASELESS;
+  pattern = job->regex ? g_strdup (job->search) :
+    g_regex_escape_string (job->search, -1);
+  regex = g_regex_new (pattern, flags, 0, &err);
+  g_free (pattern);
+  if (regex == NULL)
+    {
+      g_task_return_error (task, err);
+      return;
+    }
+
+  replacements = g_array_new (FALSE, FALSE, sizeof (SDSearchReplacement));
+  g_array_set_clear_func (replacements, sd_search_replacement_clear);
+  g_regex_match (regex, job->text, 0, &info);
+  while (g_match_info_matches (info))
+    {
+      SDSearchReplacement r;
+      gint start;
+      gint end;
+
+      if (g_cancellable_is_cancelled (cancellable))
+	break;
+      g_match_info_fetch_pos (info, 0, &start, &end);
+      r.start = last_offset + g_utf8_strlen (job->text + last_byte,
+					     start - last_byte);
+      r.end = r.start + g_utf8_strlen (job->text + start, end - start);
+      last_byte = end;
+      last_offset = r.end;
+      if (job->regex)
+	r.text = g_match_info_expand_references (info, job->replace, NULL);
+      else
+	r.text = g_strdup (job->replace);
+      if (r.text == NULL)
+	r.text = g_strdup ("");
+      g_array_append_val (replacements, r);
+      g_match_info_next (info, NULL);
+    }
+  g_match_info_free (info);
+  g_regex_unref (regex);
+
+  if (g_task_return_error_if_cancelled (task))
+    g_array_unref (replacements);
+  else
+    g_task_return_pointer (task, replacements,
+			   (GDestroyNotify) g_array_unref);
+}
+
+/* Applies replacements from the end of the buffer backwards, so the
+   offsets of the remaining matches stay valid. The whole operation is a
+   single user action, so it is undone in one step. */
+
+static gboolean
+sd_search_bar_replace_batch (gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (user_data);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (priv->buffer);
+  gint64 start = g_get_monotonic_time ();
+  guint total = priv->replacements->len;
+  gchar *text;
+
+  /* Replacements are only applied through the view being searched, but
+     the buffer may also be edited from another view of it */
+  if (priv->generation != priv->replace_generation)
+    {
+      priv->replace_id = 0;
+      gtk_text_buffer_end_user_action (buffer);
+      sd_search_bar_finish_replace (self);
+      gtk_label_set_text (GTK_LABEL (priv->count_label),
+			  "Replace All stopped by an edit");
+      return G_SOURCE_REMOVE;
+    }
+
+  while (priv->replace_pos > 0)
+    {
+      SDSearchReplacement *r =
+	&g_array_index (priv->replacements, SDSearchReplacement,
+			--priv->replace_pos);
+      GtkTextIter iter;
+      GtkTextIter end;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, r->start);
+      gtk_text_buffer_get_iter_at_offset (buffer, &end, r->end);
+      gtk_text_buffer_delete (buffer, &iter, &end);
+      gtk_text_buffer_insert (buffer, &iter, r->text, -1);
+
+      if (priv->replace_pos % SD_SEARCH_BAR_REPLACE_CHECK == 0
+	  && g_get_monotonic_time () - start > SD_SEARCH_BAR_REPLACE_TIME)
+	{
+	  priv->replace_generation = priv->generation;
+	  return G_SOURCE_CONTINUE;
+	}
+    }
+
+  g_debug ("Replaced %u occurrences in %.1f ms", total,
+	   (g_get_monotonic_time () - priv->replace_start) / 1000.0);
+  priv->replace_id = 0;
+  gtk_text_buffer_end_user_action (buffer);
+  sd_search_bar_finish_replace (self);
+  text = g_strdup_printf (total == 1 ? "Replaced %u occurrence" :
+			  "Replaced %u occurrences", total);
+  gtk_label_set_text (GTK_LABEL (priv->count_label), text);
+  g_free (text);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+sd_search_bar_replace_all_done (GObject *obj, GAsyncResult *result,
+				gpointer user_data)
+{
+  SDSearchBar *self = SD_SEARCH_BAR (obj);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GError *err = NULL;
+  GArray *replacements = g_task_propagate_pointer (G_TASK (result), &err);
+
+  /* Results of a replacement that was superseded, or of a search bar that
+     was disposed, are dropped */
+  if (g_task_get_cancellable (G_TASK (result)) != priv->replace_cancellable
+      || !priv->replacing)
+    {
+      if (replacements != NULL)
+	g_array_unref (replacements);
+      g_clear_error (&err);
+      return;
+    }
+  if (replacements == NULL)
+    {
+      sd_search_bar_finish_replace (self);
+      gtk_label_set_text (GTK_LABEL (priv->count_label), err->message);
+      g_error_free (err);
+      return;
+    }
+
+  /* The buffer was changed programmatically while matches were being
+     found, so the offsets may be wrong */
+  if (priv->generation != priv->replace_generation)
+    {
+      g_array_unref (replacements);
+      sd_search_bar_finish_replace (self);
+      sd_search_bar_replace_all_start (self);
+      return;
+    }
+
+  priv->replacements = replacements;
+  priv->replace_pos = replacements->len;
+  gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (priv->buffer));
+  priv->replace_id = g_idle_add (sd_search_bar_replace_batch, self);
+}
+
+static void
+sd_search_bar_replace_all_start (SDSearchBar *self)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  const gchar *search =
+    gtk_source_search_settings_get_search_text (priv->settings);
+  SDSearchReplaceJob *job;
+  GtkTextIter start;
+  GtkTextIter end;
+  GTask *task;
+
+  if (search == NULL || priv->replacing)
+    return;
+
+  /* Editing is disabled until the replacement is finished */
+  priv->replacing = TRUE;
+  priv->replace_start = g_get_monotonic_time ();
+  priv->replace_generation = priv->generation;
+  sd_search_bar_set_sensitive (self, FALSE);
+  gtk_source_search_context_set_highlight (priv->context, FALSE);
+  gtk_label_set_text (GTK_LABEL (priv->count_label), "Replacing...");
+
+  job = g_malloc (sizeof (SDSearchReplaceJob));
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (priv->buffer), &start, &end);
+  job->text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (priv->buffer),
+					&start, &end, TRUE);
+  job->search = g_strdup (search);
+  job->replace =
+    g_strdup (gtk_entry_get_text (GTK_ENTRY (priv->replace_entry)));
+  job->regex = gtk_source_search_settings_get_regex_enabled (priv->settings);
+  job->case_sensitive =
+    gtk_source_search_settings_get_case_sensitive (priv->settings);
+
+  /* Searches cancel their own cancellable whenever the query changes, so
+     Replace All has a separate one */
+  g_clear_object (&priv->replace_cancellable);
+  priv->replace_cancellable = g_cancellable_new ();
+  task = g_task_new (self, priv->replace_cancellable,
+		     sd_search_bar_replace_all_done, NULL);
+  g_task_set_task_data (task, job, sd_search_replace_job_free);
+  g_task_run_in_thread (task, sd_search_bar_replace_thread);
+  g_object_unref (task);
+}
+
+SDSearchBar *
+sd_search_bar_new (GtkSourceView *view)
+{
+  SDSearchBar *bar = g_object_new (SD_TYPE_SEARCH_BAR, NULL);
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (bar);
+
+  priv->view = g_object_ref (view);
+  priv->buffer =
+    GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+  priv->settings = gtk_source_search_settings_new ();
+  gtk_source_search_settings_set_wrap_around (priv->settings, TRUE);
+  g_object_bind_property (priv->case_button, "active", priv->settings,
+			  "case-sensitive", G_BINDING_SYNC_CREATE);
+  g_object_bind_property (priv->regex_button, "active", priv->settings,
+			  "regex-enabled", G_BINDING_SYNC_CREATE);
+
+  /* The search context counts matches in the background, in chunks run
+     from the main loop, and notifies when the total is known */
+  priv->context = gtk_source_search_context_new (priv->buffer,
+						 priv->settings);
+  gtk_source_search_context_set_highlight (priv->context, FALSE);
+  g_signal_connect (priv->context, "notify::occurrences-count",
+		    G_CALLBACK (sd_search_bar_count_changed), bar);
+  g_signal_connect_object (priv->buffer, "changed",
+			   G_CALLBACK (sd_search_bar_buffer_changed), bar, 0);
+  return bar;
+}
+
+/* Changes the view that matches are selected and scrolled to in, for
+   buffers with more than one view */
+
+void
+sd_search_bar_set_view (SDSearchBar *self, GtkSourceView *view)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  g_return_if_fail (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view))
+		    == GTK_TEXT_BUFFER (priv->buffer));
+  if (priv->view == view)
+    return;
+  if (priv->replacing)
+    {
+      gtk_text_view_set_editable (GTK_TEXT_VIEW (priv->view), TRUE);
+      gtk_text_view_set_editable (GTK_TEXT_VIEW (view), FALSE);
+    }
+  g_object_unref (priv->view);
+  priv->view = g_object_ref (view);
+}
+
+void
+sd_search_bar_start (SDSearchBar *self)
+{
+  SDSearchBarPrivate *priv = sd_search_bar_get_instance_private (self);
+  GtkTextIter start;
+  GtkTextIter end;
+
+  /* Search for the selected text, if it is on a single line */
+  if (gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (priv->buffer),
+					    &start, &end)
+      && gtk_text_iter_get_line (&start) == gtk_text_iter_get_line (&end))
+    {
+      gchar *text = gtk_text_iter_get_text (&start, &end);
+      gtk_entry_set_text (GTK_ENTRY (priv->search_entry), text);
+      g_free (text);
+    }
+  gtk_search_bar_set_search_mode (GTK_SEARCH_BAR (self), TRUE);
+  gtk_widget_grab_focus (priv->search_entry);
+}
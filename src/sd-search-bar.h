@@ -0,0 +1,39 @@
+/* sd-search-bar.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_SEARCH_BAR_H
+#define _SD_SEARCH_BAR_H
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_SEARCH_BAR sd_search_bar_get_type ()
+G_DECLARE_FINAL_TYPE (SDSearchBar, sd_search_bar, SD, SEARCH_BAR,
+		      GtkSearchBar)
+
+struct _SDSearchBar
+{
+  GtkSearchBar parent;
+};
+
+SDSearchBar *sd_search_bar_new (GtkSourceView *view);
+void sd_search_bar_set_view (SDSearchBar *self, GtkSourceView *view);
+void sd_search_bar_start (SDSearchBar *self);
+
+G_END_DECLS
+
+#endif
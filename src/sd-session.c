@@ -0,0 +1,85 @@
+/* sd-session.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sd-session.h"
+
+/* The files open in each project are kept in a key file in the user cache
+   directory, with one group per project */
+
+#define SD_SESSION_FILE "session.ini"
+
+static gchar *
+sd_session_get_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "simpledevelop",
+			   SD_SESSION_FILE, NULL);
+}
+
+/* Returns the URIs of the files that were open in the project at ROOT, or
+   NULL if there is no saved session */
+
+gchar **
+sd_session_load (GFile *root, gint *current)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gchar *path = sd_session_get_path ();
+  gchar *group = g_file_get_uri (root);
+  gchar **uris = NULL;
+
+  *current = 0;
+  if (g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+    {
+      uris = g_key_file_get_string_list (keyfile, group, "files", NULL, NULL);
+      *current = g_key_file_get_integer (keyfile, group, "current", NULL);
+    }
+  g_key_file_free (keyfile);
+  g_free (group);
+  g_free (path);
+  return uris;
+}
+
+void
+sd_session_save (GFile *root, GPtrArray *files, gint current)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  GError *err = NULL;
+  gchar *path = sd_session_get_path ();
+  gchar *dir = g_path_get_dirname (path);
+  gchar *group = g_file_get_uri (root);
+  gchar **uris;
+  guint i;
+
+  g_key_file_load_from_file (keyfile, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+  uris = g_new (gchar *, files->len + 1);
+  for (i = 0; i < files->len; i++)
+    uris[i] = g_file_get_uri (g_ptr_array_index (files, i));
+  uris[files->len] = NULL;
+  g_key_file_set_string_list (keyfile, group, "files",
+			      (const gchar * const *) uris, files->len);
+  g_key_file_set_integer (keyfile, group, "current", current);
+  g_strfreev (uris);
+
+  g_mkdir_with_parents (dir, 0755);
+  if (!g_key_file_save_to_file (keyfile, path, &err))
+    {
+      g_warning ("Failed to save session to %s: %s", path, err->message);
+      g_error_free (err);
+    }
+  g_key_file_free (keyfile);
+  g_free (group);
+  g_free (dir);
+  g_free (path);
+}
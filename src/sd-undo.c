@@ -0,0 +1,740 @@
+/* sd-undo.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "sd-undo.h"
+
+/* An inserted or deleted range of text. Records made by the same user
+   action share a group and are undone together. Runs of single
+   characters typed one after another are merged into one record, which
+   is extended until a new word or line is started. */
+
+struct _SDUndoRecord
+{
+  guint group;
+  gint offset;
+  gint chars;
+  gboolean insert;
+  gboolean run;
+  gsize len;
+  gchar *text;
+};
+
+typedef struct _SDUndoRecord SDUndoRecord;
+
+/* Records before POS have been applied to the buffer and can be undone,
+   the rest can be redone. SAVED is the position the buffer was last
+   saved at, or -1 if that position is no longer in the history. While
+   the tab is inactive the records may be SWAPPED out to SWAP_PATH. The
+   file is kept after they are read back until the records change, so a
+   tab switched away from again without being edited isn't written
+   twice. */
+
+struct _SDUndoPrivate
+{
+  GtkTextBuffer *buffer;
+  GSettings *settings;
+  GPtrArray *records;
+  guint pos;
+  gint saved;
+  guint groups;
+  gsize size;
+  guint group;
+  guint next_group;
+  guint group_records;
+  gboolean user_action;
+  gint not_undoable;
+  gboolean applying;
+  gchar *swap_path;
+  gboolean swapped;
+  gboolean can_undo;
+  gboolean can_redo;
+};
+
+typedef struct _SDUndoPrivate SDUndoPrivate;
+
+static void sd_undo_iface_init (GtkSourceUndoManagerIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (SDUndo, sd_undo, G_TYPE_OBJECT,
+			 G_ADD_PRIVATE (SDUndo)
+			 G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_UNDO_MANAGER,
+						sd_undo_iface_init))
+
+static void
+sd_undo_record_free (gpointer data)
+{
+  SDUndoRecord *record = data;
+  g_free (record->text);
+  g_free (record);
+}
+
+static gsize
+sd_undo_record_size (SDUndoRecord *record)
+{
+  return sizeof (SDUndoRecord) + sizeof (gpointer) + record->len + 1;
+}
+
+static SDUndoRecord *
+sd_undo_get_record (SDUndoPrivate *priv, guint i)
+{
+  return g_ptr_array_index (priv->records, i);
+}
+
+static void
+sd_undo_update_state (SDUndo *self)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  gboolean can_undo = priv->pos > 0;
+  gboolean can_redo = priv->pos < priv->records->len;
+
+  if (can_undo != priv->can_undo)
+    {
+      priv->can_undo = can_undo;
+      gtk_source_undo_manager_can_undo_changed (GTK_SOURCE_UNDO_MANAGER
+						(self));
+    }
+  if (can_redo != priv->can_redo)
+    {
+      priv->can_redo = can_redo;
+      gtk_source_undo_manager_can_redo_changed (GTK_SOURCE_UNDO_MANAGER
+						(self));
+    }
+}
+
+/* Deletes the copy of the records on disk once they no longer match */
+
+static void
+sd_undo_drop_swap (SDUndoPrivate *priv)
+{
+  if (priv->swap_path != NULL)
+    {
+      g_unlink (priv->swap_path);
+      g_clear_pointer (&priv->swap_path, g_free);
+    }
+}
+
+/* Removes the records from START to END, which must be whole groups */
+
+static void
+sd_undo_remove_range (SDUndoPrivate *priv, guint start, guint end)
+{
+  guint i;
+
+  sd_undo_drop_swap (priv);
+  for (i = start; i < end; i++)
+    {
+      SDUndoRecord *record = sd_undo_get_record (priv, i);
+      if (i == start
+	  || record->group != sd_undo_get_record (priv, i - 1)->group)
+	priv->groups--;
+      priv->size -= sd_undo_record_size (record);
+    }
+  g_ptr_array_remove_range (priv->records, start, end - start);
+}
+
+static void
+sd_undo_clear (SDUndoPrivate *priv)
+{
+  sd_undo_drop_swap (priv);
+  priv->swapped = FALSE;
+  g_ptr_array_set_size (priv->records, 0);
+  priv->pos = 0;
+  priv->groups = 0;
+  priv->size = 0;
+}
+
+/* Drops the oldest groups until the history is within the undo limit and
+   memory budget. Records that can be redone are kept. */
+
+static void
+sd_undo_trim (SDUndoPrivate *priv)
+{
+  gint limit = g_settings_get_int (priv->settings, "undo-limit");
+  gsize budget =
+    (gsize) g_settings_get_uint (priv->settings, "undo-memory-limit") * 1024;
+
+  while (priv->pos > 0
+	 && ((limit >= 0 && priv->groups > (guint) limit)
+	     || (budget > 0 && priv->size > budget)))
+    {
+      guint group = sd_undo_get_record (priv, 0)->group;
+      guint end = 1;
+      while (end < priv->pos && sd_undo_get_record (priv, end)->group == group)
+	end++;
+      sd_undo_remove_range (priv, 0, end);
+      priv->pos -= end;
+      if (priv->saved != -1)
+	priv->saved = priv->saved >= (gint) end ? priv->saved - end : -1;
+    }
+}
+
+/* Reads back the history of a tab that was written to disk */
+
+static void
+sd_undo_load (SDUndo *self)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  GError *err = NULL;
+  gchar *contents;
+  gsize len;
+  const gchar *ptr;
+  const gchar *end;
+  const gsize header =
+    sizeof (guint) + 2 * sizeof (gint) + sizeof (gsize) + 1;
+
+  if (!priv->swapped)
+    return;
+  if (!g_file_get_contents (priv->swap_path, &contents, &len, &err))
+    {
+      g_warning ("Failed to read undo history: %s", err->message);
+      g_error_free (err);
+      sd_undo_clear (priv);
+      priv->saved = -1;
+      sd_undo_update_state (self);
+      return;
+    }
+  priv->swapped = FALSE;
+
+  /* Each record is a header holding the group, offset, character count,
+     text length and a byte of flags, followed by its text. A swap file
+     that was only partly written, such as when the disk filled up, can't
+     be trusted, so the history is dropped. */
+  ptr = contents;
+  end = contents + len;
+  while (ptr < end)
+    {
+      SDUndoRecord *record;
+      guint8 flags;
+      gsize text_len;
+
+      if ((gsize) (end - ptr) < header)
+	goto corrupt;
+      memcpy (&text_len, ptr + sizeof (guint) + 2 * sizeof (gint),
+	      sizeof (gsize));
+      if (text_len > (gsize) (end - ptr) - header)
+	goto corrupt;
+
+      record = g_malloc (sizeof (SDUndoRecord));
+      memcpy (&record->group, ptr, sizeof (guint));
+      ptr += sizeof (guint);
+      memcpy (&record->offset, ptr, sizeof (gint));
+      ptr += sizeof (gint);
+      memcpy (&record->chars, ptr, sizeof (gint));
+      ptr += sizeof (gint);
+      memcpy (&record->len, ptr, sizeof (gsize));
+      ptr += sizeof (gsize);
+      flags = *ptr++;
+      record->insert = flags & 1;
+      record->run = (flags & 2) != 0;
+      record->text = g_strndup (ptr, record->len);
+      ptr += record->len;
+      g_ptr_array_add (priv->records, record);
+      priv->size += sd_undo_record_size (record);
+    }
+  if (priv->records->len < priv->pos)
+    goto corrupt;
+  g_free (contents);
+  sd_undo_trim (priv);
+  sd_undo_update_state (self);
+  return;
+
+ corrupt:
+  g_warning ("Undo history is corrupt and was discarded");
+  g_free (contents);
+  sd_undo_clear (priv);
+  priv->saved = -1;
+  sd_undo_update_state (self);
+}
+
+/* Adds a record for a change made to the buffer, discarding any records
+   that could have been redone */
+
+static void
+sd_undo_add (SDUndo *self, SDUndoRecord *record)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+
+  if (priv->pos < priv->records->len)
+    {
+      if (priv->saved > (gint) priv->pos)
+	priv->saved = -1;
+      sd_undo_remove_range (priv, priv->pos, priv->records->len);
+    }
+  record->group = priv->group;
+  if (priv->records->len == 0
+      || sd_undo_get_record (priv, priv->records->len - 1)->group !=
+      record->group)
+    priv->groups++;
+  sd_undo_drop_swap (priv);
+  g_ptr_array_add (priv->records, record);
+  priv->size += sd_undo_record_size (record);
+  priv->pos++;
+  priv->group_records++;
+  sd_undo_trim (priv);
+  sd_undo_update_state (self);
+}
+
+/* Changes made outside of a user action are each undone separately */
+
+static gboolean
+sd_undo_begin_change (SDUndo *self)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  if (priv->applying || priv->not_undoable > 0)
+    return FALSE;
+  sd_undo_load (self);
+  if (!priv->user_action)
+    {
+      priv->group = ++priv->next_group;
+      priv->group_records = 0;
+    }
+  return TRUE;
+}
+
+/* Extends the last record with a typed character if it is part of the same
+   run of typing */
+
+static gboolean
+sd_undo_merge (SDUndoPrivate *priv, gint offset, const gchar *text,
+	       gint len)
+{
+  SDUndoRecord *last;
+  gunichar c = g_utf8_get_char (text);
+  gunichar prev;
+
+  if (priv->pos == 0 || priv->pos < priv->records->len
+      || priv->saved == (gint) priv->pos || priv->group_records > 0)
+    return FALSE;
+  last = sd_undo_get_record (priv, priv->pos - 1);
+  if (!last->insert || !last->run || last->offset + last->chars != offset)
+    return FALSE;
+  prev = g_utf8_get_char (g_utf8_prev_char (last->text + last->len));
+  if (g_unichar_isspace (prev) && !g_unichar_isspace (c))
+    return FALSE;
+
+  sd_undo_drop_swap (priv);
+  last->text = g_realloc (last->text, last->len + len + 1);
+  memcpy (last->text + last->len, text, len);
+  last->len += len;
+  last->text[last->len] = '\0';
+  last->chars++;
+  priv->size += len;
+  priv->group = last->group;
+  priv->group_records++;
+  return TRUE;
+}
+
+static void
+sd_undo_insert_text (GtkTextBuffer *buffer, GtkTextIter *location,
+		     gchar *text, gint len, gpointer user_data)
+{
+  SDUndo *self = SD_UNDO (user_data);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  SDUndoRecord *record;
+  gint offset = gtk_text_iter_get_offset (location);
+  gint chars = g_utf8_strlen (text, len);
+  gboolean run = chars == 1 && *text != '\n' && *text != '\r';
+
+  if (!sd_undo_begin_change (self))
+    return;
+  if (run && sd_undo_merge (priv, offset, text, len))
+    {
+      sd_undo_trim (priv);
+      sd_undo_update_state (self);
+      return;
+    }
+
+  record = g_malloc (sizeof (SDUndoRecord));
+  record->offset = offset;
+  record->chars = chars;
+  record->insert = TRUE;
+  record->run = run;
+  record->len = len;
+  record->text = g_strndup (text, len);
+  sd_undo_add (self, record);
+}
+
+static void
+sd_undo_delete_range (GtkTextBuffer *buffer, GtkTextIter *start,
+		      GtkTextIter *end, gpointer user_data)
+{
+  SDUndo *self = SD_UNDO (user_data);
+  SDUndoRecord *record;
+
+  if (!sd_undo_begin_change (self))
+    return;
+  record = g_malloc (sizeof (SDUndoRecord));
+  record->offset = gtk_text_iter_get_offset (start);
+  record->chars = gtk_text_iter_get_offset (end) - record->offset;
+  record->insert = FALSE;
+  record->run = FALSE;
+  record->text = gtk_text_buffer_get_slice (buffer, start, end, TRUE);
+  record->len = strlen (record->text);
+  sd_undo_add (self, record);
+}
+
+static void
+sd_undo_begin_user_action (GtkTextBuffer *buffer, gpointer user_data)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (user_data));
+  if (priv->applying)
+    return;
+  priv->user_action = TRUE;
+  priv->group = ++priv->next_group;
+  priv->group_records = 0;
+}
+
+static void
+sd_undo_end_user_action (GtkTextBuffer *buffer, gpointer user_data)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (user_data));
+  priv->user_action = FALSE;
+}
+
+static void
+sd_undo_modified_changed (GtkTextBuffer *buffer, gpointer user_data)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (user_data));
+  if (!priv->applying && !gtk_text_buffer_get_modified (buffer))
+    priv->saved = priv->pos;
+}
+
+static void
+sd_undo_settings_changed (GSettings *settings, gchar *key, gpointer user_data)
+{
+  SDUndo *self = SD_UNDO (user_data);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  if (priv->swapped)
+    return;
+  sd_undo_trim (priv);
+  sd_undo_update_state (self);
+}
+
+/* Applies or reverts RECORD and returns the offset to place the cursor */
+
+static gint
+sd_undo_apply (SDUndoPrivate *priv, SDUndoRecord *record, gboolean insert)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+
+  gtk_text_buffer_get_iter_at_offset (priv->buffer, &start, record->offset);
+  if (insert)
+    {
+      gtk_text_buffer_insert (priv->buffer, &start, record->text, record->len);
+      return record->offset + record->chars;
+    }
+  gtk_text_buffer_get_iter_at_offset (priv->buffer, &end,
+				      record->offset + record->chars);
+  gtk_text_buffer_delete (priv->buffer, &start, &end);
+  return record->offset;
+}
+
+static void
+sd_undo_finish_apply (SDUndo *self, gint offset)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  GtkTextIter iter;
+
+  gtk_text_buffer_end_user_action (priv->buffer);
+  priv->applying = FALSE;
+  gtk_text_buffer_get_iter_at_offset (priv->buffer, &iter, offset);
+  gtk_text_buffer_place_cursor (priv->buffer, &iter);
+  gtk_text_buffer_set_modified (priv->buffer,
+				priv->saved != (gint) priv->pos);
+  sd_undo_update_state (self);
+}
+
+static gboolean
+sd_undo_can_undo (GtkSourceUndoManager *manager)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (manager));
+  return priv->can_undo;
+}
+
+static gboolean
+sd_undo_can_redo (GtkSourceUndoManager *manager)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (manager));
+  return priv->can_redo;
+}
+
+static void
+sd_undo_undo (GtkSourceUndoManager *manager)
+{
+  SDUndo *self = SD_UNDO (manager);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  guint group;
+  gint offset = 0;
+
+  sd_undo_load (self);
+  if (priv->pos == 0 || priv->buffer == NULL)
+    return;
+  priv->applying = TRUE;
+  gtk_text_buffer_begin_user_action (priv->buffer);
+  group = sd_undo_get_record (priv, priv->pos - 1)->group;
+  while (priv->pos > 0
+	 && sd_undo_get_record (priv, priv->pos - 1)->group == group)
+    {
+      SDUndoRecord *record = sd_undo_get_record (priv, --priv->pos);
+      sd_undo_apply (priv, record, !record->insert);
+      offset = record->offset;
+    }
+  sd_undo_finish_apply (self, offset);
+}
+
+static void
+sd_undo_redo (GtkSourceUndoManager *manager)
+{
+  SDUndo *self = SD_UNDO (manager);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  guint group;
+  gint offset = 0;
+
+  sd_undo_load (self);
+  if (priv->pos == priv->records->len || priv->buffer == NULL)
+    return;
+  priv->applying = TRUE;
+  gtk_text_buffer_begin_user_action (priv->buffer);
+  group = sd_undo_get_record (priv, priv->pos)->group;
+  while (priv->pos < priv->records->len
+	 && sd_undo_get_record (priv, priv->pos)->group == group)
+    {
+      SDUndoRecord *record = sd_undo_get_record (priv, priv->pos++);
+      offset = sd_undo_apply (priv, record, record->insert);
+    }
+  sd_undo_finish_apply (self, offset);
+}
+
+static void
+sd_undo_begin_not_undoable_action (GtkSourceUndoManager *manager)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (manager));
+  priv->not_undoable++;
+}
+
+/* Changes that can't be undone invalidate the whole history */
+
+static void
+sd_undo_end_not_undoable_action (GtkSourceUndoManager *manager)
+{
+  SDUndo *self = SD_UNDO (manager);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+
+  g_return_if_fail (priv->not_undoable > 0);
+  if (--priv->not_undoable > 0)
+    return;
+  sd_undo_clear (priv);
+  priv->saved = priv->buffer != NULL
+    && gtk_text_buffer_get_modified (priv->buffer) ? -1 : 0;
+  sd_undo_update_state (self);
+}
+
+static void
+sd_undo_dispose (GObject *obj)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (obj));
+  if (priv->buffer != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->buffer, obj);
+      g_object_remove_weak_pointer (G_OBJECT (priv->buffer),
+				    (gpointer *) &priv->buffer);
+      priv->buffer = NULL;
+    }
+  g_clear_object (&priv->settings);
+  G_OBJECT_CLASS (sd_undo_parent_class)->dispose (obj);
+}
+
+static void
+sd_undo_finalize (GObject *obj)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (SD_UNDO (obj));
+  sd_undo_clear (priv);
+  g_ptr_array_unref (priv->records);
+  G_OBJECT_CLASS (sd_undo_parent_class)->finalize (obj);
+}
+
+static void
+sd_undo_init (SDUndo *self)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  priv->records = g_ptr_array_new_with_free_func (sd_undo_record_free);
+}
+
+static void
+sd_undo_iface_init (GtkSourceUndoManagerIface *iface)
+{
+  iface->can_undo = sd_undo_can_undo;
+  iface->can_redo = sd_undo_can_redo;
+  iface->undo = sd_undo_undo;
+  iface->redo = sd_undo_redo;
+  iface->begin_not_undoable_action = sd_undo_begin_not_undoable_action;
+  iface->end_not_undoable_action = sd_undo_end_not_undoable_action;
+}
+
+static void
+sd_undo_class_init (SDUndoClass *klass)
+{
+  G_OBJECT_CLASS (klass)->dispose = sd_undo_dispose;
+  G_OBJECT_CLASS (klass)->finalize = sd_undo_finalize;
+}
+
+/* Creates an undo manager for BUFFER with a history bounded by the
+   undo-limit and undo-memory-limit settings. It is owned by the buffer
+   once set with gtk_source_buffer_set_undo_manager. */
+
+SDUndo *
+sd_undo_new (GtkTextBuffer *buffer, GSettings *settings)
+{
+  SDUndo *self = g_object_new (SD_TYPE_UNDO, NULL);
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+
+  priv->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer *) &priv->buffer);
+  priv->settings = g_object_ref (settings);
+  priv->saved = gtk_text_buffer_get_modified (buffer) ? -1 : 0;
+  g_signal_connect (buffer, "insert-text", G_CALLBACK (sd_undo_insert_text),
+		    self);
+  g_signal_connect (buffer, "delete-range", G_CALLBACK (sd_undo_delete_range),
+		    self);
+  g_signal_connect (buffer, "begin-user-action",
+		    G_CALLBACK (sd_undo_begin_user_action), self);
+  g_signal_connect (buffer, "end-user-action",
+		    G_CALLBACK (sd_undo_end_user_action), self);
+  g_signal_connect (buffer, "modified-changed",
+		    G_CALLBACK (sd_undo_modified_changed), self);
+  g_signal_connect_object (settings, "changed::undo-limit",
+			   G_CALLBACK (sd_undo_settings_changed), self, 0);
+  g_signal_connect_object (settings, "changed::undo-memory-limit",
+			   G_CALLBACK (sd_undo_settings_changed), self, 0);
+  return self;
+}
+
+/* Writes DATA to the swap file open on FD and closes it */
+
+static gboolean
+sd_undo_write_swap (gint fd, const gchar *path, GByteArray *data,
+		    GError **err)
+{
+  const guint8 *ptr = data->data;
+  gsize len = data->len;
+  gint saved_errno;
+
+  while (len > 0)
+    {
+      gssize ret = write (fd, ptr, len);
+      if (ret == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  goto error;
+	}
+      ptr += ret;
+      len -= ret;
+    }
+  if (fsync (fd) == -1 && errno != EINVAL)
+    goto error;
+  if (close (fd) == -1)
+    {
+      fd = -1;
+      goto error;
+    }
+  return TRUE;
+
+ error:
+  saved_errno = errno;
+  if (fd != -1)
+    close (fd);
+  g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+	       "Failed to write %s: %s", path, g_strerror (saved_errno));
+  return FALSE;
+}
+
+/* Frees the history after writing it to a temporary file, or reads it
+   back. The history is also read back as soon as the buffer changes. */
+
+void
+sd_undo_set_swapped (SDUndo *self, gboolean swapped)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  GError *err = NULL;
+  GByteArray *data;
+  gchar *path = NULL;
+  guint pos;
+  guint groups;
+  gint fd;
+  guint i;
+
+  if (!swapped)
+    {
+      sd_undo_load (self);
+      return;
+    }
+  if (priv->swapped || priv->records->len == 0)
+    return;
+  if (priv->swap_path != NULL)
+    goto done;
+
+  data = g_byte_array_new ();
+  for (i = 0; i < priv->records->len; i++)
+    {
+      SDUndoRecord *record = sd_undo_get_record (priv, i);
+      guint8 flags = (record->insert ? 1 : 0) | (record->run ? 2 : 0);
+      g_byte_array_append (data, (guint8 *) &record->group, sizeof (guint));
+      g_byte_array_append (data, (guint8 *) &record->offset, sizeof (gint));
+      g_byte_array_append (data, (guint8 *) &record->chars, sizeof (gint));
+      g_byte_array_append (data, (guint8 *) &record->len, sizeof (gsize));
+      g_byte_array_append (data, &flags, 1);
+      g_byte_array_append (data, (guint8 *) record->text, record->len);
+    }
+
+  /* The file is written through the descriptor it was created with, so
+     it is never readable by other users */
+  fd = g_file_open_tmp ("simpledevelop-undo-XXXXXX", &path, &err);
+  if (fd != -1 && !sd_undo_write_swap (fd, path, data, &err))
+    g_unlink (path);
+  g_byte_array_unref (data);
+  if (err != NULL)
+    {
+      g_warning ("Failed to write undo history: %s", err->message);
+      g_error_free (err);
+      g_free (path);
+      return;
+    }
+  priv->swap_path = path;
+
+ done:
+  /* The position is kept so the buffer can still be undone */
+  pos = priv->pos;
+  groups = priv->groups;
+  g_ptr_array_set_size (priv->records, 0);
+  priv->size = 0;
+  priv->groups = groups;
+  priv->pos = pos;
+  priv->swapped = TRUE;
+}
+
+/* Returns the number of bytes of history held in memory */
+
+gsize
+sd_undo_get_size (SDUndo *self)
+{
+  SDUndoPrivate *priv = sd_undo_get_instance_private (self);
+  return priv->size;
+}
@@ -0,0 +1,38 @@
+/* sd-undo.h -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef _SD_UNDO_H
+#define _SD_UNDO_H
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+#define SD_TYPE_UNDO sd_undo_get_type ()
+G_DECLARE_FINAL_TYPE (SDUndo, sd_undo, SD, UNDO, GObject)
+
+struct _SDUndo
+{
+  GObject parent;
+};
+
+SDUndo *sd_undo_new (GtkTextBuffer *buffer, GSettings *settings);
+void sd_undo_set_swapped (SDUndo *self, gboolean swapped);
+gsize sd_undo_get_size (SDUndo *self);
+
+G_END_DECLS
+
+#endif
@@ -14,18 +14,45 @@
    You should have received a copy of the GNU General Public License
    along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
 
+#include <gtksourceview/gtksource.h>
+#include "sd-build.h"
 #include "sd-preferences.h"
+#include "sd-project-search.h"
 #include "sd-editor.h"
+#include "sd-fold.h"
+#include "sd-memory-dialog.h"
+#include "sd-profile.h"
 #include "sd-project-tree.h"
+#include "sd-session.h"
 
 struct _SDWindowPrivate
 {
   GtkHeaderBar *header;
+  GtkMenuItem *find_in_project_item;
+  GtkMenuItem *memory_item;
   GtkMenuItem *preferences_item;
+  GtkWidget *tree_filter;
   GtkWidget *tree_window;
   GtkWidget *editor_view;
+  GtkWidget *build_view;
   SDEditor *editor;
+  SDBuild *build;
+  SDProjectTree *tree;
+  SDProjectSearch *project_search;
+  SDMemoryDialog *memory_dialog;
+  GFile *root;
   gchar *title;
+
+  /* Startup stages run after the window is first shown */
+  SDProfile *profile;
+  guint pending_stages;
+  gchar **session;
+  gint session_pos;
+  gint session_current;
+  gint64 session_start;
+  gint64 tree_start;
+  guint restore_id;
+  guint warmup_id;
 };
 
 typedef struct _SDWindowPrivate SDWindowPrivate;
@@ -40,11 +67,175 @@ sd_window_save_activated (GtkAccelGroup *group, GObject *obj, guint key,
   sd_editor_save_file (priv->editor);
 }
 
+static void
+sd_window_save_all_activated (GtkAccelGroup *group, GObject *obj, guint key,
+			      GdkModifierType mod)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  sd_editor_save_all (priv->editor);
+}
+
+static void
+sd_window_build_activated (GtkAccelGroup *group, GObject *obj, guint key,
+			   GdkModifierType mod)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  if (priv->build != NULL)
+    sd_build_run (priv->build);
+}
+
+static void
+sd_window_find_activated (GtkAccelGroup *group, GObject *obj, guint key,
+			  GdkModifierType mod)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  if (priv->editor != NULL)
+    sd_editor_find (priv->editor);
+}
+
+/* Ctrl+\ splits the current tab side by side and Ctrl+Alt+\ stacks the
+   views */
+
+static void
+sd_window_split_activated (GtkAccelGroup *group, GObject *obj, guint key,
+			   GdkModifierType mod)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  if (priv->editor != NULL)
+    sd_editor_split (priv->editor, mod & GDK_MOD1_MASK ?
+		     GTK_ORIENTATION_VERTICAL : GTK_ORIENTATION_HORIZONTAL);
+}
+
+static void
+sd_window_unsplit_activated (GtkAccelGroup *group, GObject *obj, guint key,
+			     GdkModifierType mod)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  if (priv->editor != NULL)
+    sd_editor_unsplit (priv->editor);
+}
+
+/* Shows the project search dialog, creating it if it isn't open */
+
+static void
+sd_window_find_in_project (SDWindow *self)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  if (priv->editor == NULL)
+    return;
+  if (priv->project_search == NULL)
+    {
+      priv->project_search =
+	sd_project_search_new (self, priv->root, priv->editor);
+      g_signal_connect (priv->project_search, "destroy",
+			G_CALLBACK (gtk_widget_destroyed),
+			&priv->project_search);
+    }
+  gtk_window_present (GTK_WINDOW (priv->project_search));
+}
+
+static void
+sd_window_find_in_project_activated (GtkAccelGroup *group, GObject *obj,
+				     guint key, GdkModifierType mod)
+{
+  sd_window_find_in_project (SD_WINDOW (obj));
+}
+
+static void
+sd_window_find_in_project_item_activate (GtkMenuItem *item,
+					 gpointer user_data)
+{
+  sd_window_find_in_project (SD_WINDOW (user_data));
+}
+
+static void
+sd_window_tree_filter_changed (GtkSearchEntry *entry, gpointer user_data)
+{
+  sd_project_tree_set_filter (SD_PROJECT_TREE (user_data),
+			      gtk_entry_get_text (GTK_ENTRY (entry)));
+}
+
+/* Shows the memory usage dialog, creating it if it isn't open */
+
+static void
+sd_window_memory_item_activate (GtkMenuItem *item, gpointer user_data)
+{
+  SDWindow *self = SD_WINDOW (user_data);
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  if (priv->memory_dialog == NULL)
+    {
+      priv->memory_dialog = sd_memory_dialog_new (self);
+      g_signal_connect (priv->memory_dialog, "destroy",
+			G_CALLBACK (gtk_widget_destroyed),
+			&priv->memory_dialog);
+    }
+  gtk_window_present (GTK_WINDOW (priv->memory_dialog));
+}
+
+static void
+sd_window_destroy (GtkWidget *widget)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (widget));
+  if (priv->restore_id != 0)
+    {
+      g_source_remove (priv->restore_id);
+      priv->restore_id = 0;
+    }
+  if (priv->warmup_id != 0)
+    {
+      g_source_remove (priv->warmup_id);
+      priv->warmup_id = 0;
+    }
+  if (priv->project_search != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->project_search,
+					    &priv->project_search);
+      priv->project_search = NULL;
+    }
+  if (priv->memory_dialog != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->memory_dialog,
+					    &priv->memory_dialog);
+      priv->memory_dialog = NULL;
+    }
+  priv->tree = NULL;
+
+  /* Don't overwrite the saved session if it was never fully restored */
+  if (priv->editor != NULL && priv->session == NULL)
+    {
+      gint current;
+      GPtrArray *files = sd_editor_get_files (priv->editor, &current);
+      sd_session_save (priv->root, files, current);
+      g_ptr_array_free (files, TRUE);
+      priv->editor = NULL;
+    }
+  GTK_WIDGET_CLASS (sd_window_parent_class)->destroy (widget);
+}
+
+static void
+sd_window_finalize (GObject *obj)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (SD_WINDOW (obj));
+  g_clear_object (&priv->root);
+  g_free (priv->title);
+  g_strfreev (priv->session);
+  if (priv->profile != NULL)
+    sd_profile_free (priv->profile);
+  G_OBJECT_CLASS (sd_window_parent_class)->finalize (obj);
+}
+
 static void
 sd_window_init (SDWindow *self)
 {
   GtkAccelGroup *accels;
   GClosure *save_closure;
+  GClosure *save_all_closure;
+  GClosure *build_closure;
+  GClosure *find_closure;
+  GClosure *find_in_project_closure;
+  GClosure *split_closure;
+  GClosure *stack_closure;
+  GClosure *unsplit_closure;
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
@@ -53,22 +244,67 @@ sd_window_init (SDWindow *self)
 				      self, NULL);
   gtk_accel_group_connect (accels, GDK_KEY_S, GDK_CONTROL_MASK,
 			   GTK_ACCEL_VISIBLE, save_closure);
+  save_all_closure =
+    g_cclosure_new_swap (G_CALLBACK (sd_window_save_all_activated), self,
+			 NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_S,
+			   GDK_CONTROL_MASK | GDK_SHIFT_MASK,
+			   GTK_ACCEL_VISIBLE, save_all_closure);
+  build_closure = g_cclosure_new_swap (G_CALLBACK (sd_window_build_activated),
+				       self, NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_B, GDK_CONTROL_MASK,
+			   GTK_ACCEL_VISIBLE, build_closure);
+  find_closure = g_cclosure_new_swap (G_CALLBACK (sd_window_find_activated),
+				      self, NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_F, GDK_CONTROL_MASK,
+			   GTK_ACCEL_VISIBLE, find_closure);
+  find_in_project_closure =
+    g_cclosure_new_swap (G_CALLBACK (sd_window_find_in_project_activated),
+			 self, NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_F,
+			   GDK_CONTROL_MASK | GDK_SHIFT_MASK,
+			   GTK_ACCEL_VISIBLE, find_in_project_closure);
+  split_closure = g_cclosure_new_swap (G_CALLBACK (sd_window_split_activated),
+				       self, NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_backslash, GDK_CONTROL_MASK,
+			   GTK_ACCEL_VISIBLE, split_closure);
+  stack_closure = g_cclosure_new_swap (G_CALLBACK (sd_window_split_activated),
+				       self, NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_backslash,
+			   GDK_CONTROL_MASK | GDK_MOD1_MASK,
+			   GTK_ACCEL_VISIBLE, stack_closure);
+  unsplit_closure =
+    g_cclosure_new_swap (G_CALLBACK (sd_window_unsplit_activated), self,
+			 NULL);
+  gtk_accel_group_connect (accels, GDK_KEY_W,
+			   GDK_CONTROL_MASK | GDK_MOD1_MASK,
+			   GTK_ACCEL_VISIBLE, unsplit_closure);
   gtk_window_add_accel_group (GTK_WINDOW (self), accels);
 }
 
 static void
 sd_window_class_init (SDWindowClass *klass)
 {
+  G_OBJECT_CLASS (klass)->finalize = sd_window_finalize;
+  GTK_WIDGET_CLASS (klass)->destroy = sd_window_destroy;
   gtk_widget_class_set_template_from_resource (GTK_WIDGET_CLASS (klass),
 					       SD_RESOURCE_WINDOW_UI);
   gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
 						SDWindow, header);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDWindow, find_in_project_item);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDWindow, memory_item);
   gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
 						SDWindow, preferences_item);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDWindow, tree_filter);
   gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
 						SDWindow, tree_window);
   gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
 						SDWindow, editor_view);
+  gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass),
+						SDWindow, build_view);
 }
 
 SDWindow *
@@ -77,14 +313,101 @@ sd_window_new (SDApplication *app)
   return g_object_new (SD_TYPE_WINDOW, "application", app, NULL);
 }
 
+static void
+sd_window_stage_done (SDWindow *self, const gchar *stage, gint64 start)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  sd_profile_add (priv->profile, stage, start, sd_profile_now ());
+  if (--priv->pending_stages == 0 && sd_profile_get_enabled ())
+    sd_profile_print (priv->profile);
+}
+
+static gboolean
+sd_window_first_draw (GtkWidget *widget, cairo_t *cr, gpointer user_data)
+{
+  g_signal_handlers_disconnect_by_func (widget, sd_window_first_draw,
+					user_data);
+  sd_window_stage_done (SD_WINDOW (widget), "first-paint", 0);
+  return FALSE;
+}
+
+static void
+sd_window_tree_loaded (GObject *obj, GAsyncResult *result, gpointer user_data)
+{
+  SDWindow *self = SD_WINDOW (user_data);
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  if (sd_project_tree_load_finish (SD_PROJECT_TREE (obj), result, NULL))
+    sd_window_stage_done (self, "tree-load", priv->tree_start);
+  g_object_unref (self);
+}
+
+/* Opens one file from the saved session on each iteration, so restoring
+   many tabs doesn't block the main loop */
+
+static gboolean
+sd_window_restore_step (gpointer user_data)
+{
+  SDWindow *self = SD_WINDOW (user_data);
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  GFile *file;
+
+  if (priv->session == NULL || priv->session[priv->session_pos] == NULL)
+    {
+      if (priv->session_current >= 0)
+	gtk_notebook_set_current_page (GTK_NOTEBOOK (priv->editor),
+				       priv->session_current);
+      g_strfreev (priv->session);
+      priv->session = NULL;
+      priv->restore_id = 0;
+      sd_window_stage_done (self, "session-restore", priv->session_start);
+      return G_SOURCE_REMOVE;
+    }
+
+  file = g_file_new_for_uri (priv->session[priv->session_pos++]);
+  if (g_file_query_exists (file, NULL))
+    {
+      gchar *name = g_file_get_basename (file);
+      sd_editor_open_tab (priv->editor, name, file);
+      g_free (name);
+    }
+  g_object_unref (file);
+  return G_SOURCE_CONTINUE;
+}
+
+/* Loading the language definitions takes a noticeable amount of time, so
+   it is done before the first file is opened instead of during it */
+
+static gboolean
+sd_window_warm_up (gpointer user_data)
+{
+  SDWindow *self = SD_WINDOW (user_data);
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  gint64 start = sd_profile_now ();
+
+  gtk_source_language_manager_get_language_ids
+    (gtk_source_language_manager_get_default ());
+  gtk_source_style_scheme_manager_get_scheme_ids
+    (gtk_source_style_scheme_manager_get_default ());
+  priv->warmup_id = 0;
+  sd_window_stage_done (self, "language-warmup", start);
+  return G_SOURCE_REMOVE;
+}
+
+/* Sets up the window for the project at FILE. Only the window shell is
+   built here, so the window can be presented immediately; the project
+   tree, language definitions and previous session are loaded afterwards
+   in order of priority. */
+
 void
 sd_window_open (SDWindow *window, GFile *file)
 {
   SDWindowPrivate *priv = sd_window_get_instance_private (window);
+  gint64 start = sd_profile_now ();
   SDProjectTree *tree = sd_project_tree_new (window, file);
   gchar *basename;
 
   g_return_if_fail (tree != NULL);
+  priv->tree = tree;
   gtk_container_add (GTK_CONTAINER (priv->tree_window), GTK_WIDGET (tree));
   gtk_widget_show_all (priv->tree_window);
 
@@ -93,15 +416,65 @@ sd_window_open (SDWindow *window, GFile *file)
 		     GTK_WIDGET (priv->editor));
   gtk_widget_show_all (priv->editor_view);
 
+  priv->root = g_object_ref (file);
+  priv->build = sd_build_new (window, file);
+  gtk_container_add (GTK_CONTAINER (priv->build_view),
+		     GTK_WIDGET (priv->build));
+  gtk_widget_show_all (priv->build_view);
+
   basename = g_file_get_basename (file);
   priv->title = g_strdup_printf ("SimpleDevelop - %s", basename);
+  priv->profile = sd_profile_new (basename);
   g_free (basename);
   basename = g_strdup_printf ("%s - Startup", priv->title);
   gtk_header_bar_set_title (priv->header, basename);
   g_free (basename);
 
+  g_signal_connect (priv->find_in_project_item, "activate",
+		    G_CALLBACK (sd_window_find_in_project_item_activate),
+		    window);
+  g_signal_connect (priv->memory_item, "activate",
+		    G_CALLBACK (sd_window_memory_item_activate), window);
   g_signal_connect (priv->preferences_item, "activate",
 		    G_CALLBACK (sd_preferences_activate), window);
+  g_signal_connect_object (priv->tree_filter, "search-changed",
+			   G_CALLBACK (sd_window_tree_filter_changed), tree, 0);
+
+  sd_profile_add (priv->profile, "launch", 0, start);
+  sd_profile_add (priv->profile, "window-shell", start, sd_profile_now ());
+  priv->pending_stages = 4;
+  g_signal_connect_after (window, "draw", G_CALLBACK (sd_window_first_draw),
+			  NULL);
+
+  priv->tree_start = sd_profile_now ();
+  sd_project_tree_load_async (tree, sd_window_tree_loaded,
+			      g_object_ref (window));
+
+  /* Idle sources of the same priority run in the order they were added,
+     so the warm-up finishes before the first restored file is opened */
+  priv->warmup_id = g_idle_add (sd_window_warm_up, window);
+
+  priv->session_start = sd_profile_now ();
+  priv->session = sd_session_load (file, &priv->session_current);
+  priv->session_pos = 0;
+  priv->restore_id = g_idle_add (sd_window_restore_step, window);
+}
+
+/* The editor and project tree are only created when a project is opened,
+   and are returned as widgets since their headers include this one */
+
+GtkWidget *
+sd_window_get_editor (SDWindow *self)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  return GTK_WIDGET (priv->editor);
+}
+
+GtkWidget *
+sd_window_get_tree (SDWindow *self)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  return GTK_WIDGET (priv->tree);
 }
 
 void
@@ -111,6 +484,22 @@ sd_window_editor_open (SDWindow *self, const gchar *filename, GFile *file)
   sd_editor_open_tab (priv->editor, filename, file);
 }
 
+void
+sd_window_editor_preview (SDWindow *self, const gchar *filename, GFile *file)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  sd_editor_preview_tab (priv->editor, filename, file);
+}
+
+void
+sd_window_editor_open_at (SDWindow *self, const gchar *filename, GFile *file,
+			  gint line, gint column)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  if (sd_editor_open_tab (priv->editor, filename, file))
+    sd_editor_goto_line (priv->editor, line, column);
+}
+
 void
 sd_window_update_title (SDWindow *self, const gchar *name)
 {
@@ -119,3 +508,27 @@ sd_window_update_title (SDWindow *self, const gchar *name)
   gtk_header_bar_set_title (priv->header, title);
   g_free (title);
 }
+
+/* Adds the estimated memory use of the open tabs, the project tree, the
+   build pane and caches to REPORT */
+
+void
+sd_window_get_memory (SDWindow *self, SDMemoryReport *report)
+{
+  SDWindowPrivate *priv = sd_window_get_instance_private (self);
+  SDGitStatus *git = NULL;
+
+  if (priv->editor != NULL)
+    sd_editor_get_memory (priv->editor, report);
+  if (priv->tree != NULL)
+    {
+      sd_project_tree_get_memory (priv->tree, report);
+      git = sd_project_tree_get_git_status (priv->tree);
+    }
+  if (priv->build != NULL)
+    sd_build_get_memory (priv->build, report);
+  sd_memory_report_begin (report, "Caches");
+  sd_memory_report_add (report, "Fold regions", sd_fold_get_cache_size ());
+  if (git != NULL)
+    sd_memory_report_add (report, "Git status", sd_git_status_get_size (git));
+}
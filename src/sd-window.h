@@ -18,6 +18,7 @@
 #define _SD_WINDOW_H
 
 #include "sd-application.h"
+#include "sd-memory.h"
 
 G_BEGIN_DECLS
 
@@ -31,8 +32,15 @@ struct _SDWindow
 
 SDWindow *sd_window_new (SDApplication *app);
 void sd_window_open (SDWindow *window, GFile *file);
+GtkWidget *sd_window_get_editor (SDWindow *self);
+GtkWidget *sd_window_get_tree (SDWindow *self);
 void sd_window_editor_open (SDWindow *self, const gchar *filename, GFile *file);
+void sd_window_editor_preview (SDWindow *self, const gchar *filename,
+			       GFile *file);
+void sd_window_editor_open_at (SDWindow *self, const gchar *filename,
+			       GFile *file, gint line, gint column);
 void sd_window_update_title (SDWindow *self, const gchar *name);
+void sd_window_get_memory (SDWindow *self, SDMemoryReport *report);
 
 G_END_DECLS
 
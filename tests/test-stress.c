@@ -0,0 +1,852 @@
+/* test-stress.c -- This file is part of SimpleDevelop.
+   Copyright (C) 2021 XNSC
+
+   SimpleDevelop is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   SimpleDevelop is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with SimpleDevelop. If not, see <https://www.gnu.org/licenses/>. */
+
+/* Drives windows, editors and project trees through random sequences of
+   operations on a synthetic project, checking after each one that no
+   tab records, tags or objects are leaked and that it finished within
+   its latency budget. The sequence is taken from the test seed, so a
+   failing run can be repeated with the --seed option it prints. */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <gtksourceview/gtksource.h>
+#include "resources.h"
+#include "sd-editor.h"
+#include "sd-project-tree.h"
+#include "sd-window.h"
+
+#define STRESS_DIRS 4
+#define STRESS_FILES_PER_DIR 10
+#define STRESS_FILES (STRESS_DIRS * STRESS_FILES_PER_DIR)
+
+/* Number of operations in each run, more with -m slow */
+#define STRESS_OPS 400
+#define STRESS_SLOW_OPS 4000
+
+/* Tabs are closed instead of opened beyond this many */
+#define STRESS_MAX_TABS 12
+
+/* Undo memory limit for the run in KiB, small enough to be reached */
+#define STRESS_UNDO_LIMIT 64
+
+/* Time allowed for closed tabs and windows to be freed, and for an
+   operation that failed its budget to finish anyway, in milliseconds */
+#define STRESS_SETTLE_TIME 5000
+
+/* Number of windows opened and closed by the window test */
+#define STRESS_WINDOWS 10
+
+typedef enum
+{
+  STRESS_OPEN = 0,
+  STRESS_PREVIEW,
+  STRESS_EDIT,
+  STRESS_UNDO,
+  STRESS_SAVE,
+  STRESS_SWITCH,
+  STRESS_SPLIT,
+  STRESS_CLOSE,
+  STRESS_FILTER,
+  STRESS_N_OPS
+} StressOp;
+
+static const gchar *stress_op_names[STRESS_N_OPS] = {
+  "open", "preview", "edit", "undo", "save", "switch", "split", "close",
+  "filter"
+};
+
+/* Latency budget of each operation in milliseconds. Saves and filters
+   are timed until their result is visible, the rest until they return.
+   The budgets are generous so a loaded machine passes, but work that
+   grows with the number of edits or tabs does not. */
+static const gint stress_budgets[STRESS_N_OPS] = {
+  250, 250, 20, 50, 2000, 50, 100, 100, 2000
+};
+
+struct _Stress
+{
+  SDWindow *window;
+  SDEditor *editor;
+  SDProjectTree *tree;
+  gchar *root;
+  GPtrArray *files;
+  GHashTable *paths;
+  GHashTable *tags;
+  gint64 max_latency[STRESS_N_OPS];
+  guint count[STRESS_N_OPS];
+};
+
+typedef struct _Stress Stress;
+
+typedef gboolean (*StressCond) (Stress *s, gpointer data);
+
+static SDApplication *stress_app;
+static gdouble stress_scale = 1.0;
+
+static void
+stress_remove_tree (const gchar *path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  const gchar *name;
+
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+	{
+	  gchar *child = g_build_filename (path, name, NULL);
+	  stress_remove_tree (child);
+	  g_free (child);
+	}
+      g_dir_close (dir);
+      g_rmdir (path);
+    }
+  else
+    g_unlink (path);
+}
+
+/* Runs the main loop until COND holds or TIMEOUT milliseconds pass, and
+   returns whether COND held */
+
+static gboolean
+stress_wait (Stress *s, StressCond cond, gpointer data, gint timeout)
+{
+  gint64 deadline = g_get_monotonic_time () + (gint64) timeout * 1000;
+  while (!cond (s, data))
+    {
+      if (g_get_monotonic_time () > deadline)
+	return FALSE;
+      if (!g_main_context_iteration (NULL, FALSE))
+	g_usleep (1000);
+    }
+  return TRUE;
+}
+
+/* Objects expected to be freed are tracked with weak pointers, each in
+   its own slot since the array holding them may move */
+
+static void
+stress_add_weak (GPtrArray *weak, gpointer obj)
+{
+  gpointer *slot = g_new (gpointer, 1);
+  *slot = obj;
+  g_object_add_weak_pointer (G_OBJECT (obj), slot);
+  g_ptr_array_add (weak, slot);
+}
+
+static gboolean
+stress_cond_null (Stress *s, gpointer data)
+{
+  GPtrArray *weak = data;
+  guint i;
+  for (i = 0; i < weak->len; i++)
+    {
+      gpointer *slot = g_ptr_array_index (weak, i);
+      if (*slot != NULL)
+	return FALSE;
+    }
+  return TRUE;
+}
+
+/* Waits for the objects in WEAK to be freed */
+
+static void
+stress_assert_freed (Stress *s, GPtrArray *weak, const gchar *what)
+{
+  if (!stress_wait (s, stress_cond_null, weak, STRESS_SETTLE_TIME))
+    g_error ("%s was not freed", what);
+}
+
+static void
+stress_add_views (GtkWidget *widget, gpointer data)
+{
+  if (GTK_SOURCE_IS_VIEW (widget))
+    stress_add_weak (data, widget);
+  else if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), stress_add_views, data);
+}
+
+static gchar *
+stress_random_text (void)
+{
+  static const gchar *words[] = {
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"
+  };
+  GString *text = g_string_new (NULL);
+  gint lines = g_test_rand_int_range (1, 200);
+  gint i;
+  gint j;
+
+  /* Brackets are avoided, since matching them adds a tag to the buffer */
+  for (i = 0; i < lines; i++)
+    {
+      gint n = g_test_rand_int_range (0, 12);
+      for (j = 0; j < n; j++)
+	{
+	  gint word = g_test_rand_int_range (0, G_N_ELEMENTS (words));
+	  if (j > 0)
+	    g_string_append_c (text, ' ');
+	  g_string_append (text, words[word]);
+	}
+      g_string_append_c (text, '\n');
+    }
+  return g_string_free (text, FALSE);
+}
+
+/* Creates a project of plain text files, which have no syntax
+   highlighting, so a buffer's tags are all created when its tab opens */
+
+static void
+stress_make_project (Stress *s)
+{
+  GError *err = NULL;
+  gint i;
+
+  s->root = g_dir_make_tmp ("simpledevelop-stress-XXXXXX", &err);
+  g_assert_no_error (err);
+  s->files = g_ptr_array_new_with_free_func (g_object_unref);
+  s->paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 0; i < STRESS_FILES; i++)
+    {
+      gchar *dir = g_strdup_printf ("%s/dir-%02d", s->root,
+				    i / STRESS_FILES_PER_DIR);
+      gchar *path = g_strdup_printf ("%s/file-%03d.txt", dir, i);
+      gchar *text = stress_random_text ();
+
+      g_mkdir_with_parents (dir, 0755);
+      g_file_set_contents (path, text, -1, &err);
+      g_assert_no_error (err);
+      g_ptr_array_add (s->files, g_file_new_for_path (path));
+      g_hash_table_add (s->paths, path);
+      g_free (text);
+      g_free (dir);
+    }
+}
+
+static void
+stress_setup (Stress *s, gconstpointer data)
+{
+  GFile *root;
+
+  memset (s, 0, sizeof (Stress));
+  stress_make_project (s);
+  s->tags = g_hash_table_new (NULL, NULL);
+
+  root = g_file_new_for_path (s->root);
+  s->window = sd_window_new (stress_app);
+  sd_window_open (s->window, root);
+  gtk_widget_show (GTK_WIDGET (s->window));
+  s->editor = SD_EDITOR (sd_window_get_editor (s->window));
+  s->tree = SD_PROJECT_TREE (sd_window_get_tree (s->window));
+  g_object_unref (root);
+}
+
+static void
+stress_teardown (Stress *s, gconstpointer data)
+{
+  GPtrArray *weak = g_ptr_array_new_with_free_func (g_free);
+  gint i;
+
+  for (i = 0; i < STRESS_N_OPS; i++)
+    {
+      if (s->count[i] > 0)
+	g_test_message ("%s: %u runs, slowest %.1f ms", stress_op_names[i],
+			s->count[i], s->max_latency[i] / 1000.0);
+    }
+
+  stress_add_weak (weak, s->window);
+  stress_add_weak (weak, s->editor);
+  stress_add_weak (weak, s->tree);
+  gtk_widget_destroy (GTK_WIDGET (s->window));
+  stress_assert_freed (s, weak, "Window");
+  g_ptr_array_free (weak, TRUE);
+
+  g_hash_table_unref (s->tags);
+  g_hash_table_unref (s->paths);
+  g_ptr_array_free (s->files, TRUE);
+  stress_remove_tree (s->root);
+  g_free (s->root);
+}
+
+static void
+stress_record (Stress *s, StressOp op, gint64 start)
+{
+  gint64 elapsed = g_get_monotonic_time () - start;
+  gint64 budget = stress_budgets[op] * stress_scale * 1000;
+
+  s->count[op]++;
+  s->max_latency[op] = MAX (s->max_latency[op], elapsed);
+  if (elapsed > budget)
+    g_error ("%s took %.1f ms, over its budget of %.1f ms",
+	     stress_op_names[op], elapsed / 1000.0, budget / 1000.0);
+}
+
+static GFile *
+stress_random_file (Stress *s)
+{
+  return g_ptr_array_index (s->files,
+			    g_test_rand_int_range (0, s->files->len));
+}
+
+static GtkTextBuffer *
+stress_current_buffer (Stress *s, GFile **file)
+{
+  GPtrArray *files;
+  GtkTextBuffer *buffer = NULL;
+  gint current;
+
+  files = sd_editor_get_files (s->editor, &current);
+  if (current >= 0 && current < files->len)
+    {
+      *file = g_object_ref (g_ptr_array_index (files, current));
+      buffer = sd_editor_get_buffer (s->editor, *file);
+    }
+  g_ptr_array_free (files, TRUE);
+  return buffer;
+}
+
+/* Checks that the editor keeps one record for each notebook page, that
+   no file is open twice, and that editing never adds tags */
+
+static void
+stress_check_editor (Stress *s)
+{
+  gint pages = gtk_notebook_get_n_pages (GTK_NOTEBOOK (s->editor));
+  GPtrArray *files;
+  gint current;
+  guint i;
+  guint j;
+
+  g_assert_cmpuint (sd_editor_get_n_tabs (s->editor), ==, pages);
+  files = sd_editor_get_files (s->editor, &current);
+  g_assert_cmpuint (files->len, ==, pages);
+  for (i = 0; i < files->len; i++)
+    {
+      GFile *file = g_ptr_array_index (files, i);
+      GtkTextBuffer *buffer = sd_editor_get_buffer (s->editor, file);
+      GtkTextTagTable *table;
+      gpointer size;
+
+      for (j = i + 1; j < files->len; j++)
+	g_assert_false (g_file_equal (file, g_ptr_array_index (files, j)));
+
+      g_assert_nonnull (buffer);
+      table = gtk_text_buffer_get_tag_table (buffer);
+      if (g_hash_table_lookup_extended (s->tags, buffer, NULL, &size))
+	g_assert_cmpint (gtk_text_tag_table_get_size (table), ==,
+			 GPOINTER_TO_INT (size));
+      else
+	g_hash_table_insert (s->tags, buffer,
+			     GINT_TO_POINTER (gtk_text_tag_table_get_size
+					      (table)));
+    }
+  g_ptr_array_free (files, TRUE);
+}
+
+/* Checks that the undo history of each tab stays within the memory
+   limit, using the same estimates as the Memory Usage dialog */
+
+static void
+stress_check_memory (Stress *s)
+{
+  SDMemoryReport *report = sd_memory_report_new ();
+  guint i;
+  guint j;
+
+  sd_editor_get_memory (s->editor, report);
+  for (i = 0; i < report->groups->len; i++)
+    {
+      SDMemoryGroup *group = g_ptr_array_index (report->groups, i);
+      for (j = 0; j < group->items->len; j++)
+	{
+	  SDMemoryItem *item = &g_array_index (group->items, SDMemoryItem, j);
+	  if (strcmp (item->name, "Undo history") == 0)
+	    g_assert_cmpuint (item->bytes, <=, STRESS_UNDO_LIMIT * 1024);
+	}
+    }
+  sd_memory_report_free (report);
+}
+
+static gboolean
+stress_cond_saved (Stress *s, gpointer data)
+{
+  return !gtk_text_buffer_get_modified (data);
+}
+
+static void
+stress_open (Stress *s, gboolean preview)
+{
+  GFile *file = stress_random_file (s);
+  gchar *name = g_file_get_basename (file);
+  gint64 start = g_get_monotonic_time ();
+
+  if (preview)
+    sd_window_editor_preview (s->window, name, file);
+  else
+    sd_window_editor_open (s->window, name, file);
+  stress_record (s, preview ? STRESS_PREVIEW : STRESS_OPEN, start);
+  g_free (name);
+}
+
+static void
+stress_edit (Stress *s)
+{
+  GFile *file = NULL;
+  GtkTextBuffer *buffer = stress_current_buffer (s, &file);
+  GtkTextIter iter;
+  GtkTextIter end;
+  gint64 start;
+  gint chars;
+  gint offset;
+
+  if (buffer == NULL)
+    return;
+  chars = gtk_text_buffer_get_char_count (buffer);
+  offset = g_test_rand_int_range (0, chars + 1);
+  start = g_get_monotonic_time ();
+  gtk_text_buffer_begin_user_action (buffer);
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+  if (chars > 0 && g_test_rand_bit ())
+    {
+      end = iter;
+      gtk_text_iter_forward_chars (&end, g_test_rand_int_range (1, 40));
+      gtk_text_buffer_delete (buffer, &iter, &end);
+    }
+  else
+    {
+      gchar *text = stress_random_text ();
+      gtk_text_buffer_insert (buffer, &iter, text, -1);
+      g_free (text);
+    }
+  gtk_text_buffer_end_user_action (buffer);
+  stress_record (s, STRESS_EDIT, start);
+  g_object_unref (file);
+}
+
+static void
+stress_undo (Stress *s)
+{
+  GFile *file = NULL;
+  GtkTextBuffer *buffer = stress_current_buffer (s, &file);
+  gint64 start;
+
+  if (buffer == NULL)
+    return;
+  start = g_get_monotonic_time ();
+  if (gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (buffer)))
+    gtk_source_buffer_undo (GTK_SOURCE_BUFFER (buffer));
+  stress_record (s, STRESS_UNDO, start);
+  g_object_unref (file);
+}
+
+/* Saves the current tab, sometimes saving again after another edit
+   before the first save finishes, and checks the file holds the text of
+   the buffer once it is clean */
+
+static void
+stress_save (Stress *s)
+{
+  GFile *file = NULL;
+  GtkTextBuffer *buffer = stress_current_buffer (s, &file);
+  GError *err = NULL;
+  GtkTextIter start_iter;
+  GtkTextIter end_iter;
+  gchar *path;
+  gchar *text;
+  gchar *contents;
+  gint64 start;
+
+  if (buffer == NULL)
+    return;
+  start = g_get_monotonic_time ();
+  sd_editor_save_file (s->editor);
+  if (g_test_rand_bit ())
+    {
+      stress_edit (s);
+      sd_editor_save_file (s->editor);
+    }
+  if (!stress_wait (s, stress_cond_saved, buffer, STRESS_SETTLE_TIME))
+    g_error ("Save of a modified buffer never finished");
+  stress_record (s, STRESS_SAVE, start);
+
+  gtk_text_buffer_get_bounds (buffer, &start_iter, &end_iter);
+  text = gtk_text_buffer_get_text (buffer, &start_iter, &end_iter, FALSE);
+  path = g_file_get_path (file);
+  g_file_get_contents (path, &contents, NULL, &err);
+  g_assert_no_error (err);
+  g_assert_cmpstr (contents, ==, text);
+  g_free (contents);
+  g_free (path);
+  g_free (text);
+  g_object_unref (file);
+}
+
+static void
+stress_switch (Stress *s)
+{
+  gint pages = gtk_notebook_get_n_pages (GTK_NOTEBOOK (s->editor));
+  gint64 start;
+
+  if (pages == 0)
+    return;
+  start = g_get_monotonic_time ();
+  gtk_notebook_set_current_page (GTK_NOTEBOOK (s->editor),
+				 g_test_rand_int_range (0, pages));
+  stress_record (s, STRESS_SWITCH, start);
+}
+
+static void
+stress_split (Stress *s)
+{
+  gint64 start = g_get_monotonic_time ();
+  if (g_test_rand_bit ())
+    sd_editor_split (s->editor, g_test_rand_bit () ?
+		     GTK_ORIENTATION_HORIZONTAL : GTK_ORIENTATION_VERTICAL);
+  else
+    sd_editor_unsplit (s->editor);
+  stress_record (s, STRESS_SPLIT, start);
+}
+
+/* Closes the current tab and checks that its buffer and views are freed
+   once any save of it has finished */
+
+static void
+stress_close (Stress *s)
+{
+  GFile *file = NULL;
+  GtkTextBuffer *buffer = stress_current_buffer (s, &file);
+  gint page = gtk_notebook_get_current_page (GTK_NOTEBOOK (s->editor));
+  GPtrArray *weak;
+  gint64 start;
+
+  if (buffer == NULL)
+    return;
+  weak = g_ptr_array_new_with_free_func (g_free);
+  stress_add_weak (weak, buffer);
+  stress_add_views (gtk_notebook_get_nth_page (GTK_NOTEBOOK (s->editor),
+					       page), weak);
+  g_hash_table_remove (s->tags, buffer);
+
+  start = g_get_monotonic_time ();
+  g_assert_true (sd_editor_close_file (s->editor, file));
+  stress_record (s, STRESS_CLOSE, start);
+  g_assert_null (sd_editor_get_buffer (s->editor, file));
+  stress_assert_freed (s, weak, "Closed tab");
+  g_ptr_array_free (weak, TRUE);
+  g_object_unref (file);
+}
+
+/* Counts the project files shown by the tree, including those in
+   collapsed directories */
+
+static gboolean
+stress_count_visible (GtkTreeModel *model, GtkTreePath *path,
+		      GtkTreeIter *iter, gpointer data)
+{
+  Stress *s = ((gpointer *) data)[0];
+  guint *count = ((gpointer *) data)[1];
+  GFile *file;
+  gchar *str;
+
+  gtk_tree_model_get (model, iter, FILE_COLUMN, &file, -1);
+  str = g_file_get_path (file);
+  if (g_hash_table_contains (s->paths, str))
+    (*count)++;
+  g_free (str);
+  g_object_unref (file);
+  return FALSE;
+}
+
+static gboolean
+stress_cond_filtered (Stress *s, gpointer data)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (s->tree));
+  guint count = 0;
+  gpointer args[2];
+
+  args[0] = s;
+  args[1] = &count;
+  gtk_tree_model_foreach (model, stress_count_visible, args);
+  return count == GPOINTER_TO_UINT (data);
+}
+
+/* Sets a filter on the project tree and waits for exactly the files
+   whose path contains it to be shown */
+
+static void
+stress_filter (Stress *s)
+{
+  gsize root_len = strlen (s->root) + 1;
+  gint n = g_test_rand_int_range (0, STRESS_FILES);
+  gchar *query;
+  guint expected = 0;
+  gint64 start;
+  guint i;
+
+  switch (g_test_rand_int_range (0, 5))
+    {
+    case 0:
+      query = g_strdup_printf ("file-%03d", n);
+      break;
+    case 1:
+      query = g_strdup_printf ("FILE-%02d", n / 10);
+      break;
+    case 2:
+      query = g_strdup_printf ("dir-%02d/", n / STRESS_FILES_PER_DIR);
+      break;
+    case 3:
+      query = g_strdup ("no-such-file");
+      break;
+    default:
+      query = g_strdup ("");
+      break;
+    }
+  for (i = 0; i < s->files->len; i++)
+    {
+      gchar *path = g_file_get_path (g_ptr_array_index (s->files, i));
+      gchar *key = g_utf8_casefold (path + root_len, -1);
+      gchar *folded = g_utf8_casefold (query, -1);
+      if (strstr (key, folded) != NULL)
+	expected++;
+      g_free (folded);
+      g_free (key);
+      g_free (path);
+    }
+
+  start = g_get_monotonic_time ();
+  sd_project_tree_set_filter (s->tree, query);
+  if (!stress_wait (s, stress_cond_filtered, GUINT_TO_POINTER (expected),
+		    STRESS_SETTLE_TIME))
+    g_error ("Filter `%s' never showed the %u files it matches", query,
+	     expected);
+  stress_record (s, STRESS_FILTER, start);
+  g_free (query);
+}
+
+static guint
+stress_n_ops (void)
+{
+  return g_test_slow () ? STRESS_SLOW_OPS : STRESS_OPS;
+}
+
+static void
+stress_run (Stress *s, const StressOp *ops, guint nops)
+{
+  guint i;
+
+  for (i = 0; i < stress_n_ops (); i++)
+    {
+      StressOp op = ops[g_test_rand_int_range (0, nops)];
+      gint pages = gtk_notebook_get_n_pages (GTK_NOTEBOOK (s->editor));
+
+      if (op == STRESS_OPEN && pages >= STRESS_MAX_TABS)
+	op = STRESS_CLOSE;
+      switch (op)
+	{
+	case STRESS_OPEN:
+	  stress_open (s, FALSE);
+	  break;
+	case STRESS_PREVIEW:
+	  stress_open (s, TRUE);
+	  break;
+	case STRESS_EDIT:
+	  stress_edit (s);
+	  break;
+	case STRESS_UNDO:
+	  stress_undo (s);
+	  break;
+	case STRESS_SAVE:
+	  stress_save (s);
+	  break;
+	case STRESS_SWITCH:
+	  stress_switch (s);
+	  break;
+	case STRESS_SPLIT:
+	  stress_split (s);
+	  break;
+	case STRESS_CLOSE:
+	  stress_close (s);
+	  break;
+	case STRESS_FILTER:
+	  stress_filter (s);
+	  break;
+	default:
+	  g_assert_not_reached ();
+	}
+
+      /* Let idle work such as debounced diffs run between operations */
+      while (g_main_context_iteration (NULL, FALSE))
+	;
+      stress_check_editor (s);
+      stress_check_memory (s);
+    }
+}
+
+/* Edits are weighted so buffers grow large enough to reach the undo
+   memory limit */
+
+static void
+test_editor (Stress *s, gconstpointer data)
+{
+  static const StressOp ops[] = {
+    STRESS_OPEN, STRESS_OPEN, STRESS_PREVIEW, STRESS_EDIT, STRESS_EDIT,
+    STRESS_EDIT, STRESS_EDIT, STRESS_UNDO, STRESS_SAVE, STRESS_SWITCH,
+    STRESS_SWITCH, STRESS_SPLIT, STRESS_CLOSE
+  };
+  stress_run (s, ops, G_N_ELEMENTS (ops));
+}
+
+static void
+test_tree (Stress *s, gconstpointer data)
+{
+  static const StressOp ops[] = {
+    STRESS_FILTER, STRESS_FILTER, STRESS_FILTER, STRESS_PREVIEW,
+    STRESS_OPEN, STRESS_CLOSE
+  };
+  stress_run (s, ops, G_N_ELEMENTS (ops));
+}
+
+/* Opens and closes whole windows with a few tabs each, checking each
+   window is freed along with its editor and project tree */
+
+static void
+test_window (Stress *s, gconstpointer data)
+{
+  GFile *root = g_file_new_for_path (s->root);
+  gint i;
+  gint j;
+
+  for (i = 0; i < STRESS_WINDOWS; i++)
+    {
+      SDWindow *window = sd_window_new (stress_app);
+      GPtrArray *weak = g_ptr_array_new_with_free_func (g_free);
+      gint64 start;
+
+      sd_window_open (window, root);
+      gtk_widget_show (GTK_WIDGET (window));
+      for (j = 0; j < 4; j++)
+	{
+	  GFile *file = stress_random_file (s);
+	  gchar *name = g_file_get_basename (file);
+	  start = g_get_monotonic_time ();
+	  sd_window_editor_open (window, name, file);
+	  stress_record (s, STRESS_OPEN, start);
+	  g_free (name);
+	}
+      while (g_main_context_iteration (NULL, FALSE))
+	;
+
+      stress_add_weak (weak, window);
+      stress_add_weak (weak, sd_window_get_editor (window));
+      stress_add_weak (weak, sd_window_get_tree (window));
+      gtk_widget_destroy (GTK_WIDGET (window));
+      stress_assert_freed (s, weak, "Closed window");
+      g_ptr_array_free (weak, TRUE);
+    }
+  g_object_unref (root);
+}
+
+/* Destroys windows before their project tree has finished loading,
+   checking the load stops and nothing is left behind */
+
+static void
+test_window_loading (Stress *s, gconstpointer data)
+{
+  GFile *root = g_file_new_for_path (s->root);
+  gint i;
+
+  for (i = 0; i < STRESS_WINDOWS; i++)
+    {
+      SDWindow *window = sd_window_new (stress_app);
+      GPtrArray *weak = g_ptr_array_new_with_free_func (g_free);
+
+      sd_window_open (window, root);
+      gtk_widget_show (GTK_WIDGET (window));
+
+      /* Let the load get a little way on some iterations */
+      if (i % 2 == 1)
+	g_main_context_iteration (NULL, FALSE);
+
+      stress_add_weak (weak, window);
+      stress_add_weak (weak, sd_window_get_editor (window));
+      stress_add_weak (weak, sd_window_get_tree (window));
+      gtk_widget_destroy (GTK_WIDGET (window));
+      stress_assert_freed (s, weak, "Window closed while loading");
+      g_ptr_array_free (weak, TRUE);
+    }
+  g_object_unref (root);
+}
+
+int
+main (int argc, char **argv)
+{
+  GSettings *settings;
+  const gchar *scale;
+  gchar *home;
+  gchar *dir;
+  gint ret;
+
+  /* Keep sessions and caches out of the user's home directory */
+  home = g_dir_make_tmp ("simpledevelop-home-XXXXXX", NULL);
+  g_assert_nonnull (home);
+  dir = g_build_filename (home, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", dir, TRUE);
+  g_free (dir);
+  dir = g_build_filename (home, "config", NULL);
+  g_setenv ("XDG_CONFIG_HOME", dir, TRUE);
+  g_free (dir);
+
+  /* The tests need a display and are skipped without one */
+  g_test_init (&argc, &argv, NULL);
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_printerr ("No display available, skipping\n");
+      stress_remove_tree (home);
+      g_free (home);
+      return 77;
+    }
+
+  scale = g_getenv ("SD_TEST_BUDGET_SCALE");
+  if (scale != NULL && g_ascii_strtod (scale, NULL) > 0)
+    stress_scale = g_ascii_strtod (scale, NULL);
+
+  simpledevelop_register_resource ();
+  stress_app = g_object_new (SD_TYPE_APPLICATION,
+			     "application-id", SD_APPLICATION_ID ".Tests",
+			     "flags", G_APPLICATION_NON_UNIQUE, NULL);
+  g_application_register (G_APPLICATION (stress_app), NULL, NULL);
+
+  /* Swap undo histories of inactive tabs and keep them small, so both
+     limits are exercised */
+  settings = g_settings_new (SD_SETTINGS_NAME);
+  g_settings_set_boolean (settings, "undo-swap", TRUE);
+  g_settings_set_uint (settings, "undo-memory-limit", STRESS_UNDO_LIMIT);
+
+  g_test_add ("/stress/editor", Stress, NULL, stress_setup, test_editor,
+	      stress_teardown);
+  g_test_add ("/stress/tree", Stress, NULL, stress_setup, test_tree,
+	      stress_teardown);
+  g_test_add ("/stress/window", Stress, NULL, stress_setup, test_window,
+	      stress_teardown);
+  g_test_add ("/stress/window-loading", Stress, NULL, stress_setup,
+	      test_window_loading, stress_teardown);
+  ret = g_test_run ();
+
+  g_object_unref (settings);
+  g_object_unref (stress_app);
+  stress_remove_tree (home);
+  g_free (home);
+  return ret;
+}